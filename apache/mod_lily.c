@@ -24,39 +24,22 @@ struct table_bind_data {
 
 lily_value *bind_tainted_of(lily_value *input, uint16_t cid_tainted)
 {
-    lily_instance_val *iv = lily_new_instance_val();
-    iv->values = lily_malloc(1 * sizeof(lily_value *));
+    lily_instance_val *iv = lily_new_instance_val(1);
     iv->instance_id = cid_tainted;
-    iv->values[0] = input;
+    /* The instance takes over the ref held by 'input'. */
+    iv->values[0] = *input;
+    lily_free_fixed(input, sizeof(lily_value));
     lily_value *result = lily_new_empty_value();
     lily_move_instance_f(MOVE_DEREF_NO_GC, result, iv);
     return result;
 }
 
-extern uint64_t siphash24(const void *src, unsigned long src_sz, const char key[16]);
-
-/* This is temporary. I've added this because I don't want to 'fix' the hash api
-   when it's going to be removed soon. */
 static void apache_add_unique_hash_entry(const char *sipkey,
         lily_hash_val *hash_val, lily_value *pair_key, lily_value *pair_value)
 {
-    lily_hash_elem *elem = lily_malloc(sizeof(lily_hash_elem));
-
-    uint64_t key_siphash = siphash24(pair_key->value.string->string,
-            pair_key->value.string->size, sipkey);
-
-    elem->key_siphash = key_siphash;
-    elem->elem_key = pair_key;
-    elem->elem_value = pair_value;
-
-    if (hash_val->elem_chain)
-        hash_val->elem_chain->prev = elem;
-
-    elem->prev = NULL;
-    elem->next = hash_val->elem_chain;
-    hash_val->elem_chain = elem;
+    uint64_t key_siphash = lily_string_siphash(pair_key->value.string, sipkey);
 
-    hash_val->num_elems++;
+    lily_hash_add_unique_take(hash_val, key_siphash, pair_key, pair_value);
 }
 
 static int bind_table_entry(void *data, const char *key, const char *value)
@@ -126,7 +109,7 @@ static lily_value *bind_post(lily_options *options, uint16_t *cid_table)
             buffer[len] = 0;
 
             lily_value *elem_key = lily_new_string(pair->name);
-            /* Give the buffer to the value to save memory. */
+            /* The value copies the buffer, and frees it. */
             lily_value *elem_raw_value = lily_new_string_take(buffer);
             lily_value *elem_value = bind_tainted_of(elem_raw_value,
                     cid_tainted);
@@ -171,8 +154,8 @@ static lily_value *bind_httpmethod(lily_options *options)
     If the value provided is not a literal, then ValueError is raised. */
 void lily_apache_server_write_literal(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 {
-    lily_value **vm_regs = vm->vm_regs;
-    lily_value *write_reg = vm_regs[code[1]];
+    lily_value *vm_regs = vm->vm_regs;
+    lily_value *write_reg = &vm_regs[code[1]];
     if (write_reg->flags & VAL_IS_DEREFABLE)
         lily_vm_raise(vm, SYM_CLASS_VALUEERROR,
                 "The string passed must be a literal.\n");
@@ -188,8 +171,8 @@ void lily_apache_server_write_literal(lily_vm_state *vm, uint16_t argc, uint16_t
     assumed that escaping has already been done by server.escape. */
 void lily_apache_server_write_raw(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 {
-    lily_value **vm_regs = vm->vm_regs;
-    char *value = vm_regs[code[1]]->value.string->string;
+    lily_value *vm_regs = vm->vm_regs;
+    char *value = vm_regs[code[1]].value.string->string;
 
     ap_rputs(value, (request_rec *)vm->data);
 }
@@ -203,7 +186,7 @@ extern int lily_maybe_html_encode_to_buffer(lily_vm_state *, lily_value *);
     upon it. The resulting string is then sent to the server. */
 void lily_apache_server_write(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 {
-    lily_value *input = vm->vm_regs[code[1]];
+    lily_value *input = &vm->vm_regs[code[1]];
     const char *source;
 
     /* String.html_encode can't be called directly, for a couple reasons.
@@ -49,7 +49,7 @@ void destroy_result(lily_value *v)
 void lily_postgres_Result_close(lily_vm_state *vm, uint16_t argc,
         uint16_t *code)
 {
-    lily_value *to_close_reg = vm->vm_regs[code[1]];
+    lily_value *to_close_reg = &vm->vm_regs[code[1]];
     lily_pg_result *to_close = (lily_pg_result *)to_close_reg->value.generic;
 
     close_result(to_close_reg);
@@ -59,29 +59,23 @@ void lily_postgres_Result_close(lily_vm_state *vm, uint16_t argc,
 void lily_postgres_Result_each_row(lily_vm_state *vm, uint16_t argc,
         uint16_t *code)
 {
-    lily_value **vm_regs = vm->vm_regs;
+    lily_value *vm_regs = vm->vm_regs;
     lily_pg_result *boxed_result = (lily_pg_result *)
-            vm_regs[code[1]]->value.generic;
+            vm_regs[code[1]].value.generic;
 
     PGresult *raw_result = boxed_result->pg_result;
     if (raw_result == NULL || boxed_result->row_count == 0)
         return;
 
-    lily_value *function_reg = vm_regs[code[2]];
-    int cached = 0;
+    lily_prepared_call call;
+
+    lily_prepare_call(vm, &call, &vm_regs[code[2]], 1, 0);
 
     int row;
     for (row = 0;row < boxed_result->row_count;row++) {
         lily_list_val *lv = lily_new_list_val();
-        /* This List will get a ref bump when it is given to lily_foreign_call.
-           If the function given raises an error, then the List will have two
-           refs but only be in a register once (and thus leak). Thus, an offset
-           ref is done here. */
-        lv->refcount--;
-
-        lily_value fake_reg;
 
-        lv->elems = lily_malloc(boxed_result->column_count * sizeof(lily_value *));
+        lv->elems = lily_malloc(boxed_result->column_count * sizeof(lily_value));
 
         int col;
         for (col = 0;col < boxed_result->column_count;col++) {
@@ -92,27 +86,27 @@ void lily_postgres_Result_each_row(lily_vm_state *vm, uint16_t argc,
             else
                 field_text = PQgetvalue(raw_result, row, col);
 
-            lily_value *v = lily_new_empty_value();
-            lily_move_string(v, lily_new_raw_string(field_text));
-
-            lv->elems[col] = v;
+            lv->elems[col].flags = 0;
+            lily_move_string(&lv->elems[col], lily_new_raw_string(field_text));
         }
 
         lv->num_values = col;
-        fake_reg.value.list = lv;
-        fake_reg.flags = VAL_IS_LIST | VAL_IS_DEREFABLE;
 
-        lily_foreign_call(vm, &cached, 0, function_reg, 1, &fake_reg);
+        /* The row is moved right into the argument register, so the register
+           is the only owner of it. */
+        lily_move_list_f(MOVE_DEREF_NO_GC, lily_prepared_arg(vm, &call, 0),
+                lv);
+        lily_call_prepared(vm, &call);
     }
 }
 
 void lily_postgres_Result_row_count(lily_vm_state *vm, uint16_t argc,
         uint16_t *code)
 {
-    lily_value **vm_regs = vm->vm_regs;
+    lily_value *vm_regs = vm->vm_regs;
     lily_pg_result *boxed_result = (lily_pg_result *)
-            vm_regs[code[1]]->value.generic;
-    lily_value *result_reg = vm_regs[code[0]];
+            vm_regs[code[1]].value.generic;
+    lily_value *result_reg = &vm_regs[code[0]];
     int row = boxed_result->current_row;
 
     lily_move_integer(result_reg, row);
@@ -143,18 +137,18 @@ void lily_postgres_Conn_query(lily_vm_state *vm, uint16_t argc, uint16_t *code)
     char *fmt;
     int arg_pos, fmt_index;
     lily_list_val *vararg_lv;
-    lily_value **vm_regs = vm->vm_regs;
+    lily_value *vm_regs = vm->vm_regs;
     lily_msgbuf *vm_buffer = vm->vm_buffer;
     lily_value *result_reg;
     uint16_t *cid_table = GET_CID_TABLE;
 
     lily_msgbuf_flush(vm_buffer);
 
-    result_reg = vm_regs[code[0]];
+    result_reg = &vm_regs[code[0]];
     lily_pg_conn_value *conn_value =
-            (lily_pg_conn_value *)vm_regs[code[1]]->value.generic;
-    fmt = vm_regs[code[2]]->value.string->string;
-    vararg_lv = vm_regs[code[3]]->value.list;
+            (lily_pg_conn_value *)vm_regs[code[1]].value.generic;
+    fmt = vm_regs[code[2]].value.string->string;
+    vararg_lv = vm_regs[code[3]].value.list;
     arg_pos = 0;
     fmt_index = 0;
     int text_start = 0;
@@ -174,7 +168,7 @@ void lily_postgres_Conn_query(lily_vm_state *vm, uint16_t argc, uint16_t *code)
             text_start = fmt_index + 1;
             text_stop = text_start;
 
-            lily_value *arg = vararg_lv->elems[arg_pos];
+            lily_value *arg = &vararg_lv->elems[arg_pos];
             lily_msgbuf_add(vm_buffer, arg->value.string->string);
             arg_pos++;
         }
@@ -226,7 +220,7 @@ void lily_postgres_Conn_query(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 
 void lily_postgres_Conn_open(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 {
-    lily_value **vm_regs = vm->vm_regs;
+    lily_value *vm_regs = vm->vm_regs;
     const char *host = NULL;
     const char *port = NULL;
     const char *dbname = NULL;
@@ -236,18 +230,18 @@ void lily_postgres_Conn_open(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 
     switch (argc) {
         case 5:
-            pass = vm_regs[code[5]]->value.string->string;
+            pass = vm_regs[code[5]].value.string->string;
         case 4:
-            name = vm_regs[code[4]]->value.string->string;
+            name = vm_regs[code[4]].value.string->string;
         case 3:
-            dbname = vm_regs[code[3]]->value.string->string;
+            dbname = vm_regs[code[3]].value.string->string;
         case 2:
-            port = vm_regs[code[2]]->value.string->string;
+            port = vm_regs[code[2]].value.string->string;
         case 1:
-            host = vm_regs[code[1]]->value.string->string;
+            host = vm_regs[code[1]].value.string->string;
     }
 
-    lily_value *result = vm_regs[code[0]];
+    lily_value *result = &vm_regs[code[0]];
 
     PGconn *conn = PQsetdbLogin(host, port, NULL, NULL, dbname, name, pass);
     lily_pg_conn_value *new_val;
@@ -85,6 +85,9 @@ def get_options_for(dirpath):
         # This causes the tests run in this directory to be run in
         # tagged mode (code will be between <?lily ... ?> tags only).
         options['invoke'] += ' -t'
+    elif dirpath.endswith('depth_limit'):
+        # Tests here check a call depth limit that isn't the default.
+        options['invoke'] += ' -depth 20'
 
     return options
 
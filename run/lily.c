@@ -22,6 +22,9 @@ static void usage()
           "-s string      : The program is a string (end of options).\n"
           "-gstart N      : Initial # of objects allowed before a gc sweep.\n"
           "-gmul N        : (# allowed * N) when sweep can't free anything.\n"
+          "-depth N       : Maximum depth of function calls (N > 0).\n"
+          "-noopt         : Don't optimize the code that is written.\n"
+          "-showcode      : Print the code of each function to stderr.\n"
           "file           : The program is the given filename.\n", stderr);
     exit(EXIT_FAILURE);
 }
@@ -30,6 +33,9 @@ int is_file;
 int do_tags = 0;
 int gc_start = -1;
 int gc_multiplier = -1;
+int max_call_depth = -1;
+int optimize = 1;
+int show_code = 0;
 char *to_process = NULL;
 
 static void process_args(int argc, char **argv, int *argc_offset)
@@ -55,6 +61,19 @@ static void process_args(int argc, char **argv, int *argc_offset)
 
             gc_multiplier = atoi(argv[i]);
         }
+        else if (strcmp("-depth", arg) == 0) {
+            i++;
+            if (i + 1 == argc)
+                usage();
+
+            max_call_depth = atoi(argv[i]);
+            if (max_call_depth <= 0)
+                usage();
+        }
+        else if (strcmp("-noopt", arg) == 0)
+            optimize = 0;
+        else if (strcmp("-showcode", arg) == 0)
+            show_code = 1;
         else if (strcmp("-s", arg) == 0) {
             i++;
             if (i == argc)
@@ -85,9 +104,16 @@ int main(int argc, char **argv)
         options->gc_start = gc_start;
     if (gc_multiplier != -1)
         options->gc_multiplier = gc_multiplier;
+    if (max_call_depth != -1)
+        options->max_call_depth = max_call_depth;
+
+    options->optimize = optimize;
+    options->show_code = show_code;
 
     options->argc = argc - argc_offset;
     options->argv = argv + argc_offset;
+    /* This runner only has one interpreter, so the pool can be used. */
+    options->allocator = lily_new_pool_allocator();
 
     lily_parse_state *parser = lily_new_parse_state(options);
     lily_lex_mode mode = (do_tags ? lm_tags : lm_no_tags);
@@ -104,6 +130,7 @@ int main(int argc, char **argv)
     }
 
     lily_free_parse_state(parser);
+    lily_free_pool_allocator(options->allocator);
     lily_free_options(options);
     exit(EXIT_SUCCESS);
 }
@@ -1,6 +1,10 @@
+#include <string.h>
+
 #include "lily_api_alloc.h"
 
-void *lily_malloc(size_t size)
+/* The default allocator sends everything to the C library. */
+
+static void *default_malloc(void *data, size_t size)
 {
     void *result = malloc(size);
     if (result == NULL)
@@ -9,12 +13,255 @@ void *lily_malloc(size_t size)
     return result;
 }
 
-void *lily_realloc(void *ptr, size_t new_size)
+static void *default_realloc(void *data, void *ptr, size_t new_size)
 {
     return realloc(ptr, new_size);
 }
 
+static void default_free(void *data, void *ptr)
+{
+    free(ptr);
+}
+
+static void default_free_fixed(void *data, void *ptr, size_t size)
+{
+    free(ptr);
+}
+
+static lily_allocator default_allocator =
+{
+    default_malloc,
+    default_realloc,
+    default_free,
+    default_malloc,
+    default_free_fixed,
+    NULL
+};
+
+/* This is shared by every interpreter in the process. */
+static lily_allocator *allocator = &default_allocator;
+
+/* How many interpreters are using the allocator above, if it isn't the default
+   one. */
+static uint32_t allocator_users = 0;
+
+void *lily_malloc(size_t size)
+{
+    return allocator->malloc_func(allocator->data, size);
+}
+
+void *lily_realloc(void *ptr, size_t new_size)
+{
+    return allocator->realloc_func(allocator->data, ptr, new_size);
+}
+
 void lily_free(void *ptr)
 {
+    allocator->free_func(allocator->data, ptr);
+}
+
+void *lily_malloc_fixed(size_t size)
+{
+    return allocator->malloc_fixed_func(allocator->data, size);
+}
+
+void lily_free_fixed(void *ptr, size_t size)
+{
+    allocator->free_fixed_func(allocator->data, ptr, size);
+}
+
+/* An interpreter calls this when it is made, with the allocator it was given
+   (or NULL). If no interpreter is using an allocator, then the one given is
+   used from now on. Otherwise, the one in use is kept, since there's memory
+   from it that is still live. This returns 1 if the interpreter is now a user
+   of the allocator, and must call lily_release_allocator when it is freed. */
+int lily_use_allocator(lily_allocator *new_allocator)
+{
+    if (allocator_users == 0) {
+        if (new_allocator == NULL)
+            return 0;
+
+        allocator = new_allocator;
+    }
+
+    allocator_users++;
+    return 1;
+}
+
+/* An interpreter that is a user of the allocator calls this once everything
+   it allocated has been freed. When the last user is done, the default
+   allocator is used again. */
+void lily_release_allocator(void)
+{
+    allocator_users--;
+
+    if (allocator_users == 0)
+        allocator = &default_allocator;
+}
+
+/***
+ *      ____             _
+ *     |  _ \ ___   ___ | |
+ *     | |_) / _ \ / _ \| |
+ *     |  __/ (_) | (_) | |
+ *     |_|   \___/ \___/|_|
+ *
+ */
+
+/** The pool allocator keeps fixed structures in slabs. Sizes are rounded up to
+    a multiple of POOL_CLASS_SIZE, and each of those size classes has a list of
+    free blocks. A block that is freed goes back onto the list for the class it
+    came from, so a later allocation of that class doesn't need to call malloc.
+    Slabs are not given back until the pool is freed.
+    Everything else (and fixed structures too large for any class) is sent to
+    the C library and counted.
+    The pool does not lock, so it should only be used when interpreters are not
+    being run from different threads. **/
+
+#define POOL_CLASS_SIZE  8
+#define POOL_CLASS_COUNT 16
+#define POOL_SLAB_SIZE   16384
+/* The start of each slab holds a pointer to the next slab. This is padded so
+   that the blocks after it are aligned for any fixed structure. */
+#define POOL_SLAB_HEADER 16
+
+typedef struct lily_pool_block_ {
+    struct lily_pool_block_ *next;
+} lily_pool_block;
+
+typedef struct {
+    lily_allocator allocator;
+    lily_pool_block *free_blocks[POOL_CLASS_COUNT];
+    void *slabs;
+    lily_alloc_stats stats;
+} lily_pool;
+
+static void *pool_malloc(void *data, size_t size)
+{
+    lily_pool *pool = (lily_pool *)data;
+    pool->stats.malloc_count++;
+
+    return default_malloc(NULL, size);
+}
+
+static void *pool_realloc(void *data, void *ptr, size_t new_size)
+{
+    lily_pool *pool = (lily_pool *)data;
+    pool->stats.realloc_count++;
+
+    return realloc(ptr, new_size);
+}
+
+static void pool_free(void *data, void *ptr)
+{
+    lily_pool *pool = (lily_pool *)data;
+    pool->stats.free_count++;
+
     free(ptr);
 }
+
+/* Carve a new slab into blocks for the given class, and return them as a list
+   of free blocks. */
+static lily_pool_block *new_slab_blocks(lily_pool *pool, int class_index)
+{
+    char *slab = default_malloc(NULL, POOL_SLAB_SIZE);
+    size_t block_size = (class_index + 1) * POOL_CLASS_SIZE;
+    char *block_start = slab + POOL_SLAB_HEADER;
+    int count = (POOL_SLAB_SIZE - POOL_SLAB_HEADER) / block_size;
+    lily_pool_block *free_list = NULL;
+    int i;
+
+    *(void **)slab = pool->slabs;
+    pool->slabs = slab;
+    pool->stats.slab_count++;
+
+    /* Walk backward so that the list hands out blocks in address order. */
+    for (i = count - 1;i >= 0;i--) {
+        lily_pool_block *block = (lily_pool_block *)(block_start +
+                (i * block_size));
+        block->next = free_list;
+        free_list = block;
+    }
+
+    return free_list;
+}
+
+static void *pool_malloc_fixed(void *data, size_t size)
+{
+    lily_pool *pool = (lily_pool *)data;
+    pool->stats.fixed_malloc_count++;
+
+    if (size > POOL_CLASS_SIZE * POOL_CLASS_COUNT)
+        return default_malloc(NULL, size);
+
+    int class_index = (size - 1) / POOL_CLASS_SIZE;
+    lily_pool_block *block = pool->free_blocks[class_index];
+
+    if (block == NULL)
+        block = new_slab_blocks(pool, class_index);
+
+    pool->free_blocks[class_index] = block->next;
+    return block;
+}
+
+static void pool_free_fixed(void *data, void *ptr, size_t size)
+{
+    lily_pool *pool = (lily_pool *)data;
+
+    if (ptr == NULL)
+        return;
+
+    pool->stats.fixed_free_count++;
+
+    if (size > POOL_CLASS_SIZE * POOL_CLASS_COUNT) {
+        free(ptr);
+        return;
+    }
+
+    int class_index = (size - 1) / POOL_CLASS_SIZE;
+    lily_pool_block *block = (lily_pool_block *)ptr;
+
+    block->next = pool->free_blocks[class_index];
+    pool->free_blocks[class_index] = block;
+}
+
+/* Create a new pool allocator. It can be given to lily_options, and must
+   outlive every interpreter that uses it. */
+lily_allocator *lily_new_pool_allocator(void)
+{
+    lily_pool *pool = default_malloc(NULL, sizeof(lily_pool));
+
+    pool->allocator.malloc_func = pool_malloc;
+    pool->allocator.realloc_func = pool_realloc;
+    pool->allocator.free_func = pool_free;
+    pool->allocator.malloc_fixed_func = pool_malloc_fixed;
+    pool->allocator.free_fixed_func = pool_free_fixed;
+    pool->allocator.data = pool;
+    pool->slabs = NULL;
+
+    memset(pool->free_blocks, 0, sizeof(pool->free_blocks));
+    memset(&pool->stats, 0, sizeof(pool->stats));
+
+    return &pool->allocator;
+}
+
+void lily_pool_allocator_stats(lily_allocator *a, lily_alloc_stats *stats)
+{
+    lily_pool *pool = (lily_pool *)a->data;
+
+    *stats = pool->stats;
+}
+
+void lily_free_pool_allocator(lily_allocator *a)
+{
+    lily_pool *pool = (lily_pool *)a->data;
+    void *slab_iter = pool->slabs;
+
+    while (slab_iter) {
+        void *slab_next = *(void **)slab_iter;
+        free(slab_iter);
+        slab_iter = slab_next;
+    }
+
+    free(pool);
+}
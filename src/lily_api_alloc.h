@@ -1,10 +1,46 @@
 #ifndef LILY_API_ALLOC_H
 # define LILY_API_ALLOC_H
 
+# include <stdint.h>
 # include <stdlib.h>
 
+/* An allocator holds the functions that every allocation made by the
+   interpreter goes through. Each function is given 'data' as the first
+   argument. The fixed functions are used for structures that are always the
+   same size (values, strings, lists, call frames, and gc entries). The size
+   sent when freeing a fixed structure is the size it was allocated with. */
+typedef struct lily_allocator_ {
+    void *(*malloc_func)(void *, size_t);
+    void *(*realloc_func)(void *, void *, size_t);
+    void (*free_func)(void *, void *);
+    void *(*malloc_fixed_func)(void *, size_t);
+    void (*free_fixed_func)(void *, void *, size_t);
+    void *data;
+} lily_allocator;
+
+/* These are the counters kept by the pool allocator. */
+typedef struct {
+    uint64_t malloc_count;
+    uint64_t realloc_count;
+    uint64_t free_count;
+    uint64_t fixed_malloc_count;
+    uint64_t fixed_free_count;
+    /* How many slabs have been taken to hold fixed structures. */
+    uint64_t slab_count;
+} lily_alloc_stats;
+
 void *lily_malloc(size_t);
 void *lily_realloc(void *, size_t);
 void lily_free(void *);
 
+void *lily_malloc_fixed(size_t);
+void lily_free_fixed(void *, size_t);
+
+int lily_use_allocator(lily_allocator *);
+void lily_release_allocator(void);
+
+lily_allocator *lily_new_pool_allocator(void);
+void lily_pool_allocator_stats(lily_allocator *, lily_alloc_stats *);
+void lily_free_pool_allocator(lily_allocator *);
+
 #endif
@@ -0,0 +1,38 @@
+#ifndef LILY_API_GC_H
+# define LILY_API_GC_H
+
+# include <stdint.h>
+
+struct lily_vm_state_;
+
+/* These are the counters that the vm keeps about the gc. All of them start at
+   zero when the vm is made, and only go up. */
+typedef struct {
+    /* How many young passes have been done. */
+    uint64_t young_collections;
+    /* How many full sweeps have been done. */
+    uint64_t full_collections;
+    /* How many entries were found to be reachable by a pass. */
+    uint64_t marked;
+    /* How many values were unreachable, and destroyed by a pass. */
+    uint64_t swept;
+    /* How many times tagging a value took a spare entry instead of allocating
+       a new one. */
+    uint64_t reused;
+    /* The total time spent collecting, and the longest single collection. Both
+       of these are in microseconds. */
+    uint64_t pause_usec;
+    uint64_t max_pause_usec;
+} lily_gc_stats;
+
+void lily_vm_get_gc_stats(struct lily_vm_state_ *, lily_gc_stats *);
+
+/* Do a young pass, then a full sweep. */
+void lily_vm_gc_collect(struct lily_vm_state_ *);
+
+/* This sets how many values can be tagged before a young pass. This starts as
+   the gc_start of the options. */
+void lily_vm_set_gc_threshold(struct lily_vm_state_ *, uint32_t);
+uint32_t lily_vm_get_gc_threshold(struct lily_vm_state_ *);
+
+#endif
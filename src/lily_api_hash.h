@@ -9,5 +9,8 @@ void lily_hash_set_elem(lily_vm_state *, lily_hash_val *, lily_value *,
         lily_value *);
 void lily_hash_add_unique(lily_vm_state *, lily_hash_val *, lily_value *,
         lily_value *);
+void lily_hash_add_unique_take(lily_hash_val *, uint64_t, lily_value *,
+        lily_value *);
+uint64_t lily_string_siphash(lily_string_val *, const char *);
 
 #endif
@@ -14,11 +14,15 @@ lily_options *lily_new_default_options(void)
     /* The gc options are totally arbitrary. */
     options->gc_start = 100;
     options->gc_multiplier = 4;
+    options->max_call_depth = 100;
+    options->optimize = 1;
+    options->show_code = 0;
     options->argc = 0;
     options->argv = NULL;
 
     options->html_sender = (lily_html_sender) fputs;
     options->data = stdout;
+    options->allocator = NULL;
 
     /* todo: This key sucks. Get a better one. */
     char key[16] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
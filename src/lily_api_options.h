@@ -18,6 +18,19 @@ typedef struct lily_options_ {
     /* The initial maximum amount of entries allowed to have a gc tag before
        asking for another causes a sweep. */
     uint32_t gc_start;
+    /* How many calls deep the interpreter can go before a RuntimeError is
+       raised. Foreign functions count toward this, but __main__ does not. */
+    uint32_t max_call_depth;
+    /* If this is not 0, then the emitter optimizes the code that it writes.
+       Expressions and interpolations of literals are folded into their value.
+       The code of each function gets a peephole pass, has what doesn't change
+       moved out of loops, and has its registers packed. Calls to small
+       functions are replaced with their code. Setting this to 0 turns all of
+       these off. This is 1 by default. */
+    uint8_t optimize;
+    /* If this is not 0, then the code of each function is written to stderr
+       when the function is done. */
+    uint8_t show_code;
     /* This is used by the interpreter to compute hashes of a raw value for
        doing Hash collision checks. This key should be composed of exactly 16
        chars. */
@@ -32,6 +45,14 @@ typedef struct lily_options_ {
     /* This is the function that will be called when tagged data is seen. The
        first argument will be the data parameter above. */
     lily_html_sender html_sender;
+    /* If this is not NULL, then the interpreter will use this allocator
+       instead of the C library from when the parser is made until it is
+       freed. There is only one allocator for the whole process. It is set by
+       the first interpreter made while no allocator is in use, and stays until
+       every interpreter made after it has been freed. Interpreters made in
+       that time use it no matter what they were given, so it must outlive all
+       of them. */
+    struct lily_allocator_ *allocator;
 } lily_options;
 
 lily_options *lily_new_default_options(void);
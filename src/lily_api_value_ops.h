@@ -9,6 +9,7 @@ void lily_deref(lily_value *);
 void lily_assign_value(lily_value *, lily_value *);
 void lily_assign_value_noref(lily_value *, lily_value *);
 lily_value *lily_copy_value(lily_value *);
+void lily_init_value(lily_value *, lily_value *);
 int lily_eq_value(struct lily_vm_state_ *, lily_value *, lily_value *);
 
 /** The functions and the MOVE_* flags form the move api. This api is used to
@@ -69,21 +70,24 @@ lily_file_val *lily_new_file_val(FILE *, const char *);
 
 /* These three functions are a special case. The first two are meant to be used
    at parse-time (they may not work at vm-time). The last may work at vm-time,
-   but is used primarily for closure allocation. */
+   but is used primarily for closure allocation. The copy has room for as many
+   upvalues as given, which are all NULL. */
 lily_function_val *lily_new_native_function_val(char *, char *);
 lily_function_val *lily_new_foreign_function_val(lily_foreign_func,
         const char *, const char *);
-lily_function_val *lily_new_function_copy(lily_function_val *);
+lily_function_val *lily_new_function_copy(lily_function_val *, uint16_t);
 
 lily_list_val *lily_new_list_val(void);
+lily_list_val *lily_new_list_of(uint32_t, lily_value *);
 lily_hash_val *lily_new_hash_val(void);
-lily_instance_val *lily_new_instance_val(void);
+lily_instance_val *lily_new_instance_val(uint32_t);
 
 lily_value *lily_new_string(const char *);
 lily_value *lily_new_string_take(char *);
 lily_value *lily_new_string_ncpy(const char *, int);
 lily_string_val *lily_new_raw_string(const char *);
 lily_string_val *lily_new_raw_string_sized(const char *, int);
+lily_string_val *lily_new_raw_string_blank(int);
 
 /* An id is assigned to every variant within an enum. That id is used along with
    the id of an enum for printing the variant. The values below are used to
@@ -101,4 +105,16 @@ lily_instance_val *lily_get_none(struct lily_vm_state_ *);
 lily_instance_val *lily_new_left(lily_value *);
 lily_instance_val *lily_new_right(lily_value *);
 
+/* These are the flags of values that a List packs. */
+#define LIST_PACKABLE_FLAGS (VAL_IS_BOOLEAN | VAL_IS_INTEGER | VAL_IS_DOUBLE)
+
+/* How many bytes each element of the given list takes up. */
+#define LIST_ELEM_SIZE(lv) \
+    ((lv)->packed_flags ? sizeof(lily_raw_value) : sizeof(lily_value))
+
+lily_value *lily_list_get_elem(lily_list_val *, uint32_t, lily_value *);
+void lily_list_set_elem(lily_list_val *, uint32_t, lily_value *);
+void lily_list_init_elem(lily_list_val *, uint32_t, lily_value *);
+void lily_list_pack_for(lily_list_val *, lily_value *);
+
 #endif
@@ -0,0 +1,155 @@
+#include "lily_code_dump.h"
+#include "lily_code_iter.h"
+#include "lily_opcode.h"
+
+static const char *opcode_names[] = {
+    [o_fast_assign]                = "fast_assign",
+    [o_assign]                     = "assign",
+    [o_integer_add]                = "integer_add",
+    [o_integer_minus]              = "integer_minus",
+    [o_modulo]                     = "modulo",
+    [o_integer_mul]                = "integer_mul",
+    [o_integer_div]                = "integer_div",
+    [o_left_shift]                 = "left_shift",
+    [o_right_shift]                = "right_shift",
+    [o_bitwise_and]                = "bitwise_and",
+    [o_bitwise_or]                 = "bitwise_or",
+    [o_bitwise_xor]                = "bitwise_xor",
+    [o_double_add]                 = "double_add",
+    [o_double_minus]               = "double_minus",
+    [o_double_mul]                 = "double_mul",
+    [o_double_div]                 = "double_div",
+    [o_is_equal]                   = "is_equal",
+    [o_not_eq]                     = "not_eq",
+    [o_less]                       = "less",
+    [o_less_eq]                    = "less_eq",
+    [o_greater]                    = "greater",
+    [o_greater_eq]                 = "greater_eq",
+    [o_integer_eq]                 = "integer_eq",
+    [o_integer_not_eq]             = "integer_not_eq",
+    [o_integer_less]               = "integer_less",
+    [o_integer_less_eq]            = "integer_less_eq",
+    [o_integer_greater]            = "integer_greater",
+    [o_integer_greater_eq]         = "integer_greater_eq",
+    [o_double_eq]                  = "double_eq",
+    [o_double_not_eq]              = "double_not_eq",
+    [o_double_less]                = "double_less",
+    [o_double_less_eq]             = "double_less_eq",
+    [o_double_greater]             = "double_greater",
+    [o_double_greater_eq]          = "double_greater_eq",
+    [o_string_eq]                  = "string_eq",
+    [o_string_not_eq]              = "string_not_eq",
+    [o_string_less]                = "string_less",
+    [o_string_less_eq]             = "string_less_eq",
+    [o_string_greater]             = "string_greater",
+    [o_string_greater_eq]          = "string_greater_eq",
+    [o_jump]                       = "jump",
+    [o_jump_if]                    = "jump_if",
+    [o_jump_if_integer_eq]         = "jump_if_integer_eq",
+    [o_jump_if_integer_not_eq]     = "jump_if_integer_not_eq",
+    [o_jump_if_integer_less]       = "jump_if_integer_less",
+    [o_jump_if_integer_less_eq]    = "jump_if_integer_less_eq",
+    [o_jump_if_integer_greater]    = "jump_if_integer_greater",
+    [o_jump_if_integer_greater_eq] = "jump_if_integer_greater_eq",
+    [o_jump_if_double_eq]          = "jump_if_double_eq",
+    [o_jump_if_double_not_eq]      = "jump_if_double_not_eq",
+    [o_jump_if_double_less]        = "jump_if_double_less",
+    [o_jump_if_double_less_eq]     = "jump_if_double_less_eq",
+    [o_jump_if_double_greater]     = "jump_if_double_greater",
+    [o_jump_if_double_greater_eq]  = "jump_if_double_greater_eq",
+    [o_foreign_call]               = "foreign_call",
+    [o_native_call]                = "native_call",
+    [o_function_call]              = "function_call",
+    [o_return_val]                 = "return_val",
+    [o_return_noval]               = "return_noval",
+    [o_unary_not]                  = "unary_not",
+    [o_unary_minus]                = "unary_minus",
+    [o_build_list]                 = "build_list",
+    [o_build_tuple]                = "build_tuple",
+    [o_build_hash]                 = "build_hash",
+    [o_build_enum]                 = "build_enum",
+    [o_dynamic_cast]               = "dynamic_cast",
+    [o_integer_for]                = "integer_for",
+    [o_for_setup]                  = "for_setup",
+    [o_get_item]                   = "get_item",
+    [o_set_item]                   = "set_item",
+    [o_get_packed_item]            = "get_packed_item",
+    [o_set_packed_item]            = "set_packed_item",
+    [o_get_global]                 = "get_global",
+    [o_set_global]                 = "set_global",
+    [o_get_readonly]               = "get_readonly",
+    [o_get_integer]                = "get_integer",
+    [o_get_boolean]                = "get_boolean",
+    [o_get_property]               = "get_property",
+    [o_set_property]               = "set_property",
+    [o_except_ignore]              = "except_ignore",
+    [o_except_catch]               = "except_catch",
+    [o_raise]                      = "raise",
+    [o_new_instance_basic]         = "new_instance_basic",
+    [o_new_instance_speculative]   = "new_instance_speculative",
+    [o_new_instance_tagged]        = "new_instance_tagged",
+    [o_optarg_dispatch]            = "optarg_dispatch",
+    [o_match_dispatch]             = "match_dispatch",
+    [o_variant_decompose]          = "variant_decompose",
+    [o_get_upvalue]                = "get_upvalue",
+    [o_set_upvalue]                = "set_upvalue",
+    [o_create_closure]             = "create_closure",
+    [o_create_function]            = "create_function",
+    [o_create_local_function]      = "create_local_function",
+    [o_load_class_closure]         = "load_class_closure",
+    [o_load_closure]               = "load_closure",
+    [o_interpolation]              = "interpolation",
+    [o_return_from_vm]             = "return_from_vm",
+};
+
+static void add_values(lily_msgbuf *msgbuf, const char *prefix,
+        uint16_t *buffer, int pos, int count)
+{
+    int i;
+    for (i = 0;i < count;i++)
+        lily_msgbuf_add_fmt(msgbuf, " %s%d", prefix, buffer[pos + i]);
+}
+
+void lily_dump_code(lily_msgbuf *msgbuf, uint16_t *code, uint16_t size)
+{
+    lily_code_iter ci;
+    lily_ci_init(&ci, code, 0, size);
+
+    while (lily_ci_next(&ci)) {
+        uint16_t *buffer = ci.buffer;
+        int pos = ci.offset + 1;
+
+        lily_msgbuf_add_fmt(msgbuf, "%5d %s", ci.offset,
+                opcode_names[ci.opcode]);
+
+        if (ci.line) {
+            lily_msgbuf_add_fmt(msgbuf, " (line %d)", buffer[pos]);
+            pos++;
+        }
+
+        add_values(msgbuf, "", buffer, pos, ci.special_1);
+        pos += ci.special_1;
+
+        add_values(msgbuf, "", buffer, pos, ci.counter_2);
+        pos += ci.counter_2;
+
+        add_values(msgbuf, "#", buffer, pos, ci.inputs_3);
+        pos += ci.inputs_3;
+
+        add_values(msgbuf, "", buffer, pos, ci.special_4);
+        pos += ci.special_4;
+
+        if (ci.outputs_5) {
+            lily_msgbuf_add(msgbuf, " ->");
+            add_values(msgbuf, "#", buffer, pos, ci.outputs_5);
+            pos += ci.outputs_5;
+        }
+
+        add_values(msgbuf, "", buffer, pos, ci.special_6);
+        pos += ci.special_6;
+
+        add_values(msgbuf, "@", buffer, pos, ci.jumps_7);
+
+        lily_msgbuf_add_char(msgbuf, '\n');
+    }
+}
@@ -0,0 +1,14 @@
+#ifndef LILY_CODE_DUMP_H
+# define LILY_CODE_DUMP_H
+
+# include <stdint.h>
+
+# include "lily_msgbuf.h"
+
+/* This writes out the code of a function, one instruction per line. Registers
+   are shown as #n, and jump targets as @n. The code is walked with a code
+   iter, so the format is the same for every opcode. This is used to check what
+   the emitter (and the peephole pass) have done to a function. */
+void lily_dump_code(lily_msgbuf *, uint16_t *, uint16_t);
+
+#endif
@@ -58,6 +58,24 @@ int lily_ci_next(lily_code_iter *iter)
         case o_less_eq:
         case o_greater:
         case o_greater_eq:
+        case o_integer_eq:
+        case o_integer_not_eq:
+        case o_integer_less:
+        case o_integer_less_eq:
+        case o_integer_greater:
+        case o_integer_greater_eq:
+        case o_double_eq:
+        case o_double_not_eq:
+        case o_double_less:
+        case o_double_less_eq:
+        case o_double_greater:
+        case o_double_greater_eq:
+        case o_string_eq:
+        case o_string_not_eq:
+        case o_string_less:
+        case o_string_less_eq:
+        case o_string_greater:
+        case o_string_greater_eq:
             iter->line = 1;
             iter->inputs_3 = 2;
             iter->outputs_5 = 1;
@@ -76,6 +94,24 @@ int lily_ci_next(lily_code_iter *iter)
 
             iter->round_total = 4;
             break;
+        case o_jump_if_integer_eq:
+        case o_jump_if_integer_not_eq:
+        case o_jump_if_integer_less:
+        case o_jump_if_integer_less_eq:
+        case o_jump_if_integer_greater:
+        case o_jump_if_integer_greater_eq:
+        case o_jump_if_double_eq:
+        case o_jump_if_double_not_eq:
+        case o_jump_if_double_less:
+        case o_jump_if_double_less_eq:
+        case o_jump_if_double_greater:
+        case o_jump_if_double_greater_eq:
+            iter->special_1 = 1;
+            iter->inputs_3 = 2;
+            iter->jumps_7 = 1;
+
+            iter->round_total = 5;
+            break;
         case o_native_call:
         case o_foreign_call:
         case o_function_call:
@@ -148,6 +184,7 @@ int lily_ci_next(lily_code_iter *iter)
             iter->round_total = 6;
             break;
         case o_get_item:
+        case o_get_packed_item:
             iter->line = 1;
             iter->inputs_3 = 2;
             iter->outputs_5 = 1;
@@ -155,6 +192,7 @@ int lily_ci_next(lily_code_iter *iter)
             iter->round_total = 5;
             break;
         case o_set_item:
+        case o_set_packed_item:
             iter->line = 1;
             iter->inputs_3 = 3;
 
@@ -192,13 +230,6 @@ int lily_ci_next(lily_code_iter *iter)
 
             iter->round_total = 5;
             break;
-        case o_push_try:
-            iter->line = 1;
-            iter->jumps_7 = 1;
-
-            iter->round_total = 3;
-            break;
-        case o_pop_try:
         case o_return_from_vm:
 
             iter->round_total = 1;
@@ -279,6 +310,7 @@ int lily_ci_next(lily_code_iter *iter)
             iter->round_total = 4;
             break;
         case o_create_function:
+        case o_create_local_function:
             iter->special_1 = 1;
             iter->special_4 = 1;
             iter->outputs_5 = 1;
@@ -278,11 +278,17 @@ typedef struct lily_var_ {
 
 
 
-/* This is a string. It's pretty simple. These are refcounted. */
+/* This is a string. It's pretty simple. These are refcounted. The text is
+   stored right after the header, so that a string is one allocation. The
+   size of that allocation comes from 'size', so it must not change. */
 typedef struct lily_string_val_ {
     uint32_t refcount;
     uint32_t size;
-    char *string;
+    /* Strings can't be changed, so the siphash of a string is computed the
+       first time it is used as a key and saved here. 0 means it hasn't been
+       computed yet. */
+    uint64_t siphash;
+    char string[];
 } lily_string_val;
 
 /* Instances of the Dynamic class act as a wrapper around some singular value.
@@ -299,43 +305,69 @@ typedef struct lily_dynamic_val_ {
    are handled entirely at parse-time (vm just assumes correctness). There is no
    marker for this because Dynamic can't 'lose' either of those types inside of
    itself. */
+/* Lists and tuples hold their values directly in 'elems'. Since the elements
+   can move when the list grows, a pointer to an element should not be held
+   onto past anything that can change the list.
+   A List that holds Boolean, Integer, or Double values is packed: Each element
+   is only the raw value, and 'packed_flags' holds the flags that all of them
+   share. The first value put into an empty List decides if it is packed.
+   Tuples are never packed. The lily_list_*_elem functions handle both. */
 typedef struct lily_list_val_ {
     uint32_t refcount;
     uint32_t extra_space;
     uint32_t num_values;
-    uint32_t pad;
-    struct lily_value_ **elems;
+    uint32_t packed_flags;
+    union {
+        struct lily_value_ *elems;
+        lily_raw_value *raw_elems;
+    };
 } lily_list_val;
 
 /* Lily's hashes are in two parts: The hash value, and the hash element. The
-   hash element represents one key + value pair. */
+   hash element represents one key + value pair. Elements are stored inline
+   within the hash, in the order that they were added. */
 typedef struct lily_hash_elem_ {
     /* Lily uses siphash2-4 to calculate the hash of given keys. This is the
        siphash for elem_key.*/
     uint64_t key_siphash;
-    struct lily_value_ *elem_key;
-    struct lily_value_ *elem_value;
-    struct lily_hash_elem_ *next;
-    struct lily_hash_elem_ *prev;
+    /* If the flags of this are 0, then the element was deleted. */
+    struct lily_value_ elem_key;
+    struct lily_value_ elem_value;
 } lily_hash_elem;
 
+/* The hash value is an open addressing table. The elements are held in a
+   dense array, and the buckets hold indexes into that array. The number of
+   buckets is always a power of 2 and kept at twice the space of 'elems', so
+   that a probe through the buckets will always hit an empty one. */
 typedef struct lily_hash_val_ {
     uint32_t refcount;
     uint32_t iter_count;
+    /* How many elements are currently alive. */
     uint32_t num_elems;
-    uint32_t pad;
-    lily_hash_elem *elem_chain;
+    /* How many slots of 'elems' have been used (including deleted ones). */
+    uint32_t elem_count;
+    /* How many slots 'elems' has. */
+    uint32_t elem_space;
+    /* The number of buckets, minus 1. */
+    uint32_t bucket_mask;
+    lily_hash_elem *elems;
+    /* A bucket is 0 if it is empty. Otherwise, it holds 1 + the index of the
+       element that it refers to. */
+    uint32_t *buckets;
 } lily_hash_val;
 
 /* Either an instance or an enum. The instance_id tells the id of it either way.
-   This may or may not have a gc_entry set for it. */
+   This may or may not have a gc_entry set for it.
+   The values are in the same block as the instance, right after it. 'values'
+   points to the first of them, so that this has the same layout as a list.
+   For the same reason, 'pad' is always 0 (an instance is never packed). */
 typedef struct lily_instance_val_ {
     uint32_t refcount;
     uint16_t instance_id;
     uint16_t variant_id;
     uint32_t num_values;
     uint32_t pad;
-    struct lily_value_ **values;
+    struct lily_value_ *values;
     struct lily_gc_entry_ *gc_entry;
 } lily_instance_val;
 
@@ -382,7 +414,13 @@ typedef struct lily_function_val_ {
     /* Here's where the function's code is stored. */
     uint16_t *code;
 
-    uint32_t pad;
+    /* Native functions only. Each try block has an entry of three positions:
+       Where the try starts, where it ends, and the first except clause. Inner
+       try blocks come before the try blocks that hold them. The table is
+       owned by whatever owns the code, so it's never freed on its own. */
+    uint16_t *try_table;
+
+    uint32_t try_count;
 
     uint16_t num_upvalues;
 
@@ -439,6 +477,12 @@ typedef struct lily_gc_entry_ {
        to NULL to keep the gc from looking at an invalid data. */
     lily_raw_value value;
     struct lily_gc_entry_ *next;
+    /* This is 1 if the entry is in the vm's young list, 0 otherwise. */
+    uint32_t is_young;
+    /* Used by the young pass. This starts as the value's refcount, and has the
+       refs that come from other young values taken away. Anything left came
+       from outside of the young values. */
+    int32_t outside_refs;
 } lily_gc_entry;
 
 typedef struct lily_module_link_ {
@@ -642,6 +686,10 @@ typedef struct lily_package_link_ {
    function. */
 #define VAR_IS_FOREIGN_FUNC     0x400
 
+/* This var holds a function that is small enough to be written into the
+   function that calls it. The emitter has the code saved. */
+#define VAR_CAN_INLINE          0x800
+
 /* VAL_* flags are for lily_value. */
 
 
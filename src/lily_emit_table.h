@@ -23,34 +23,34 @@ static const int generic_binop_table[16][3][3] =
         {-1, -1, -1}
     },
     {
-        {o_is_equal, o_is_equal, -1},
-        {o_is_equal, o_is_equal, -1},
-        {-1, -1, o_is_equal}
+        {o_integer_eq, o_is_equal, -1},
+        {o_is_equal, o_double_eq, -1},
+        {-1, -1, o_string_eq}
     },
     {
-        {o_less, o_less, -1},
-        {o_less, o_less, -1},
-        {-1, -1, o_less}
+        {o_integer_less, o_less, -1},
+        {o_less, o_double_less, -1},
+        {-1, -1, o_string_less}
     },
     {
-        {o_less_eq, o_less_eq, -1},
-        {o_less_eq, o_less_eq, -1},
-        {-1, -1, o_less_eq}
+        {o_integer_less_eq, o_less_eq, -1},
+        {o_less_eq, o_double_less_eq, -1},
+        {-1, -1, o_string_less_eq}
     },
     {
-        {o_greater, o_greater, -1},
-        {o_greater, o_greater, -1},
-        {-1, -1, o_greater}
+        {o_integer_greater, o_greater, -1},
+        {o_greater, o_double_greater, -1},
+        {-1, -1, o_string_greater}
     },
     {
-        {o_greater_eq, o_greater_eq, -1},
-        {o_greater_eq, o_greater_eq, -1},
-        {-1, -1, o_greater_eq}
+        {o_integer_greater_eq, o_greater_eq, -1},
+        {o_greater_eq, o_double_greater_eq, -1},
+        {-1, -1, o_string_greater_eq}
     },
     {
-        {o_not_eq, o_not_eq, -1},
-        {o_not_eq, o_not_eq, -1},
-        {-1, -1, o_not_eq}
+        {o_integer_not_eq, o_not_eq, -1},
+        {o_not_eq, o_double_not_eq, -1},
+        {-1, -1, o_string_not_eq}
     },
     {
         {o_modulo, -1, -1},
@@ -1,3 +1,4 @@
+#include <stdio.h>
 #include <string.h>
 #include <stdint.h>
 
@@ -7,8 +8,10 @@
 #include "lily_emit_table.h"
 #include "lily_parser.h"
 #include "lily_code_iter.h"
+#include "lily_code_dump.h"
 
 #include "lily_api_alloc.h"
+#include "lily_api_options.h"
 #include "lily_api_value_ops.h"
 
 # define IS_LOOP_BLOCK(b) (b == block_while || \
@@ -33,7 +36,8 @@
 static void add_call_state(lily_emit_state *);
 static void add_storage(lily_emit_state *);
 
-lily_emit_state *lily_new_emit_state(lily_symtab *symtab, lily_raiser *raiser)
+lily_emit_state *lily_new_emit_state(lily_options *options,
+        lily_symtab *symtab, lily_raiser *raiser)
 {
     lily_emit_state *emit = lily_malloc(sizeof(lily_emit_state));
 
@@ -44,6 +48,12 @@ lily_emit_state *lily_new_emit_state(lily_symtab *symtab, lily_raiser *raiser)
             symtab->question_class->type);
     emit->code = lily_new_buffer_u16(32);
     emit->closure_aux_code = NULL;
+    emit->optimize_map = lily_new_buffer_u16(32);
+    emit->try_table = lily_new_buffer_u16(4);
+    emit->inline_code = lily_new_buffer_u16(32);
+    emit->inline_types = lily_malloc(sizeof(lily_type *) * 8);
+    emit->inline_types_pos = 0;
+    emit->inline_types_size = 8;
 
     emit->closed_syms = lily_malloc(sizeof(lily_sym *) * 4);
     emit->transform_table = NULL;
@@ -76,6 +86,8 @@ lily_emit_state *lily_new_emit_state(lily_symtab *symtab, lily_raiser *raiser)
 
     emit->raiser = raiser;
     emit->expr_num = 1;
+    emit->optimize = options->optimize;
+    emit->show_code = options->show_code;
 
     add_call_state(emit);
 
@@ -125,6 +137,10 @@ void lily_free_emit_state(lily_emit_state *emit)
     if (emit->closure_aux_code)
         lily_free_buffer_u16(emit->closure_aux_code);
     lily_free_buffer_u16(emit->patches);
+    lily_free_buffer_u16(emit->optimize_map);
+    lily_free_buffer_u16(emit->try_table);
+    lily_free_buffer_u16(emit->inline_code);
+    lily_free(emit->inline_types);
     lily_free_buffer_u16(emit->code);
     lily_free(emit);
 }
@@ -172,6 +188,7 @@ void lily_emit_enter_main(lily_emit_state *emit)
     main_block->self = NULL;
     main_block->code_start = 0;
     main_block->jump_offset = 0;
+    main_block->try_start = 0;
     main_block->next_reg_spot = 0;
     main_block->loop_start = -1;
     main_block->make_closure = 0;
@@ -456,30 +473,6 @@ void lily_emit_finalize_for_in(lily_emit_state *emit, lily_var *user_loop_var,
     }
 }
 
-/* This is called before 'continue', 'break', or 'return' is written. It writes
-   the appropriate number of try+catch pop instructions to offset the movement.
-   A search is done from the current block down to 'stop_block' to find out how
-   many try pop's to write. */
-static void write_pop_try_blocks_up_to(lily_emit_state *emit,
-        lily_block *stop_block)
-{
-    lily_block *block_iter = emit->block;
-    int try_count = 0;
-
-    while (block_iter != stop_block) {
-        if (block_iter->block_type == block_try)
-            try_count++;
-
-        block_iter = block_iter->prev;
-    }
-
-    if (try_count) {
-        int i;
-        for (i = 0;i < try_count;i++)
-            lily_u16_write_1(emit->code, o_pop_try);
-    }
-}
-
 /* The parser has a 'break' and wants the emitter to write the code. */
 void lily_emit_break(lily_emit_state *emit)
 {
@@ -490,8 +483,6 @@ void lily_emit_break(lily_emit_state *emit)
 
     lily_block *loop_block = find_deepest_loop(emit);
 
-    write_pop_try_blocks_up_to(emit, loop_block);
-
     /* Write the jump, then figure out where to put it. */
     lily_u16_write_2(emit->code, o_jump, 0);
 
@@ -506,17 +497,16 @@ void lily_emit_continue(lily_emit_state *emit)
                 "'continue' used outside of a loop.\n");
     }
 
-    write_pop_try_blocks_up_to(emit, find_deepest_loop(emit));
-
-    lily_u16_write_2(emit->code, o_jump, emit->block->loop_start);
+    lily_u16_write_2(emit->code, o_jump,
+            emit->block->loop_start - emit->block->jump_offset);
 }
 
-/* The parser has a 'try' and wants the emitter to write the code. */
-void lily_emit_try(lily_emit_state *emit, int line_num)
+/* The parser has a 'try' and wants the emitter to write the code. Nothing is
+   written for entering a try. Instead, the start is written down so that the
+   first 'except' can make an entry in the try table. */
+void lily_emit_try(lily_emit_state *emit)
 {
-    lily_u16_write_3(emit->code, o_push_try, line_num, 0);
-
-    lily_u16_write_1(emit->patches, lily_u16_pos(emit->code) - 1);
+    emit->block->try_start = lily_u16_pos(emit->code) - emit->block->jump_offset;
 }
 
 /* The parser has an 'except' clause and wants emitter to write code for it. */
@@ -541,10 +531,64 @@ void lily_emit_except(lily_emit_state *emit, lily_type *except_type,
 }
 
 /* Write a conditional jump. 0 means jump if false, 1 means jump if true. The
-   ast is the thing to test. */
+   ast is the thing to test.
+   If the ast is a comparison or a not that was just written, then the result
+   of that op is only used by this jump. In that case, the op is rewritten into
+   a single jump op instead of writing a second op to test the result. */
 static void emit_jump_if(lily_emit_state *emit, lily_ast *ast, int jump_on)
 {
-    lily_u16_write_4(emit->code, o_jump_if, jump_on, ast->result->reg_spot, 0);
+    while (ast->tree_type == tree_parenth)
+        ast = ast->arg_start;
+
+    uint16_t *data = emit->code->data;
+    int pos = lily_u16_pos(emit->code);
+    int reg_spot = ast->result->reg_spot;
+
+    if (ast->tree_type == tree_binary &&
+        ast->op >= expr_eq_eq && ast->op <= expr_not_eq &&
+        data[pos - 1] == reg_spot) {
+        int fused_op = -1;
+
+        switch (data[pos - 5]) {
+            case o_integer_eq:
+            case o_integer_not_eq:
+            case o_integer_less:
+            case o_integer_less_eq:
+            case o_integer_greater:
+            case o_integer_greater_eq:
+                fused_op = data[pos - 5] - o_integer_eq + o_jump_if_integer_eq;
+                break;
+            case o_double_eq:
+            case o_double_not_eq:
+            case o_double_less:
+            case o_double_less_eq:
+            case o_double_greater:
+            case o_double_greater_eq:
+                fused_op = data[pos - 5] - o_double_eq + o_jump_if_double_eq;
+                break;
+        }
+
+        if (fused_op != -1) {
+            /* o_X, line, lhs, rhs, result becomes o_jump_if_X, jump_on, lhs,
+               rhs, jump. */
+            data[pos - 5] = fused_op;
+            data[pos - 4] = jump_on;
+            data[pos - 1] = 0;
+            lily_u16_write_1(emit->patches, pos - 1);
+            return;
+        }
+    }
+    else if (ast->tree_type == tree_unary && ast->op == expr_unary_not &&
+             data[pos - 4] == o_unary_not && data[pos - 1] == reg_spot) {
+        /* Testing !x is the same as testing x with the jump flipped. */
+        data[pos - 4] = o_jump_if;
+        data[pos - 3] = !jump_on;
+        data[pos - 1] = 0;
+        lily_u16_write_1(emit->patches, pos - 1);
+        return;
+    }
+
+    lily_u16_write_4(emit->code, o_jump_if, jump_on, reg_spot, 0);
 
     lily_u16_write_1(emit->patches, lily_u16_pos(emit->code) - 1);
 }
@@ -751,6 +795,7 @@ void lily_emit_enter_block(lily_emit_state *emit, lily_block_type block_type)
         new_block->function_var = v;
         new_block->code_start = lily_u16_pos(emit->code);
         new_block->jump_offset = lily_u16_pos(emit->code);
+        new_block->try_start = lily_u16_pos(emit->try_table);
         new_block->loop_start = -1;
 
         emit->top_var = v;
@@ -903,8 +948,7 @@ void lily_emit_leave_block(lily_emit_state *emit)
                 block->loop_start - block->jump_offset);
     else if (block_type == block_match)
         emit->match_case_pos = emit->block->match_case_start;
-    else if (block_type == block_try ||
-             block_type == block_try_except ||
+    else if (block_type == block_try_except ||
              block_type == block_try_except_all) {
         /* The vm expects that the last except block will have a 'next' of 0 to
            indicate the end of the 'except' chain. Remove the patch that the
@@ -998,12 +1042,6 @@ void lily_emit_change_block_to(lily_emit_state *emit, int new_type)
         if (current_type == block_try_except_all)
             lily_raise(emit->raiser, lily_SyntaxError,
                     "'except' clause is unreachable.\n");
-
-        /* If nothing in the 'try' block raises an error, the vm needs to be
-           told to unregister the 'try' block since will become unreachable
-           when the jump below occurs. */
-        if (current_type == block_try)
-            lily_u16_write_1(emit->code, o_pop_try);
     }
 
     lily_var *v = emit->block->var_start;
@@ -1015,14 +1053,24 @@ void lily_emit_change_block_to(lily_emit_state *emit, int new_type)
     lily_u16_write_2(emit->code, o_jump, 0);
     save_jump = lily_u16_pos(emit->code) - 1;
 
-    /* The last jump of the previous branch wants to know where the check for
-       the next branch starts. It's right now. */
-    uint16_t patch = lily_u16_pop(emit->patches);
+    if (current_type == block_try) {
+        /* The try covers everything up to the jump just written, and the first
+           except clause starts after it. */
+        uint16_t try_end = save_jump - 1 - emit->block->jump_offset;
 
-    if (patch != (uint16_t)-1)
-        lily_u16_insert(emit->code, patch,
-                lily_u16_pos(emit->code) - emit->block->jump_offset);
-    /* else it's a fake branch from a condition that was optimized out. */
+        lily_u16_write_3(emit->try_table, emit->block->try_start, try_end,
+                try_end + 2);
+    }
+    else {
+        /* The last jump of the previous branch wants to know where the check
+           for the next branch starts. It's right now. */
+        uint16_t patch = lily_u16_pop(emit->patches);
+
+        if (patch != (uint16_t)-1)
+            lily_u16_insert(emit->code, patch,
+                    lily_u16_pos(emit->code) - emit->block->jump_offset);
+        /* else it's a fake branch from a condition that was optimized out. */
+    }
 
     lily_u16_write_1(emit->patches, save_jump);
     emit->block->block_type = new_type;
@@ -1083,11 +1131,14 @@ static void close_over_sym(lily_emit_state *emit, lily_sym *sym)
 /* This writes o_create_function which will create a copy of 'func_sym' but
    with closure information. 'target' is a storage where the closed-over copy
    will end up. The result cannot be cached in any way (each invocation should
-   get a fresh set of cells). */
-static void emit_create_function(lily_emit_state *emit, lily_sym *func_sym,
-        lily_storage *target)
+   get a fresh set of cells).
+   If the copy is known to not outlive the expression it's made for, then
+   o_create_local_function should be used instead. The vm won't give those
+   copies to the gc. */
+static void emit_create_function(lily_emit_state *emit, uint16_t opcode,
+        lily_sym *func_sym, lily_storage *target)
 {
-    lily_u16_write_4(emit->code, o_create_function, 0, func_sym->reg_spot,
+    lily_u16_write_4(emit->code, opcode, 0, func_sym->reg_spot,
             target->reg_spot);
     emit->function_block->make_closure = 1;
 }
@@ -1374,119 +1425,1667 @@ static void perform_closure_transform(lily_emit_state *emit,
     } \
 }
 
-    uint16_t patch_start = lily_u16_pos(emit->patches);
+    uint16_t back_start = lily_u16_pos(emit->patches);
+
+    /* Jumps that go backward (the bottom of a loop) land on code that has
+       already been transformed by the time the jump is seen. Find where those
+       jumps go first, so the new position can be saved while passing by. These
+       are pairs of (target, new position) before the forward patches. */
+    while (lily_ci_next(&ci)) {
+        if (ci.jumps_7) {
+            uint16_t *buffer = ci.buffer;
+            int stop = ci.offset + ci.round_total;
+            int i;
+
+            for (i = stop - ci.jumps_7;i < stop;i++) {
+                if (buffer[i] + start <= ci.offset)
+                    lily_u16_write_2(emit->patches, buffer[i] + start, 0);
+            }
+        }
+    }
+
+    lily_ci_init(&ci, emit->code->data, start, lily_u16_pos(emit->code));
+
+    uint16_t patch_start = lily_u16_pos(emit->patches);
+
+    /* The try table has positions of this function's code, which will move.
+       The new positions are written after the table as pairs of (index, new
+       position), then put into the table once the transform is done. */
+    lily_buffer_u16 *try_table = emit->try_table;
+    uint16_t try_start = emit->block->try_start;
+    uint16_t try_stop = lily_u16_pos(try_table);
+
+    while (lily_ci_next(&ci)) {
+        uint16_t *buffer = ci.buffer;
+        int i;
+        int pos = ci.offset + 1;
+        int output_start = 0;
+        /* Jumps to this op need to land before any upvalue loads it needs. */
+        int aux_start = lily_u16_pos(emit->closure_aux_code);
+        lily_opcode op = buffer[ci.offset];
+
+        pos += ci.line;
+
+        if (ci.special_1) {
+            switch (op) {
+                case o_create_function:
+                case o_create_local_function:
+                    /* The first special of this opcode is the register of the
+                       closure, which was only recently made. Fix the buffer,
+                       and the write that happens later will do the rest. */
+                    buffer[pos] = s->reg_spot;
+                    pos++;
+                    break;
+                case o_function_call:
+                case o_match_dispatch:
+                case o_variant_decompose:
+                    MAYBE_TRANSFORM_INPUT(pos, o_get_upvalue)
+                default:
+                    pos += ci.special_1;
+                    break;
+            }
+        }
+
+        pos += ci.counter_2;
+
+        if (ci.inputs_3) {
+            for (i = 0;i < ci.inputs_3;i++) {
+                MAYBE_TRANSFORM_INPUT(pos, o_get_upvalue)
+            }
+
+            pos += ci.inputs_3;
+        }
+
+        if (ci.special_4) {
+            switch (op) {
+                case o_create_function:
+                case o_create_local_function:
+                case o_load_class_closure:
+                case o_load_closure:
+                    pos += ci.special_4;
+                    break;
+                default:
+                    lily_raise(emit->raiser, lily_Error,
+                            "Special value #4 for opcode %d not handled.\n",
+                            op);
+            }
+        }
+
+        if (ci.outputs_5) {
+            output_start = pos;
+            pos += ci.outputs_5;
+        }
+
+        if (ci.special_6) {
+            lily_opcode op = buffer[ci.offset];
+            switch (op) {
+                case o_native_call:
+                case o_foreign_call:
+                case o_function_call:
+                    for (i = 0;i < ci.special_6;i++) {
+                        MAYBE_TRANSFORM_INPUT(pos + i, o_get_upvalue)
+                    }
+                    pos += ci.special_6;
+                    break;
+                case o_except_ignore:
+                    /* This is the unused register, which is always 0. */
+                    pos += ci.special_6;
+                    break;
+                default:
+                    lily_raise(emit->raiser, lily_Error,
+                            "Special value #6 for opcode %d not handled.\n",
+                            op);
+            }
+        }
+
+        for (i = patch_start;i != lily_u16_pos(emit->patches);i += 2) {
+            int where = emit->patches->data[i + 1];
+            if (ci.offset == where) {
+                emit->closure_aux_code->data[emit->patches->data[i]] =
+                        aux_start;
+            }
+        }
+
+        for (i = back_start;i != patch_start;i += 2) {
+            if (emit->patches->data[i] == ci.offset)
+                emit->patches->data[i + 1] = aux_start;
+        }
+
+        for (i = try_start;i != try_stop;i++) {
+            if (try_table->data[i] + start == ci.offset)
+                lily_u16_write_2(try_table, i, aux_start);
+        }
+
+        int stop = ci.offset + ci.round_total - ci.jumps_7;
+        for (i = ci.offset;i < stop;i++)
+            lily_u16_write_1(emit->closure_aux_code, buffer[i]);
+
+        if (ci.jumps_7) {
+            int i;
+            for (i = 0;i < ci.jumps_7;i++) {
+                int target = buffer[stop + i] + start;
+
+                if (target <= ci.offset) {
+                    int j;
+                    for (j = back_start;j != patch_start;j += 2) {
+                        if (emit->patches->data[j] == target)
+                            break;
+                    }
+
+                    lily_u16_write_1(emit->closure_aux_code,
+                            emit->patches->data[j + 1]);
+                    continue;
+                }
+
+                lily_u16_write_1(emit->closure_aux_code, 0);
+
+                /* Insert a pairing of the position just written, and the target
+                   of that position. The target is forward, so the position will
+                   be fixed when the target is reached. */
+                lily_u16_write_2(emit->patches,
+                        lily_u16_pos(emit->closure_aux_code) - 1, target);
+            }
+        }
+
+        if (ci.outputs_5) {
+            int stop = output_start + ci.outputs_5;
+
+            for (i = output_start;i < stop;i++) {
+                MAYBE_TRANSFORM_INPUT(i, o_set_upvalue)
+            }
+        }
+    }
+
+    int i;
+    for (i = try_stop;i != lily_u16_pos(try_table);i += 2)
+        try_table->data[try_table->data[i]] = try_table->data[i + 1];
+
+    lily_u16_set_pos(try_table, try_stop);
+}
+
+/** Before the code of a function is frozen, it's given to a peephole pass to
+    clean up what the emitter leaves behind. The emitter writes code as it goes
+    along, so it can't see how one expression or block ends up next to another.
+    This pass is only run over functions (not __main__, which is still being
+    written to while it runs). It does the following:
+
+    * Jumps that land on an unconditional jump are sent to where that jump
+      goes. This happens when loops and if blocks are nested.
+    * Unconditional jumps to the very next instruction are removed.
+    * When an instruction writes to a storage, and is followed by an assign
+      from that storage into a local, the instruction writes to the local
+      instead. This happens with compound assignments (ex: 'a += 1'). The
+      storage has to be written again before it's read, on every path that
+      leaves the assign.
+
+    Removing instructions moves the ones that come after. The map holds where
+    each position goes, so that jumps and the try table can be fixed. **/
+
+# define OPT_START   0x1
+# define OPT_TARGET  0x2
+# define OPT_DELETE  0x4
+# define OPT_STORAGE 0x1
+
+static int is_jump_op(uint16_t op)
+{
+    return op == o_jump ||
+           op == o_jump_if ||
+           op == o_integer_for ||
+           (op >= o_jump_if_integer_eq && op <= o_jump_if_double_greater_eq);
+}
+
+/* These are the ranges of an instruction that hold registers. Calls have the
+   function apart from the arguments, so reads can be in two ranges. */
+typedef struct {
+    uint16_t read_start;
+    uint16_t read_stop;
+    uint16_t arg_start;
+    uint16_t arg_stop;
+    uint16_t write_start;
+    uint16_t write_stop;
+} opt_operands;
+
+static void opt_get_operands(lily_code_iter *ci, opt_operands *ops)
+{
+    uint16_t op = ci->opcode;
+    int pos = ci->offset + 1 + ci->line;
+
+    switch (op) {
+        /* These have a register where the code iter says there's a special.
+           The inputs of o_set_global are the global, not a register. */
+        case o_function_call:
+        case o_match_dispatch:
+        case o_variant_decompose:
+        case o_create_function:
+        case o_create_local_function:
+        case o_set_global:
+            ops->read_start = pos;
+            ops->read_stop = pos + 1;
+            break;
+        default:
+            ops->read_start = pos + ci->special_1 + ci->counter_2;
+            ops->read_stop = ops->read_start + ci->inputs_3;
+            break;
+    }
+
+    pos += ci->special_1 + ci->counter_2 + ci->inputs_3 + ci->special_4;
+    ops->write_start = pos;
+    ops->write_stop = pos + ci->outputs_5;
+
+    if (op == o_native_call || op == o_foreign_call ||
+        op == o_function_call) {
+        ops->arg_start = ops->write_stop;
+        ops->arg_stop = ops->write_stop + ci->special_6;
+    }
+    else {
+        ops->arg_start = 0;
+        ops->arg_stop = 0;
+    }
+}
+
+static int opt_range_has(uint16_t *buffer, int start, int stop, uint16_t reg)
+{
+    int i;
+
+    for (i = start;i < stop;i++) {
+        if (buffer[i] == reg)
+            return 1;
+    }
+
+    return 0;
+}
+
+/* Does the instruction that 'ci' is at read from 'reg'? Opcodes with inputs
+   that are hard to tell apart say yes to be safe. */
+static int opt_reads_reg(lily_code_iter *ci, uint16_t reg)
+{
+    opt_operands ops;
+
+    if (ci->opcode == o_optarg_dispatch ||
+        ci->opcode == o_except_catch ||
+        ci->opcode == o_except_ignore)
+        return 1;
+
+    opt_get_operands(ci, &ops);
+
+    return opt_range_has(ci->buffer, ops.read_start, ops.read_stop, reg) ||
+           opt_range_has(ci->buffer, ops.arg_start, ops.arg_stop, reg);
+}
+
+static int opt_writes_reg(lily_code_iter *ci, uint16_t reg)
+{
+    opt_operands ops;
+
+    opt_get_operands(ci, &ops);
+
+    return opt_range_has(ci->buffer, ops.write_start, ops.write_stop, reg);
+}
+
+/* Starting from 'start', is 'reg' always written before it is read? This
+   follows jumps, and gives up (saying no) if it has to look too far. */
+static int opt_reg_is_dead(uint16_t *code, uint16_t size, uint16_t start,
+        uint16_t reg)
+{
+    uint16_t stack[16];
+    int top = 0, budget = 64;
+    lily_code_iter ci;
+
+    stack[top] = start;
+    top++;
+
+    while (top) {
+        top--;
+        uint16_t pos = stack[top];
+
+        while (1) {
+            budget--;
+            if (budget == 0)
+                return 0;
+
+            lily_ci_init(&ci, code, pos, size);
+            if (lily_ci_next(&ci) == 0)
+                return 0;
+
+            if (opt_reads_reg(&ci, reg))
+                return 0;
+
+            if (opt_writes_reg(&ci, reg))
+                break;
+
+            uint16_t op = ci.opcode;
+
+            if (op == o_return_val || op == o_return_noval || op == o_raise)
+                break;
+            else if (op == o_jump) {
+                pos = code[pos + 1];
+                continue;
+            }
+            else if (is_jump_op(op)) {
+                if (top == 16)
+                    return 0;
+
+                stack[top] = code[pos + ci.round_total - 1];
+                top++;
+            }
+            else if (ci.jumps_7)
+                return 0;
+
+            pos += ci.round_total;
+        }
+    }
+
+    return 1;
+}
+
+/* This tries to have the instruction at 'prev' write to where the assign at
+   'ci' goes. If it can, the assign is marked to be deleted. */
+static void opt_forward_assign(uint16_t *code, uint16_t *map, uint16_t size,
+        lily_code_iter *prev, lily_code_iter *ci)
+{
+    uint16_t *storages = map + size + 1;
+    uint16_t op = prev->opcode;
+
+    if (map[ci->offset] & OPT_TARGET ||
+        prev->outputs_5 != 1 ||
+        op == o_integer_for ||
+        op == o_except_catch ||
+        op == o_variant_decompose ||
+        (op >= o_new_instance_basic && op <= o_new_instance_tagged) ||
+        (op >= o_create_closure && op <= o_load_closure))
+        return;
+
+    int out_pos = prev->offset + 1 + prev->line + prev->special_1 +
+            prev->counter_2 + prev->inputs_3 + prev->special_4;
+    uint16_t from = code[ci->offset + 2];
+    uint16_t to = code[ci->offset + 3];
+
+    /* Simple ops are done reading their inputs before the result is written,
+       so they can write to one of their inputs. */
+    int simple_op = (op >= o_integer_add && op <= o_string_greater_eq) ||
+                    op == o_unary_not || op == o_unary_minus;
+
+    if (code[out_pos] != from ||
+        (storages[from] & OPT_STORAGE) == 0 ||
+        from == to ||
+        (simple_op == 0 && opt_reads_reg(prev, to)) ||
+        opt_reg_is_dead(code, size, ci->offset + ci->round_total, from) == 0)
+        return;
+
+    code[out_pos] = to;
+    map[ci->offset] |= OPT_DELETE;
+}
+
+/* This runs the peephole pass over 'code', which has 'size' positions. The
+   storages of the function are used to tell them apart from locals. The new
+   size of the code is returned. */
+static uint16_t optimize_code(lily_emit_state *emit, lily_block *function_block,
+        uint16_t *code, uint16_t size)
+{
+    int reg_count = function_block->next_reg_spot;
+    lily_buffer_u16 *map_buffer = emit->optimize_map;
+
+    lily_u16_set_pos(map_buffer, 0);
+    lily_u16_write_prep(map_buffer, size + 1 + reg_count);
+
+    uint16_t *map = map_buffer->data;
+    uint16_t *storages = map + size + 1;
+    uint16_t *try_entries = emit->try_table->data + function_block->try_start;
+    int try_size = lily_u16_pos(emit->try_table) - function_block->try_start;
+    lily_code_iter ci, prev;
+    int i;
+
+    memset(map, 0, (size + 1 + reg_count) * sizeof(uint16_t));
+
+    lily_storage *storage_iter = function_block->storage_start;
+    while (storage_iter) {
+        if (storage_iter->type)
+            storages[storage_iter->reg_spot] = OPT_STORAGE;
+
+        storage_iter = storage_iter->next;
+    }
+
+    /* Find out where instructions start, and which ones are jumped to. */
+    lily_ci_init(&ci, code, 0, size);
+    while (lily_ci_next(&ci)) {
+        map[ci.offset] |= OPT_START;
+
+        int jump_pos = ci.offset + ci.round_total - ci.jumps_7;
+        for (i = 0;i < ci.jumps_7;i++)
+            map[code[jump_pos + i]] |= OPT_TARGET;
+    }
+
+    for (i = 0;i < try_size;i += 3) {
+        map[try_entries[i]] |= OPT_TARGET;
+        map[try_entries[i + 2]] |= OPT_TARGET;
+    }
+
+    /* Jump threading goes first, so that a jump it leaves pointing to the next
+       instruction is removed. */
+    lily_ci_init(&ci, code, 0, size);
+    while (lily_ci_next(&ci)) {
+        if (is_jump_op(ci.opcode) == 0)
+            continue;
+
+        int jump_pos = ci.offset + ci.round_total - 1;
+        uint16_t target = code[jump_pos];
+
+        /* The limit stops loops that only jump to each other. */
+        for (i = 0;i < 8;i++) {
+            if (code[target] != o_jump || (map[target] & OPT_START) == 0)
+                break;
+
+            target = code[target + 1];
+        }
+
+        code[jump_pos] = target;
+    }
+
+    prev.opcode = o_return_from_vm;
+    lily_ci_init(&ci, code, 0, size);
+    while (lily_ci_next(&ci)) {
+        if (ci.opcode == o_jump &&
+            code[ci.offset + 1] == ci.offset + 2)
+            map[ci.offset] |= OPT_DELETE;
+        else if ((ci.opcode == o_assign || ci.opcode == o_fast_assign) &&
+                 prev.opcode != o_return_from_vm)
+            opt_forward_assign(code, map, size, &prev, &ci);
+
+        /* An assign that was removed has its write done by 'prev' now, so the
+           next assign looks at that instead. */
+        if ((map[ci.offset] & OPT_DELETE) == 0)
+            prev = ci;
+    }
+
+    /* Turn the flags into where each position moves to. A position within an
+       instruction that is removed goes to what's after the instruction. */
+    int removed = 0;
+
+    lily_ci_init(&ci, code, 0, size);
+    while (lily_ci_next(&ci)) {
+        int stop = ci.offset + ci.round_total;
+
+        if (map[ci.offset] & OPT_DELETE) {
+            for (i = ci.offset;i < stop;i++)
+                map[i] = ci.offset - removed;
+
+            removed += ci.round_total;
+        }
+        else {
+            for (i = ci.offset;i < stop;i++)
+                map[i] = i - removed;
+        }
+    }
+
+    map[size] = size - removed;
+
+    if (removed == 0)
+        return size;
+
+    for (i = 0;i < try_size;i++)
+        try_entries[i] = map[try_entries[i]];
+
+    /* Fix the jumps, then move the instructions that are kept down. Every
+       position of a removed instruction maps to the same place, which is how
+       they're told apart. Instructions only move backward, so this can be done
+       in place. */
+    int write_pos = 0;
+
+    lily_ci_init(&ci, code, 0, size);
+    while (lily_ci_next(&ci)) {
+        if (map[ci.offset] == map[ci.offset + 1])
+            continue;
+
+        int jump_pos = ci.offset + ci.round_total - ci.jumps_7;
+        for (i = 0;i < ci.jumps_7;i++)
+            code[jump_pos + i] = map[code[jump_pos + i]];
+
+        memmove(code + write_pos, code + ci.offset,
+                ci.round_total * sizeof(uint16_t));
+        write_pos += ci.round_total;
+    }
+
+    return write_pos;
+}
+
+/** After the peephole pass, the registers of the function are packed. Storages
+    are handed out as expressions need them, so a function with a lot of
+    temporaries ends up with a lot of registers, even if few are in use at the
+    same time. Each call has to clear all of them, so fewer is better.
+
+    Liveness is found by walking the code backward until nothing changes. The
+    next instruction, jump targets, and the except clauses of an enclosing try
+    are where an instruction can go next. Each storage gets a bitset of where
+    it's live or written, and storages that have no bits in common can share a
+    register. A register is only shared by storages of the same type, or by
+    storages that all hold plain values (Integer, Double, Boolean). This is
+    because some opcodes write to a register without dropping what was there
+    before.
+
+    Parameters stay where they are, and each var gets a register of its own.
+    Storages that can be read before they're written, or that hold a closure,
+    are given a register of their own too. **/
+
+# define PACK_STORAGE 0x1
+# define PACK_SEEN    0x2
+# define PACK_PINNED  0x4
+
+/* Functions too large to be worth the bits are left alone. */
+# define PACK_BIT_LIMIT (1 << 22)
+
+# define PACK_NONE UINT16_MAX
+
+/* This is what's known about the storages of a function. The arrays are in the
+   optimize map, except for 'live' and 'succs', which are allocated together.
+   Register packing and the loop pass both use this. */
+typedef struct {
+    /* PACK_* flags of each register. */
+    uint16_t *flags;
+    /* The number of each storage (by register), or PACK_NONE. */
+    uint16_t *index;
+    /* The register of each storage (by number). */
+    uint16_t *storage_reg;
+    /* The instruction at each position of the code, and where each
+       instruction is. */
+    uint16_t *instr_at;
+    uint16_t *instr_pos;
+    /* Where each instruction can go next. Those of instruction 'k' are from
+       succ_start[k] up to succ_start[k + 1]. */
+    uint16_t *succ_start;
+    uint16_t *succs;
+    /* Space for the caller to use, which is 'extra' per register. */
+    uint16_t *extra;
+    /* The storages that are live going into each instruction. */
+    uint32_t *live;
+    /* Bits for one instruction, for the caller to use. */
+    uint32_t *scratch;
+    int storage_count;
+    int instr_count;
+    int live_words;
+} opt_liveness;
+
+/* This numbers the storages in code[start...stop) that haven't been seen yet,
+   and returns the new number of storages. */
+static int pack_number(uint16_t *flags, uint16_t *index, uint16_t *storage_reg,
+        int storage_count, uint16_t *code, int start, int stop)
+{
+    int i;
+
+    for (i = start;i < stop;i++) {
+        uint16_t reg = code[i];
+
+        if ((flags[reg] & (PACK_STORAGE | PACK_SEEN)) == PACK_STORAGE) {
+            index[reg] = storage_count;
+            storage_reg[storage_count] = reg;
+            storage_count++;
+        }
+
+        flags[reg] |= PACK_SEEN;
+    }
+
+    return storage_count;
+}
+
+/* This marks each storage in code[start...stop) into 'bits'. */
+static void pack_set_bits(uint32_t *bits, uint16_t *code, uint16_t *index,
+        int start, int stop)
+{
+    int i;
+
+    for (i = start;i < stop;i++) {
+        uint16_t s = index[code[i]];
+
+        if (s != PACK_NONE)
+            bits[s / 32] |= 1u << (s % 32);
+    }
+}
+
+static int live_has(opt_liveness *lv, int instr, uint16_t s)
+{
+    return (lv->live[(instr * lv->live_words) + (s / 32)] &
+            (1u << (s % 32))) != 0;
+}
+
+/* This finds where the storages of 'code' are live. This returns 0 if the
+   function is too large, in which case nothing is allocated. */
+static int find_liveness(lily_emit_state *emit, lily_block *function_block,
+        uint16_t *code, uint16_t size, int extra, opt_liveness *lv)
+{
+    int reg_count = function_block->next_reg_spot;
+    lily_buffer_u16 *map_buffer = emit->optimize_map;
+
+    lily_u16_set_pos(map_buffer, 0);
+    lily_u16_write_prep(map_buffer,
+            (reg_count * (3 + extra)) + (size * 3) + 2);
+
+    uint16_t *flags = map_buffer->data;
+    uint16_t *index = flags + reg_count;
+    uint16_t *storage_reg = index + reg_count;
+    uint16_t *instr_at = storage_reg + reg_count;
+    uint16_t *instr_pos = instr_at + size + 1;
+    uint16_t *succ_start = instr_pos + size;
+    lily_storage *storage_iter;
+    lily_code_iter ci;
+    opt_operands ops;
+    int i, j, k, storage_count = 0, instr_count = 0;
+
+    lv->flags = flags;
+    lv->index = index;
+    lv->storage_reg = storage_reg;
+    lv->instr_at = instr_at;
+    lv->instr_pos = instr_pos;
+    lv->succ_start = succ_start;
+    lv->extra = succ_start + size + 1;
+
+    memset(flags, 0, reg_count * sizeof(uint16_t));
+
+    for (storage_iter = function_block->storage_start;
+         storage_iter;
+         storage_iter = storage_iter->next) {
+        if (storage_iter->type)
+            flags[storage_iter->reg_spot] = PACK_STORAGE;
+    }
+
+    /* Storages are numbered by where they're first used. */
+    for (i = 0;i < reg_count;i++)
+        index[i] = PACK_NONE;
+
+    lily_ci_init(&ci, code, 0, size);
+    while (lily_ci_next(&ci)) {
+        instr_at[ci.offset] = instr_count;
+        instr_pos[instr_count] = ci.offset;
+        instr_count++;
+
+        opt_get_operands(&ci, &ops);
+
+        storage_count = pack_number(flags, index, storage_reg, storage_count,
+                code, ops.read_start, ops.read_stop);
+        storage_count = pack_number(flags, index, storage_reg, storage_count,
+                code, ops.arg_start, ops.arg_stop);
+        storage_count = pack_number(flags, index, storage_reg, storage_count,
+                code, ops.write_start, ops.write_stop);
+
+        if (ci.opcode == o_create_closure ||
+            ci.opcode == o_load_closure ||
+            ci.opcode == o_load_class_closure)
+            flags[code[ops.write_start]] |= PACK_PINNED;
+    }
+
+    instr_at[size] = PACK_NONE;
+
+    int live_words = (storage_count + 31) / 32;
+
+    lv->storage_count = storage_count;
+    lv->instr_count = instr_count;
+    lv->live_words = live_words;
+
+    if (storage_count == 0 ||
+        instr_count * live_words > PACK_BIT_LIMIT / 32)
+        return 0;
+
+    /* Where each instruction can go next is written to the patches, then
+       moved over. */
+    uint16_t *try_entries = emit->try_table->data + function_block->try_start;
+    int try_size = lily_u16_pos(emit->try_table) - function_block->try_start;
+    int succ_base = lily_u16_pos(emit->patches);
+
+    for (k = 0;k < instr_count;k++) {
+        uint16_t offset = instr_pos[k];
+
+        lily_ci_init(&ci, code, offset, size);
+        lily_ci_next(&ci);
+
+        succ_start[k] = lily_u16_pos(emit->patches) - succ_base;
+
+        if (ci.opcode != o_jump &&
+            ci.opcode != o_return_val &&
+            ci.opcode != o_return_noval &&
+            ci.opcode != o_return_from_vm &&
+            ci.opcode != o_raise &&
+            k + 1 < instr_count)
+            lily_u16_write_1(emit->patches, k + 1);
+
+        int jump_pos = offset + ci.round_total - ci.jumps_7;
+
+        for (i = 0;i < ci.jumps_7;i++) {
+            uint16_t target = code[jump_pos + i];
+
+            if (target < size && instr_at[target] != PACK_NONE)
+                lily_u16_write_1(emit->patches, instr_at[target]);
+        }
+
+        for (i = 0;i < try_size;i += 3) {
+            if (try_entries[i] <= offset && offset <= try_entries[i + 1] &&
+                try_entries[i + 2] < size)
+                lily_u16_write_1(emit->patches, instr_at[try_entries[i + 2]]);
+        }
+    }
+
+    int succ_count = lily_u16_pos(emit->patches) - succ_base;
+    int live_size = (instr_count + 1) * live_words;
+
+    succ_start[instr_count] = succ_count;
+
+    uint32_t *live = lily_malloc((live_size * sizeof(uint32_t)) +
+            (succ_count * sizeof(uint16_t)));
+    uint32_t *scratch = live + (instr_count * live_words);
+    uint16_t *succs = (uint16_t *)(live + live_size);
+    int changed;
+
+    memcpy(succs, emit->patches->data + succ_base,
+            succ_count * sizeof(uint16_t));
+    lily_u16_set_pos(emit->patches, succ_base);
+    memset(live, 0, instr_count * live_words * sizeof(uint32_t));
+
+    lv->live = live;
+    lv->scratch = scratch;
+    lv->succs = succs;
+
+    /* What's live going into an instruction is what's live after it, minus
+       what it writes, plus what it reads. This walks backward until nothing
+       changes, which takes more than one pass if there are loops. */
+    do {
+        changed = 0;
+
+        for (k = instr_count - 1;k >= 0;k--) {
+            uint32_t *live_in = live + (k * live_words);
+
+            memset(scratch, 0, live_words * sizeof(uint32_t));
+
+            for (i = succ_start[k];i < succ_start[k + 1];i++) {
+                uint32_t *live_next = live + (succs[i] * live_words);
+
+                for (j = 0;j < live_words;j++)
+                    scratch[j] |= live_next[j];
+            }
+
+            lily_ci_init(&ci, code, instr_pos[k], size);
+            lily_ci_next(&ci);
+            opt_get_operands(&ci, &ops);
+
+            for (i = ops.write_start;i < ops.write_stop;i++) {
+                uint16_t s = index[code[i]];
+
+                if (s != PACK_NONE)
+                    scratch[s / 32] &= ~(1u << (s % 32));
+            }
+
+            pack_set_bits(scratch, code, index, ops.read_start, ops.read_stop);
+            pack_set_bits(scratch, code, index, ops.arg_start, ops.arg_stop);
+
+            if (memcmp(live_in, scratch, live_words * sizeof(uint32_t))) {
+                memcpy(live_in, scratch, live_words * sizeof(uint32_t));
+                changed = 1;
+            }
+        }
+    } while (changed);
+
+    return 1;
+}
+
+/* This packs the registers of 'code', and returns how many are now used. */
+static int pack_registers(lily_emit_state *emit, lily_block *function_block,
+        uint16_t *code, uint16_t size)
+{
+    int reg_count = function_block->next_reg_spot;
+    int arg_count = function_block->function_var->type->subtype_count - 1;
+    opt_liveness lv;
+
+    if (find_liveness(emit, function_block, code, size, 3, &lv) == 0)
+        return reg_count;
+
+    int storage_count = lv.storage_count;
+    int instr_count = lv.instr_count;
+    int live_words = lv.live_words;
+    int instr_words = (instr_count + 31) / 32;
+
+    if (storage_count < 2 ||
+        storage_count * instr_words * 2 > PACK_BIT_LIMIT / 32) {
+        lily_free(lv.live);
+        return reg_count;
+    }
+
+    uint16_t *flags = lv.flags;
+    uint16_t *index = lv.index;
+    uint16_t *storage_reg = lv.storage_reg;
+    uint16_t *group = lv.extra;
+    uint16_t *new_reg = group + reg_count;
+    uint16_t *slot_group = new_reg + reg_count;
+    uint32_t *live = lv.live;
+    uint32_t *scratch = lv.scratch;
+    uint32_t *occupied = lily_malloc(
+            storage_count * instr_words * 2 * sizeof(uint32_t));
+    uint32_t *slot_bits = occupied + (storage_count * instr_words);
+    lily_storage *storage_iter, *group_iter;
+    lily_code_iter ci;
+    opt_operands ops;
+    int i, j, k, group_count = 1;
+
+    /* Plain values are in group 0. Other storages share a group with the
+       first storage that has the same type. */
+    for (storage_iter = function_block->storage_start;
+         storage_iter;
+         storage_iter = storage_iter->next) {
+        if (storage_iter->type == NULL)
+            continue;
+
+        uint16_t spot = storage_iter->reg_spot;
+        int id = storage_iter->type->cls->id;
+
+        if (id == SYM_CLASS_INTEGER || id == SYM_CLASS_DOUBLE ||
+            id == SYM_CLASS_BOOLEAN) {
+            group[spot] = 0;
+            continue;
+        }
+
+        for (group_iter = function_block->storage_start;
+             group_iter != storage_iter;
+             group_iter = group_iter->next) {
+            if (group_iter->type == storage_iter->type)
+                break;
+        }
+
+        if (group_iter == storage_iter) {
+            group[spot] = group_count;
+            group_count++;
+        }
+        else
+            group[spot] = group[group_iter->reg_spot];
+    }
+
+    /* Flip it around, so each storage has the instructions it's live in or
+       written by. */
+    memset(occupied, 0, storage_count * instr_words * sizeof(uint32_t));
+
+    for (k = 0;k < instr_count;k++) {
+        uint32_t *live_in = live + (k * live_words);
+
+        lily_ci_init(&ci, code, lv.instr_pos[k], size);
+        lily_ci_next(&ci);
+        opt_get_operands(&ci, &ops);
+
+        memcpy(scratch, live_in, live_words * sizeof(uint32_t));
+        pack_set_bits(scratch, code, index, ops.write_start, ops.write_stop);
+
+        for (i = 0;i < storage_count;i++) {
+            if (scratch[i / 32] & (1u << (i % 32)))
+                occupied[(i * instr_words) + (k / 32)] |= 1u << (k % 32);
+        }
+    }
+
+    /* A storage that's live at the start can be read before it's written. */
+    for (i = 0;i < storage_count;i++) {
+        if (live_has(&lv, 0, i))
+            flags[storage_reg[i]] |= PACK_PINNED;
+    }
+
+    lily_free(live);
+
+    /* Parameters first, then vars and storages that can't be shared. */
+    int next_spot = 0;
+
+    for (i = 0;i < reg_count;i++) {
+        if (i < arg_count) {
+            new_reg[i] = i;
+            next_spot = i + 1;
+        }
+        else if ((flags[i] & PACK_SEEN) &&
+                 ((flags[i] & PACK_STORAGE) == 0 ||
+                  (flags[i] & PACK_PINNED))) {
+            new_reg[i] = next_spot;
+            next_spot++;
+        }
+    }
+
+    int slot_start = next_spot;
+
+    for (i = 0;i < storage_count;i++) {
+        uint16_t reg = storage_reg[i];
+        uint32_t *bits = occupied + (i * instr_words);
+        uint32_t *slot;
+
+        if (flags[reg] & PACK_PINNED)
+            continue;
+
+        for (j = 0;j < next_spot - slot_start;j++) {
+            if (slot_group[j] != group[reg])
+                continue;
+
+            slot = slot_bits + (j * instr_words);
+
+            for (k = 0;k < instr_words;k++) {
+                if (slot[k] & bits[k])
+                    break;
+            }
+
+            if (k == instr_words)
+                break;
+        }
+
+        slot = slot_bits + (j * instr_words);
+
+        if (j == next_spot - slot_start) {
+            slot_group[j] = group[reg];
+            memset(slot, 0, instr_words * sizeof(uint32_t));
+            next_spot++;
+        }
+
+        for (k = 0;k < instr_words;k++)
+            slot[k] |= bits[k];
+
+        new_reg[reg] = slot_start + j;
+    }
+
+    lily_free(occupied);
+
+    /* Storages are told where they went, so the type of each register can be
+       found afterward. */
+    for (storage_iter = function_block->storage_start;
+         storage_iter;
+         storage_iter = storage_iter->next) {
+        if (storage_iter->type == NULL)
+            continue;
+
+        uint16_t spot = storage_iter->reg_spot;
+
+        if (flags[spot] & PACK_SEEN)
+            storage_iter->reg_spot = new_reg[spot];
+        else
+            storage_iter->reg_spot = PACK_NONE;
+    }
+
+    lily_ci_init(&ci, code, 0, size);
+    while (lily_ci_next(&ci)) {
+        opt_get_operands(&ci, &ops);
+
+        for (i = ops.read_start;i < ops.read_stop;i++)
+            code[i] = new_reg[code[i]];
+
+        for (i = ops.arg_start;i < ops.arg_stop;i++)
+            code[i] = new_reg[code[i]];
+
+        for (i = ops.write_start;i < ops.write_stop;i++)
+            code[i] = new_reg[code[i]];
+    }
+
+    return next_spot;
+}
+
+/** Loops are found through the jumps that go backward, once the peephole pass
+    is done. An instruction within a loop that gives the same value each time
+    around is moved in front of the loop, so that it's only run once. That's
+    the case for literals, for math on registers that the loop doesn't write
+    to, and for a few loads that nothing in the loop can change. Instructions
+    are only moved if they can't raise, since they now run even if the loop
+    body doesn't.
+
+    The storage an instruction writes to is usually used for other values
+    elsewhere in the loop. So the instruction that's moved writes to a new
+    storage, and the reads that come right after it use that storage instead.
+    Liveness is used to make sure that nothing else could see what the
+    instruction wrote. Instructions that are the same share one new storage.
+
+    Jumps into the loop from outside go to the moved instructions, while jumps
+    from within (a 'continue', or the jump back) skip over them. **/
+
+# define HOIST_TARGET  0x1
+# define HOIST_DELETE  0x2
+
+/* This is how much code can be moved in front of one loop. */
+# define HOIST_LIMIT   64
+
+static int is_hoist_op(uint16_t op)
+{
+    switch (op) {
+        case o_get_integer:
+        case o_get_boolean:
+        case o_get_readonly:
+        case o_integer_add:
+        case o_integer_minus:
+        case o_integer_mul:
+        case o_left_shift:
+        case o_right_shift:
+        case o_bitwise_and:
+        case o_bitwise_or:
+        case o_bitwise_xor:
+        case o_double_add:
+        case o_double_minus:
+        case o_double_mul:
+        case o_integer_eq:
+        case o_integer_not_eq:
+        case o_integer_less:
+        case o_integer_less_eq:
+        case o_integer_greater:
+        case o_integer_greater_eq:
+        case o_double_eq:
+        case o_double_not_eq:
+        case o_double_less:
+        case o_double_less_eq:
+        case o_double_greater:
+        case o_double_greater_eq:
+        case o_unary_not:
+        case o_unary_minus:
+        case o_get_property:
+        case o_foreign_call:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+static int is_call_op(uint16_t op)
+{
+    return op == o_native_call ||
+           op == o_foreign_call ||
+           op == o_function_call;
+}
+
+/* Is the instruction at 'a' the same as the one at 'b', aside from the line
+   and where the result goes? */
+static int same_hoist(uint16_t *a, uint16_t *b, lily_code_iter *ci,
+        opt_operands *ops)
+{
+    int i, offset = ci->offset;
+
+    if (a[0] != b[0])
+        return 0;
+
+    for (i = 2;i < ci->round_total;i++) {
+        if (offset + i >= ops->write_start && offset + i < ops->write_stop)
+            continue;
+
+        if (a[i] != b[i])
+            return 0;
+    }
+
+    return 1;
+}
+
+/* This returns the type of the storage at 'reg', or NULL if 'reg' isn't a
+   storage. */
+static lily_type *type_of_storage(lily_block *function_block, uint16_t reg)
+{
+    lily_storage *storage_iter = function_block->storage_start;
+
+    while (storage_iter) {
+        if (storage_iter->type && storage_iter->reg_spot == reg)
+            return storage_iter->type;
+
+        storage_iter = storage_iter->next;
+    }
+
+    return NULL;
+}
+
+/* This looks for the loop that is 'loop_num' from the start of the code, and
+   moves what it can out of it. This returns 0 if there's no such loop. */
+static int hoist_loop(lily_emit_state *emit, lily_block *function_block,
+        lily_buffer_u16 *buffer, int code_start, uint16_t *size_ptr,
+        int loop_num)
+{
+    uint16_t size = *size_ptr;
+    uint16_t *code = buffer->data + code_start;
+    uint16_t loop_start = 0, loop_stop = 0;
+    int back_start = lily_u16_pos(emit->patches);
+    int i, j, k, found = 0;
+    lily_code_iter ci;
+    opt_operands ops;
+
+    /* A loop with a 'continue' has more than one jump back. The last one is
+       where the loop ends. */
+    lily_ci_init(&ci, code, 0, size);
+    while (lily_ci_next(&ci)) {
+        int jump_pos = ci.offset + ci.round_total - ci.jumps_7;
+
+        for (i = 0;i < ci.jumps_7;i++) {
+            if (code[jump_pos + i] <= ci.offset)
+                lily_u16_write_2(emit->patches, code[jump_pos + i],
+                        ci.offset + ci.round_total);
+        }
+    }
+
+    uint16_t *back_edges = emit->patches->data + back_start;
+    int back_count = lily_u16_pos(emit->patches) - back_start;
+
+    for (i = 0;i < back_count;i += 2) {
+        for (j = i + 2;j < back_count;j += 2) {
+            if (back_edges[j] == back_edges[i])
+                break;
+        }
+
+        if (j != back_count)
+            continue;
+
+        if (found == loop_num) {
+            loop_start = back_edges[i];
+            loop_stop = back_edges[i + 1];
+            break;
+        }
+
+        found++;
+    }
+
+    lily_u16_set_pos(emit->patches, back_start);
+
+    if (i >= back_count)
+        return 0;
+
+    /* Mark every place that a jump or an except clause goes to. Loops that can
+       be entered other than from the top are left alone. */
+    uint16_t *try_entries = emit->try_table->data + function_block->try_start;
+    int try_size = lily_u16_pos(emit->try_table) - function_block->try_start;
+    uint16_t *pos_flags = lily_malloc((size + 1) * 2 * sizeof(uint16_t));
+    uint16_t *map = pos_flags + size + 1;
+
+    memset(pos_flags, 0, (size + 1) * sizeof(uint16_t));
+
+    lily_ci_init(&ci, code, 0, size);
+    while (lily_ci_next(&ci)) {
+        int jump_pos = ci.offset + ci.round_total - ci.jumps_7;
+        int inside = (ci.offset >= loop_start && ci.offset < loop_stop);
+
+        for (i = 0;i < ci.jumps_7;i++) {
+            uint16_t target = code[jump_pos + i];
+
+            pos_flags[target] |= HOIST_TARGET;
+
+            if (inside == 0 && target > loop_start && target < loop_stop)
+                found = -1;
+        }
+    }
+
+    for (i = 0;i < try_size;i += 3) {
+        uint16_t handler = try_entries[i + 2];
+
+        pos_flags[handler] |= HOIST_TARGET;
+
+        if (handler > loop_start && handler < loop_stop &&
+            (try_entries[i] < loop_start || try_entries[i + 1] >= loop_stop))
+            found = -1;
+    }
+
+    opt_liveness lv;
+
+    if (found == -1 ||
+        find_liveness(emit, function_block, code, size, 2, &lv) == 0) {
+        lily_free(pos_flags);
+        return 1;
+    }
+
+    /* Find what the loop writes to, how many times each register is written
+       to, and if anything in the loop could change a property or the size of
+       a List. */
+    int reg_count = function_block->next_reg_spot;
+    uint16_t *written = lv.extra;
+    uint16_t *write_count = written + reg_count;
+    lily_var *size_var = lily_find_method(emit->symtab->list_class, "size");
+    uint32_t size_spot = size_var ? size_var->reg_spot : UINT32_MAX;
+    int has_call = 0;
+
+    memset(written, 0, reg_count * 2 * sizeof(uint16_t));
+
+    lily_ci_init(&ci, code, 0, size);
+    while (lily_ci_next(&ci)) {
+        int inside = (ci.offset >= loop_start && ci.offset < loop_stop);
+
+        opt_get_operands(&ci, &ops);
+
+        for (i = ops.write_start;i < ops.write_stop;i++) {
+            write_count[code[i]]++;
+            written[code[i]] |= inside;
+        }
+
+        /* These write to one of the registers that they're said to read. */
+        if (ci.opcode == o_for_setup || ci.opcode == o_integer_for) {
+            for (i = ops.read_start;i < ops.read_stop;i++) {
+                write_count[code[i]]++;
+                written[code[i]] |= inside;
+            }
+        }
+
+        if (inside && is_call_op(ci.opcode) &&
+            (ci.opcode != o_foreign_call || code[ci.offset + 2] != size_spot))
+            has_call = 1;
+    }
+
+    uint16_t hoisted[HOIST_LIMIT];
+    int hoist_pos = 0, removed = 0;
+    int first_instr = lv.instr_at[loop_start];
+    int stop_instr = (loop_stop == size) ? lv.instr_count
+                                         : lv.instr_at[loop_stop];
+
+    for (k = first_instr;k < stop_instr;k++) {
+        lily_ci_init(&ci, code, lv.instr_pos[k], size);
+        lily_ci_next(&ci);
+
+        if (is_hoist_op(ci.opcode) == 0 || ci.outputs_5 != 1)
+            continue;
+
+        uint16_t offset = ci.offset;
+        int ok = 1;
+
+        opt_get_operands(&ci, &ops);
+
+        /* Calls have their arguments after the result. */
+        int result_at = ops.write_start - offset;
+        uint16_t reg = code[ops.write_start];
+
+        if (reg >= reg_count || lv.index[reg] == PACK_NONE)
+            continue;
+
+        for (i = ops.read_start;i < ops.read_stop;i++) {
+            if (code[i] < reg_count && written[code[i]])
+                ok = 0;
+        }
+
+        for (i = ops.arg_start;i < ops.arg_stop;i++) {
+            if (code[i] < reg_count && written[code[i]])
+                ok = 0;
+        }
+
+        if (ci.opcode == o_foreign_call &&
+            (code[offset + 2] != size_spot || has_call))
+            ok = 0;
+        else if (ci.opcode == o_get_property) {
+            if (has_call)
+                ok = 0;
+
+            lily_code_iter set_ci;
+
+            lily_ci_init(&set_ci, code, loop_start, loop_stop);
+            while (lily_ci_next(&set_ci)) {
+                if (set_ci.opcode == o_set_property &&
+                    code[set_ci.offset + 2] == code[offset + 2])
+                    ok = 0;
+            }
+        }
+
+        if (ok == 0 || hoist_pos + ci.round_total > HOIST_LIMIT)
+            continue;
+
+        uint16_t s = lv.index[reg];
+
+        /* A storage written to only here (like one that an inner loop moved
+           code to) can move as it is. It can't be read before this within the
+           loop, since it would be live at the start. */
+        if (write_count[reg] == 1) {
+            if (live_has(&lv, first_instr, s))
+                continue;
+
+            memcpy(hoisted + hoist_pos, code + offset,
+                    ci.round_total * sizeof(uint16_t));
+            hoist_pos += ci.round_total;
+            written[reg] = 0;
+            pos_flags[offset] |= HOIST_DELETE;
+            removed += ci.round_total;
+            continue;
+        }
+
+        /* The reads that see what this writes are up to the end of the basic
+           block, or until the storage is written again. */
+        int last = k, redefined = 0, m;
+        lily_code_iter seg_ci;
+        opt_operands seg_ops;
+
+        for (m = k + 1;m < stop_instr;m++) {
+            if (pos_flags[lv.instr_pos[m]] & HOIST_TARGET)
+                break;
+
+            lily_ci_init(&seg_ci, code, lv.instr_pos[m], size);
+            lily_ci_next(&seg_ci);
+            opt_get_operands(&seg_ci, &seg_ops);
+
+            last = m;
+
+            if (opt_range_has(code, seg_ops.write_start, seg_ops.write_stop,
+                    reg)) {
+                redefined = 1;
+                break;
+            }
+
+            if (seg_ci.jumps_7 ||
+                seg_ci.opcode == o_return_val ||
+                seg_ci.opcode == o_return_noval ||
+                seg_ci.opcode == o_raise)
+                break;
+        }
+
+        for (m = k;m <= last && ok;m++) {
+            for (i = lv.succ_start[m];i < lv.succ_start[m + 1];i++) {
+                uint16_t next = lv.succs[i];
+
+                if (next == m + 1 && (m < last || redefined))
+                    continue;
+
+                if (live_has(&lv, next, s)) {
+                    ok = 0;
+                    break;
+                }
+            }
+        }
+
+        if (ok == 0)
+            continue;
+
+        /* Use the storage of the same instruction if it's already moved. */
+        uint16_t new_reg = PACK_NONE;
+        lily_code_iter hoist_ci;
+
+        lily_ci_init(&hoist_ci, hoisted, 0, hoist_pos);
+        while (lily_ci_next(&hoist_ci)) {
+            if (hoist_ci.round_total == ci.round_total &&
+                same_hoist(hoisted + hoist_ci.offset, code + offset, &ci,
+                        &ops)) {
+                new_reg = hoisted[hoist_ci.offset + result_at];
+                break;
+            }
+        }
+
+        if (new_reg == PACK_NONE) {
+            lily_type *type = type_of_storage(function_block, reg);
+
+            if (type == NULL)
+                continue;
+
+            new_reg = get_unique_storage(emit, type)->reg_spot;
+            memcpy(hoisted + hoist_pos, code + offset,
+                    ci.round_total * sizeof(uint16_t));
+            hoisted[hoist_pos + result_at] = new_reg;
+            hoist_pos += ci.round_total;
+        }
+
+        for (m = k + 1;m <= last;m++) {
+            lily_ci_init(&seg_ci, code, lv.instr_pos[m], size);
+            lily_ci_next(&seg_ci);
+            opt_get_operands(&seg_ci, &seg_ops);
+
+            for (i = seg_ops.read_start;i < seg_ops.read_stop;i++) {
+                if (code[i] == reg)
+                    code[i] = new_reg;
+            }
+
+            for (i = seg_ops.arg_start;i < seg_ops.arg_stop;i++) {
+                if (code[i] == reg)
+                    code[i] = new_reg;
+            }
+        }
+
+        pos_flags[offset] |= HOIST_DELETE;
+        removed += ci.round_total;
+    }
+
+    lily_free(lv.live);
+
+    if (hoist_pos == 0) {
+        lily_free(pos_flags);
+        return 1;
+    }
+
+    /* Build the new code, with the moved instructions in front of the loop and
+       the originals left out. */
+    int new_size = size - removed + hoist_pos;
+    uint16_t *out = lily_malloc(new_size * sizeof(uint16_t));
+    int write_pos = 0;
+
+    lily_ci_init(&ci, code, 0, size);
+    while (lily_ci_next(&ci)) {
+        if (ci.offset == loop_start) {
+            memcpy(out + write_pos, hoisted, hoist_pos * sizeof(uint16_t));
+            write_pos += hoist_pos;
+        }
+
+        if (pos_flags[ci.offset] & HOIST_DELETE) {
+            for (i = 0;i < ci.round_total;i++)
+                map[ci.offset + i] = write_pos;
+
+            continue;
+        }
+
+        for (i = 0;i < ci.round_total;i++)
+            map[ci.offset + i] = write_pos + i;
+
+        memcpy(out + write_pos, code + ci.offset,
+                ci.round_total * sizeof(uint16_t));
+        write_pos += ci.round_total;
+    }
+
+    map[size] = write_pos;
+
+    lily_ci_init(&ci, code, 0, size);
+    while (lily_ci_next(&ci)) {
+        if (pos_flags[ci.offset] & HOIST_DELETE)
+            continue;
+
+        int inside = (ci.offset >= loop_start && ci.offset < loop_stop);
+        int jump_pos = ci.offset + ci.round_total - ci.jumps_7;
+        int out_pos = map[ci.offset] + ci.round_total - ci.jumps_7;
+
+        for (i = 0;i < ci.jumps_7;i++) {
+            uint16_t target = code[jump_pos + i];
+
+            /* Except clauses use 0 to say that there's no clause after. */
+            if ((target == loop_start && inside == 0) ||
+                (target == 0 && (ci.opcode == o_except_catch ||
+                                 ci.opcode == o_except_ignore)))
+                out[out_pos + i] = target;
+            else
+                out[out_pos + i] = map[target];
+        }
+    }
+
+    for (i = 0;i < try_size;i++)
+        try_entries[i] = map[try_entries[i]];
+
+    lily_u16_set_pos(buffer, code_start);
+    lily_u16_write_prep(buffer, new_size);
+    memcpy(buffer->data + code_start, out, new_size * sizeof(uint16_t));
+    lily_u16_set_pos(buffer, code_start + new_size);
+
+    lily_free(out);
+    lily_free(pos_flags);
+
+    *size_ptr = new_size;
+    return 1;
+}
+
+/* This moves what it can out of each loop of the code in 'buffer', and returns
+   the new size of the code. Inner loops are done first, so that what's moved
+   out of them can be moved again. */
+static uint16_t hoist_invariants(lily_emit_state *emit,
+        lily_block *function_block, lily_buffer_u16 *buffer, int code_start,
+        uint16_t size)
+{
+    int loop_num = 0;
+
+    while (hoist_loop(emit, function_block, buffer, code_start, &size,
+            loop_num))
+        loop_num++;
+
+    return size;
+}
+
+/** Calls to small functions are replaced with the code of the function. Only
+    functions that are straight code are saved, and only if none of that code
+    can raise an error. That way, a traceback never has to say where inlined
+    code came from, and the line of the call is right for all of it.
+
+    The arguments are read from wherever the caller has them, so a function
+    that writes to an argument isn't saved. The other registers become storages
+    of the caller, which is why the type of each is saved. Functions with
+    optional arguments start with o_optarg_dispatch, so they're never saved. **/
+
+# define INLINE_CODE_LIMIT 32
+# define INLINE_REG_LIMIT  12
+
+static int is_inline_op(uint16_t op)
+{
+    switch (op) {
+        case o_assign:
+        case o_fast_assign:
+        case o_integer_add:
+        case o_integer_minus:
+        case o_integer_mul:
+        case o_left_shift:
+        case o_right_shift:
+        case o_bitwise_and:
+        case o_bitwise_or:
+        case o_bitwise_xor:
+        case o_double_add:
+        case o_double_minus:
+        case o_double_mul:
+        case o_less:
+        case o_less_eq:
+        case o_greater:
+        case o_greater_eq:
+        case o_integer_eq:
+        case o_integer_not_eq:
+        case o_integer_less:
+        case o_integer_less_eq:
+        case o_integer_greater:
+        case o_integer_greater_eq:
+        case o_double_eq:
+        case o_double_not_eq:
+        case o_double_less:
+        case o_double_less_eq:
+        case o_double_greater:
+        case o_double_greater_eq:
+        case o_string_eq:
+        case o_string_not_eq:
+        case o_string_less:
+        case o_string_less_eq:
+        case o_string_greater:
+        case o_string_greater_eq:
+        case o_unary_not:
+        case o_unary_minus:
+        case o_get_readonly:
+        case o_get_integer:
+        case o_get_boolean:
+        case o_get_property:
+        case o_set_property:
+        case o_return_val:
+        case o_return_noval:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+/* If the function that was just finished can be inlined, save the code and the
+   register types of it. */
+static void save_inline_body(lily_emit_state *emit, lily_block *function_block,
+        uint16_t *code, uint16_t size)
+{
+    lily_var *var = function_block->function_var;
+    int reg_count = function_block->next_reg_spot;
+    int arg_count = var->type->subtype_count - 1;
+
+    if (size > INLINE_CODE_LIMIT ||
+        reg_count > INLINE_REG_LIMIT ||
+        var->reg_spot > UINT16_MAX ||
+        function_block->make_closure ||
+        lily_u16_pos(emit->try_table) != function_block->try_start ||
+        emit->inline_types_pos + reg_count > UINT16_MAX)
+        return;
+
+    lily_type *types[INLINE_REG_LIMIT];
+    lily_storage *storage_iter;
+    lily_code_iter ci;
+    opt_operands ops;
+    int i, written = 0;
+
+    for (i = 0;i < reg_count;i++)
+        types[i] = NULL;
+
+    /* Packing has moved the storages to the registers they ended up in. */
+    for (storage_iter = function_block->storage_start;
+         storage_iter;
+         storage_iter = storage_iter->next) {
+        lily_type *type = storage_iter->type;
+
+        if (type == NULL || storage_iter->reg_spot >= (uint32_t)reg_count)
+            continue;
+
+        if (type->flags & (TYPE_IS_UNRESOLVED | TYPE_HAS_SCOOP))
+            return;
+
+        types[storage_iter->reg_spot] = type;
+    }
 
+    /* Every register that isn't an argument has to be a storage, and has to be
+       written before it's read. The only return is the last instruction. */
+    lily_ci_init(&ci, code, 0, size);
     while (lily_ci_next(&ci)) {
-        uint16_t *buffer = ci.buffer;
-        int i;
-        int pos = ci.offset + 1;
-        int output_start = 0;
-        lily_opcode op = buffer[ci.offset];
+        uint16_t op = ci.opcode;
 
-        pos += ci.line;
+        if (is_inline_op(op) == 0)
+            return;
 
-        if (ci.special_1) {
-            switch (op) {
-                case o_create_function:
-                    /* The first special of this opcode is the register of the
-                       closure, which was only recently made. Fix the buffer,
-                       and the write that happens later will do the rest. */
-                    buffer[pos] = s->reg_spot;
-                    pos++;
-                    break;
-                case o_function_call:
-                case o_match_dispatch:
-                case o_variant_decompose:
-                    MAYBE_TRANSFORM_INPUT(pos, o_get_upvalue)
-                default:
-                    pos += ci.special_1;
-                    break;
-            }
-        }
+        if ((op == o_return_val || op == o_return_noval) &&
+            ci.offset + ci.round_total != size)
+            return;
 
-        pos += ci.counter_2;
+        opt_get_operands(&ci, &ops);
 
-        if (ci.inputs_3) {
-            for (i = 0;i < ci.inputs_3;i++) {
-                MAYBE_TRANSFORM_INPUT(pos, o_get_upvalue)
-            }
+        for (i = ops.read_start;i < ops.read_stop;i++) {
+            uint16_t reg = code[i];
 
-            pos += ci.inputs_3;
+            if (reg >= arg_count && (written & (1 << reg)) == 0)
+                return;
         }
 
-        if (ci.special_4) {
-            switch (op) {
-                case o_create_function:
-                case o_load_class_closure:
-                case o_load_closure:
-                    pos += ci.special_4;
-                    break;
-                default:
-                    lily_raise(emit->raiser, lily_Error,
-                            "Special value #4 for opcode %d not handled.\n",
-                            op);
-            }
-        }
+        for (i = ops.write_start;i < ops.write_stop;i++) {
+            uint16_t reg = code[i];
 
-        if (ci.outputs_5) {
-            output_start = pos;
-            pos += ci.outputs_5;
-        }
+            if (reg < arg_count || types[reg] == NULL)
+                return;
 
-        if (ci.special_6) {
-            lily_opcode op = buffer[ci.offset];
-            switch (op) {
-                case o_native_call:
-                case o_foreign_call:
-                case o_function_call:
-                    for (i = 0;i < ci.special_6;i++) {
-                        MAYBE_TRANSFORM_INPUT(pos + i, o_get_upvalue)
-                    }
-                    pos += ci.special_6;
-                    break;
-                default:
-                    lily_raise(emit->raiser, lily_Error,
-                            "Special value #6 for opcode %d not handled.\n",
-                            op);
-            }
+            written |= 1 << reg;
         }
+    }
 
-        for (i = patch_start;i != lily_u16_pos(emit->patches);i += 2) {
-            int where = emit->patches->data[i + 1];
-            if (ci.offset == where) {
-                emit->closure_aux_code->data[emit->patches->data[i]] =
-                        lily_u16_pos(emit->closure_aux_code);
-            }
-        }
+    if (ci.opcode != o_return_val && ci.opcode != o_return_noval)
+        return;
 
-        int stop = ci.offset + ci.round_total - ci.jumps_7;
-        for (i = ci.offset;i < stop;i++)
-            lily_u16_write_1(emit->closure_aux_code, buffer[i]);
+    lily_u16_write_5(emit->inline_code, var->reg_spot, reg_count, arg_count,
+            emit->inline_types_pos, size);
 
-        if (ci.jumps_7) {
-            int i;
-            for (i = 0;i < ci.jumps_7;i++) {
-                /* Bug: This is broken for jumps that go backward. I'll fix that
-                   by making jumps relative, later on. */
-                lily_u16_write_1(emit->closure_aux_code, 0);
+    for (i = 0;i < size;i++)
+        lily_u16_write_1(emit->inline_code, code[i]);
 
-                /* Insert a pairing of the position just written, and the target
-                   of that position. The target is, for the time being, assumed
-                   to be forward. */
-                lily_u16_write_2(emit->patches,
-                        lily_u16_pos(emit->closure_aux_code) - 1,
-                        buffer[stop + i] + start);
-            }
-        }
+    if (emit->inline_types_pos + reg_count > emit->inline_types_size) {
+        while (emit->inline_types_pos + reg_count > emit->inline_types_size)
+            emit->inline_types_size *= 2;
 
-        if (ci.outputs_5) {
-            int stop = output_start + ci.outputs_5;
+        emit->inline_types = lily_realloc(emit->inline_types,
+                sizeof(lily_type *) * emit->inline_types_size);
+    }
 
-            for (i = output_start;i < stop;i++) {
-                MAYBE_TRANSFORM_INPUT(i, o_set_upvalue)
-            }
-        }
+    for (i = 0;i < reg_count;i++)
+        emit->inline_types[emit->inline_types_pos + i] = types[i];
+
+    emit->inline_types_pos += reg_count;
+    var->flags |= VAR_CAN_INLINE;
+}
+
+/* This writes the code of a function that was just finished to stderr. */
+static void show_code(lily_function_val *f, uint16_t code_size)
+{
+    lily_msgbuf *msgbuf = lily_new_msgbuf();
+
+    if (f->class_name)
+        lily_msgbuf_add_fmt(msgbuf, "%s.", f->class_name);
+
+    lily_msgbuf_add_fmt(msgbuf, "%s:\n", f->trace_name);
+    lily_dump_code(msgbuf, f->code, code_size);
+
+    uint32_t i;
+    for (i = 0;i < f->try_count;i++) {
+        uint16_t *entry = f->try_table + (i * 3);
+        lily_msgbuf_add_fmt(msgbuf, "      try @%d to @%d, except @%d\n",
+                entry[0], entry[1], entry[2]);
     }
+
+    fputs(msgbuf->message, stderr);
+    lily_free_msgbuf(msgbuf);
 }
 
 /* This makes the function value that will be needed by the current code
@@ -1508,25 +3107,54 @@ static lily_function_val *create_code_block_for(lily_emit_state *emit,
     lily_tie_function(emit->symtab, var, f);
 
     int code_start, code_size;
+    lily_buffer_u16 *buffer;
     uint16_t *source, *code;
 
     if (function_block->make_closure == 0) {
         code_start = emit->block->code_start;
-        code_size = lily_u16_pos(emit->code) - emit->block->code_start;
-        source = emit->code->data;
+        buffer = emit->code;
     }
     else {
         perform_closure_transform(emit, function_block, f);
 
         code_start = 0;
-        code_size = lily_u16_pos(emit->closure_aux_code);
-        source = emit->closure_aux_code->data;
+        buffer = emit->closure_aux_code;
     }
 
-    code = lily_malloc((code_size + 1) * sizeof(uint16_t));
+    code_size = lily_u16_pos(buffer) - code_start;
+    source = buffer->data;
+
+    if (emit->optimize) {
+        code_size = optimize_code(emit, function_block, source + code_start,
+                code_size);
+        code_size = hoist_invariants(emit, function_block, buffer, code_start,
+                code_size);
+        /* Moving code out of loops can make the buffer grow. */
+        source = buffer->data;
+        function_block->next_reg_spot = pack_registers(emit, function_block,
+                source + code_start, code_size);
+        save_inline_body(emit, function_block, source + code_start,
+                code_size);
+    }
+
+    /* The try table of the function goes after the code, so that they're
+       freed together. */
+    int try_start = function_block->try_start;
+    int try_size = lily_u16_pos(emit->try_table) - try_start;
+
+    code = lily_malloc((code_size + 1 + try_size) * sizeof(uint16_t));
     memcpy(code, source + code_start, sizeof(uint16_t) * code_size);
+    memcpy(code + code_size + 1, emit->try_table->data + try_start,
+            sizeof(uint16_t) * try_size);
 
     f->code = code;
+    f->try_table = code + code_size + 1;
+    f->try_count = try_size / 3;
+    lily_u16_set_pos(emit->try_table, try_start);
+
+    if (emit->show_code)
+        show_code(f, code_size);
+
     return f;
 }
 
@@ -2243,6 +3871,254 @@ static void eval_oo_assign(lily_emit_state *emit, lily_ast *ast)
 
 /** Here are most of the functions related to evaluating trees. **/
 
+/** When optimizing, binary and unary ops on literals are done here instead of
+    at vm-time. A tree that is folded becomes an integer, boolean, or literal
+    tree, and is then evaluated like any other of those. Anything that could
+    raise at vm-time (such as division by zero) is left for the vm. **/
+
+/* This finds the literal that is at 'spot'. */
+static lily_tie *find_literal(lily_emit_state *emit, uint16_t spot)
+{
+    lily_tie *lit = emit->symtab->literals;
+
+    while (lit) {
+        if (lit->reg_spot == spot)
+            break;
+
+        lit = lit->next;
+    }
+
+    return lit;
+}
+
+/* If 'ast' is a constant Integer, Double, String, or Boolean, the value is
+   written to 'out' and the class id is returned. Otherwise, -1 is returned. */
+static int constant_value(lily_emit_state *emit, lily_ast *ast,
+        lily_raw_value *out)
+{
+    while (ast->tree_type == tree_parenth)
+        ast = ast->arg_start;
+
+    if (ast->tree_type == tree_integer) {
+        out->integer = ast->backing_value;
+        return SYM_CLASS_INTEGER;
+    }
+    else if (ast->tree_type == tree_boolean) {
+        out->integer = ast->backing_value;
+        return SYM_CLASS_BOOLEAN;
+    }
+    else if (ast->tree_type == tree_literal) {
+        int id = ast->type->cls->id;
+
+        if (id != SYM_CLASS_INTEGER && id != SYM_CLASS_DOUBLE &&
+            id != SYM_CLASS_STRING)
+            return -1;
+
+        *out = find_literal(emit, ast->literal_reg_spot)->value;
+        return id;
+    }
+
+    return -1;
+}
+
+/* This turns 'ast' into a tree holding a constant of the given class. */
+static void set_constant(lily_emit_state *emit, lily_ast *ast, int class_id,
+        lily_raw_value value)
+{
+    lily_tie *lit;
+
+    ast->maybe_result_pos = 0;
+
+    if (class_id == SYM_CLASS_BOOLEAN) {
+        ast->tree_type = tree_boolean;
+        ast->backing_value = (int16_t)value.integer;
+        return;
+    }
+    else if (class_id == SYM_CLASS_INTEGER &&
+             value.integer <= INT16_MAX && value.integer >= INT16_MIN) {
+        ast->tree_type = tree_integer;
+        ast->backing_value = (int16_t)value.integer;
+        return;
+    }
+    else if (class_id == SYM_CLASS_INTEGER)
+        lit = lily_get_integer_literal(emit->symtab, value.integer);
+    else
+        lit = lily_get_double_literal(emit->symtab, value.doubleval);
+
+    ast->tree_type = tree_literal;
+    ast->literal_reg_spot = lit->reg_spot;
+    ast->type = lit->type;
+}
+
+/* This does what the vm would do for 'opcode', but on constants. If the op
+   would raise, or its result isn't well-defined, 0 is returned. */
+static int fold_binary_op(int opcode, lily_raw_value l, lily_raw_value r,
+        int lhs_id, int rhs_id, lily_raw_value *out, int *out_id)
+{
+    double ld, rd;
+
+    /* Integer math wraps around the same way on the vm. */
+    uint64_t ul = (uint64_t)l.integer, ur = (uint64_t)r.integer;
+    int64_t li = l.integer, ri = r.integer;
+
+    if (lhs_id == SYM_CLASS_DOUBLE)
+        ld = l.doubleval;
+    else
+        ld = (double)li;
+
+    if (rhs_id == SYM_CLASS_DOUBLE)
+        rd = r.doubleval;
+    else
+        rd = (double)ri;
+
+    *out_id = SYM_CLASS_INTEGER;
+
+    switch (opcode) {
+        case o_integer_add:   out->integer = (int64_t)(ul + ur); break;
+        case o_integer_minus: out->integer = (int64_t)(ul - ur); break;
+        case o_integer_mul:   out->integer = (int64_t)(ul * ur); break;
+        case o_integer_div:
+        case o_modulo:
+            if (ri == 0 || (li == INT64_MIN && ri == -1))
+                return 0;
+
+            if (opcode == o_integer_div)
+                out->integer = li / ri;
+            else
+                out->integer = li % ri;
+            break;
+        case o_left_shift:
+        case o_right_shift:
+            if (ri < 0 || ri >= 64)
+                return 0;
+
+            if (opcode == o_left_shift)
+                out->integer = (int64_t)(ul << ri);
+            else
+                out->integer = li >> ri;
+            break;
+        case o_bitwise_and: out->integer = li & ri; break;
+        case o_bitwise_or:  out->integer = li | ri; break;
+        case o_bitwise_xor: out->integer = li ^ ri; break;
+        case o_double_add:
+        case o_double_minus:
+        case o_double_mul:
+        case o_double_div:
+            *out_id = SYM_CLASS_DOUBLE;
+
+            if (opcode == o_double_add)
+                out->doubleval = ld + rd;
+            else if (opcode == o_double_minus)
+                out->doubleval = ld - rd;
+            else if (opcode == o_double_mul)
+                out->doubleval = ld * rd;
+            else if (rd == 0)
+                return 0;
+            else
+                out->doubleval = ld / rd;
+            break;
+        default:
+            *out_id = SYM_CLASS_BOOLEAN;
+
+            int cmp;
+            if (opcode >= o_string_eq && opcode <= o_string_greater_eq) {
+                cmp = strcmp(l.string->string, r.string->string);
+                opcode = opcode - o_string_eq + o_integer_eq;
+            }
+            else if (opcode >= o_integer_eq && opcode <= o_integer_greater_eq)
+                cmp = (li > ri) - (li < ri);
+            else if (opcode >= o_double_eq && opcode <= o_double_greater_eq) {
+                cmp = (ld > rd) - (ld < rd);
+                opcode = opcode - o_double_eq + o_integer_eq;
+            }
+            else if (opcode >= o_less && opcode <= o_greater_eq) {
+                cmp = (ld > rd) - (ld < rd);
+                opcode = opcode - o_less + o_integer_less;
+            }
+            else
+                /* o_is_equal and o_not_eq are left to the vm. */
+                return 0;
+
+            if (opcode == o_integer_eq)
+                out->integer = (cmp == 0);
+            else if (opcode == o_integer_not_eq)
+                out->integer = (cmp != 0);
+            else if (opcode == o_integer_less)
+                out->integer = (cmp < 0);
+            else if (opcode == o_integer_less_eq)
+                out->integer = (cmp <= 0);
+            else if (opcode == o_integer_greater)
+                out->integer = (cmp > 0);
+            else
+                out->integer = (cmp >= 0);
+            break;
+    }
+
+    return 1;
+}
+
+/* This attempts to fold 'ast' (and the trees within it) into a constant. If
+   that works, 'ast' becomes a constant tree and 1 is returned. */
+static int fold_tree(lily_emit_state *emit, lily_ast *ast)
+{
+    lily_raw_value l, r, result;
+    int lhs_id, rhs_id, result_id;
+
+    if (ast->tree_type == tree_parenth) {
+        lily_ast *inner = ast->arg_start;
+
+        if (fold_tree(emit, inner) == 0)
+            return 0;
+
+        /* The inner tree is a constant, so take it over. */
+        ast->tree_type = inner->tree_type;
+        ast->pile_pos = inner->pile_pos;
+        ast->type = inner->type;
+        ast->maybe_result_pos = 0;
+        return 1;
+    }
+    else if (ast->tree_type == tree_unary) {
+        fold_tree(emit, ast->left);
+        lhs_id = constant_value(emit, ast->left, &l);
+
+        if (lhs_id == SYM_CLASS_INTEGER && ast->op == expr_unary_minus)
+            result.integer = (int64_t)(0 - (uint64_t)l.integer);
+        else if ((lhs_id == SYM_CLASS_INTEGER ||
+                  lhs_id == SYM_CLASS_BOOLEAN) && ast->op == expr_unary_not)
+            result.integer = !l.integer;
+        else
+            return 0;
+
+        set_constant(emit, ast, lhs_id, result);
+        return 1;
+    }
+    else if (ast->tree_type != tree_binary || ast->op >= expr_unary_not)
+        return constant_value(emit, ast, &l) != -1;
+
+    /* Both sides are folded, so that a side that is constant is loaded as
+       one value even if the other side is not constant. */
+    fold_tree(emit, ast->left);
+    fold_tree(emit, ast->right);
+
+    lhs_id = constant_value(emit, ast->left, &l);
+    rhs_id = constant_value(emit, ast->right, &r);
+
+    if (lhs_id == -1 || rhs_id == -1 ||
+        lhs_id > SYM_CLASS_STRING || rhs_id > SYM_CLASS_STRING)
+        return 0;
+
+    int opcode = generic_binop_table[ast->op][lhs_id][rhs_id];
+
+    /* Invalid ops are left for emit_binary_op to complain about. */
+    if (opcode == -1 ||
+        fold_binary_op(opcode, l, r, lhs_id, rhs_id, &result,
+                &result_id) == 0)
+        return 0;
+
+    set_constant(emit, ast, result_id, result);
+    return 1;
+}
+
 /* This handles simple binary ops (no assign, &&/||, |>, or compounds. This
    assumes that both sides have already been evaluated. */
 static void emit_binary_op(lily_emit_state *emit, lily_ast *ast)
@@ -2396,13 +4272,17 @@ static void eval_assign(lily_emit_state *emit, lily_ast *ast)
     if (can_optimize && assign_optimize_check(ast)) {
         int pos;
         /* Most trees dump their result at the end, so that patching is easy.
-           Those that don't will write down where it should go. */
-        if (ast->right->maybe_result_pos == 0)
+           Those that don't will write down where it should go. A compound op
+           was written after the right side, so it's the one to patch. */
+        if (ast->right->maybe_result_pos == 0 || ast->op > expr_assign)
             pos = lily_u16_pos(emit->code) - 1;
         else
             pos = ast->right->maybe_result_pos;
 
         lily_u16_insert(emit->code, pos, left_sym->reg_spot);
+        /* The storage is no longer written to, so a chain has to use the left
+           side instead. */
+        right_sym = left_sym;
     }
     else {
         lily_u16_write_4(emit->code, opcode, ast->line_num, right_sym->reg_spot,
@@ -2495,12 +4375,71 @@ void eval_upvalue(lily_emit_state *emit, lily_ast *ast)
 
 static void emit_literal(lily_emit_state *, lily_ast *);
 
+/* Each part of an interpolation has been written, starting at 'start'. If each
+   part only loaded a constant, then the code is dropped and 'ast' becomes a
+   String literal of the result. */
+static int fold_interpolation(lily_emit_state *emit, lily_ast *ast, int start)
+{
+    uint16_t *code = emit->code->data;
+    int stop = lily_u16_pos(emit->code);
+    int i;
+
+    /* Constants are loaded by an instruction that's 4 long. */
+    if (stop - start != ast->args_collected * 4)
+        return 0;
+
+    for (i = start;i < stop;i += 4) {
+        int op = code[i];
+
+        if (op == o_get_readonly) {
+            int id = find_literal(emit, code[i + 2])->type->cls->id;
+            if (id != SYM_CLASS_INTEGER && id != SYM_CLASS_DOUBLE &&
+                id != SYM_CLASS_STRING)
+                return 0;
+        }
+        else if (op != o_get_integer && op != o_get_boolean)
+            return 0;
+    }
+
+    lily_msgbuf *msgbuf = lily_new_msgbuf();
+
+    /* This has to match how the vm turns these values into a String. */
+    for (i = start;i < stop;i += 4) {
+        if (code[i] == o_get_integer)
+            lily_msgbuf_add_int(msgbuf, (int16_t)code[i + 2]);
+        else if (code[i] == o_get_boolean)
+            lily_msgbuf_add_boolean(msgbuf, code[i + 2]);
+        else {
+            lily_tie *lit = find_literal(emit, code[i + 2]);
+            int id = lit->type->cls->id;
+
+            if (id == SYM_CLASS_INTEGER)
+                lily_msgbuf_add_int(msgbuf, lit->value.integer);
+            else if (id == SYM_CLASS_DOUBLE)
+                lily_msgbuf_add_double(msgbuf, lit->value.doubleval);
+            else
+                lily_msgbuf_add(msgbuf, lit->value.string->string);
+        }
+    }
+
+    lily_tie *result = lily_get_string_literal(emit->symtab, msgbuf->message);
+    lily_free_msgbuf(msgbuf);
+
+    lily_u16_set_pos(emit->code, start);
+    ast->tree_type = tree_literal;
+    ast->literal_reg_spot = result->reg_spot;
+    ast->type = result->type;
+    return 1;
+}
+
 /* This evaluates an interpolation block `$"..."`. The children of this tree are
    divided into either tree_literal or tree_interp_block. The former does not
    need to be evaluated. The latter */
 static void eval_interpolation(lily_emit_state *emit, lily_ast *ast)
 {
     lily_ast *tree_iter = ast->arg_start;
+    int start = lily_u16_pos(emit->code);
+
     while (tree_iter) {
         if (tree_iter->tree_type == tree_interp_block) {
             char *interp_body = lily_sp_get(emit->expr_strings,
@@ -2521,6 +4460,11 @@ static void eval_interpolation(lily_emit_state *emit, lily_ast *ast)
         tree_iter = tree_iter->next_arg;
     }
 
+    if (emit->optimize && fold_interpolation(emit, ast, start)) {
+        emit_literal(emit, ast);
+        return;
+    }
+
     lily_u16_write_3(emit->code, o_interpolation, ast->line_num,
             ast->args_collected);
     lily_u16_write_prep(emit->code, ast->args_collected + 1);
@@ -2560,7 +4504,7 @@ static void eval_lambda(lily_emit_state *emit, lily_ast *ast,
         lily_u16_write_4(emit->code, o_get_readonly, ast->line_num,
                 lambda_result->reg_spot, s->reg_spot);
     else
-        emit_create_function(emit, lambda_result, s);
+        emit_create_function(emit, o_create_function, lambda_result, s);
 
     ast->result = (lily_sym *)s;
 }
@@ -2656,6 +4600,20 @@ static void eval_logical_op(lily_emit_state *emit, lily_ast *ast)
         ast->result = NULL;
 }
 
+/* Lists of these types are packed, so subscripts on them can use the packed
+   item opcodes. */
+static int is_packed_list_type(lily_type *type)
+{
+    if (type->cls->id != SYM_CLASS_LIST)
+        return 0;
+
+    int elem_id = type->subtypes[0]->cls->id;
+
+    return elem_id == SYM_CLASS_INTEGER ||
+           elem_id == SYM_CLASS_DOUBLE ||
+           elem_id == SYM_CLASS_BOOLEAN;
+}
+
 /* This runs a subscript, including validation of the indexes. */
 static void eval_subscript(lily_emit_state *emit, lily_ast *ast,
         lily_type *expect)
@@ -2674,8 +4632,12 @@ static void eval_subscript(lily_emit_state *emit, lily_ast *ast,
     type_for_result = get_subscript_result(var_ast->result->type, index_ast);
 
     lily_storage *result = get_storage(emit, type_for_result);
+    uint16_t op = o_get_item;
+
+    if (is_packed_list_type(var_ast->result->type))
+        op = o_get_packed_item;
 
-    lily_u16_write_5(emit->code, o_get_item, ast->line_num,
+    lily_u16_write_5(emit->code, op, ast->line_num,
             var_ast->result->reg_spot, index_ast->result->reg_spot,
             result->reg_spot);
 
@@ -2736,13 +4698,21 @@ static void eval_sub_assign(lily_emit_state *emit, lily_ast *ast)
 
     rhs = ast->right->result;
 
+    uint16_t get_op = o_get_item;
+    uint16_t set_op = o_set_item;
+
+    if (is_packed_list_type(var_ast->result->type)) {
+        get_op = o_get_packed_item;
+        set_op = o_set_packed_item;
+    }
+
     if (ast->op > expr_assign) {
         /* For a compound assignment to work, the left side must be subscripted
            to get the value held. */
 
         lily_storage *subs_storage = get_storage(emit, elem_type);
 
-        lily_u16_write_5(emit->code, o_get_item, ast->line_num,
+        lily_u16_write_5(emit->code, get_op, ast->line_num,
                 var_ast->result->reg_spot, index_ast->result->reg_spot,
                 subs_storage->reg_spot);
 
@@ -2753,7 +4723,7 @@ static void eval_sub_assign(lily_emit_state *emit, lily_ast *ast)
         rhs = ast->result;
     }
 
-    lily_u16_write_5(emit->code, o_set_item, ast->line_num,
+    lily_u16_write_5(emit->code, set_op, ast->line_num,
             var_ast->result->reg_spot, index_ast->result->reg_spot,
             rhs->reg_spot);
 
@@ -2915,7 +4885,7 @@ static void emit_nonlocal_var(lily_emit_state *emit, lily_ast *ast)
         lily_u16_write_4(emit->code, opcode, ast->line_num, ast->sym->reg_spot,
                 ret->reg_spot);
     else
-        emit_create_function(emit, ast->sym, ret);
+        emit_create_function(emit, o_create_function, ast->sym, ret);
 
     ast->result = (lily_sym *)ret;
 }
@@ -3283,9 +5253,21 @@ static void eval_call_arg(lily_emit_state *emit, lily_emit_call_state *cs,
                 emit->ts->question_class_type);
     }
 
+    uint16_t arg_start = lily_u16_pos(emit->code);
+
     eval_tree(emit, arg, eval_type);
     lily_type *result_type = arg->result->type;
 
+    /* A lambda given straight to a foreign function can only escape if that
+       function keeps it. Builtins that take a Function only call it, so the
+       copy made for a closure can be left to refcounting. */
+    if (arg->tree_type == tree_lambda &&
+        emit->code->data[arg_start] == o_create_function &&
+        want_type->cls->id == SYM_CLASS_FUNCTION &&
+        cs->item->item_kind == ITEM_TYPE_VAR &&
+        cs->sym->flags & VAR_IS_FOREIGN_FUNC)
+        lily_u16_insert(emit->code, arg_start, o_create_local_function);
+
     /* Here's an interesting case where the result type doesn't match but where
        the result is some global generic function. Since the result function is
        global, the generics inside of it are unquantified. For this special
@@ -3523,8 +5505,10 @@ static lily_emit_call_state *begin_call(lily_emit_state *emit,
         first_tt == tree_method) {
         call_item = ast->arg_start->item;
         if (call_item->flags & VAR_NEEDS_CLOSURE) {
+            /* The copy is only used to make the call, so it can't escape. */
             lily_storage *s = get_storage(emit, ast->arg_start->sym->type);
-            emit_create_function(emit, ast->arg_start->sym, s);
+            emit_create_function(emit, o_create_local_function,
+                    ast->arg_start->sym, s);
             call_item = (lily_item *)s;
         }
     }
@@ -3579,6 +5563,117 @@ static lily_emit_call_state *begin_call(lily_emit_state *emit,
     return result;
 }
 
+/* This writes the saved code of the function 'cs' calls instead of a call to
+   it. This returns 0 if a call has to be written instead. */
+static int write_inline_call(lily_emit_state *emit, lily_emit_call_state *cs)
+{
+    lily_sym *call_sym = cs->sym;
+    lily_ast *ast = cs->ast;
+    lily_type *return_type = cs->call_type->subtypes[0];
+    uint16_t *iter = emit->inline_code->data;
+    uint16_t *stop = iter + lily_u16_pos(emit->inline_code);
+    uint16_t *entry = NULL;
+
+    /* A later entry for the same spot replaces an earlier one. */
+    while (iter != stop) {
+        if (iter[0] == call_sym->reg_spot)
+            entry = iter;
+
+        iter += 5 + iter[4];
+    }
+
+    if (entry == NULL ||
+        entry[2] != cs->arg_count ||
+        (return_type == NULL && ast->parent != NULL))
+        return 0;
+
+    int reg_count = entry[1], arg_count = entry[2], size = entry[4];
+    lily_type **types = emit->inline_types + entry[3];
+    uint16_t *code = entry + 5;
+    lily_sym **args = emit->call_values + emit->call_values_pos - arg_count;
+    lily_storage *result = NULL;
+    uint16_t map[INLINE_REG_LIMIT];
+    uint16_t return_reg = UINT16_MAX, result_pos = 0;
+    lily_code_iter ci, last, before_last;
+    opt_operands ops;
+    int i;
+
+    before_last.round_total = 0;
+    last.round_total = 0;
+
+    lily_ci_init(&ci, code, 0, size);
+    while (lily_ci_next(&ci)) {
+        before_last = last;
+        last = ci;
+    }
+
+    if (last.opcode == o_return_val) {
+        if (return_type->flags & (TYPE_IS_UNRESOLVED | TYPE_HAS_SCOOP))
+            return_type = lily_ts_resolve(emit->ts, return_type);
+
+        result = get_storage(emit, return_type);
+        result->flags |= SYM_NOT_ASSIGNABLE;
+        return_reg = code[size - 1];
+    }
+
+    /* The returned register can be the result, if the last instruction before
+       the return writes to it. Otherwise, the result is assigned at the end. */
+    int result_direct = 0;
+
+    if (result && return_reg >= arg_count && before_last.round_total) {
+        opt_get_operands(&before_last, &ops);
+        result_direct = opt_range_has(code, ops.write_start, ops.write_stop,
+                return_reg);
+    }
+
+    for (i = 0;i < reg_count;i++) {
+        if (i < arg_count)
+            map[i] = args[i]->reg_spot;
+        else if (i == return_reg && result_direct)
+            map[i] = result->reg_spot;
+        else if (types[i])
+            map[i] = get_storage(emit, types[i])->reg_spot;
+        else
+            map[i] = 0;
+    }
+
+    lily_ci_init(&ci, code, 0, size);
+    while (lily_ci_next(&ci)) {
+        if (ci.opcode == o_return_val || ci.opcode == o_return_noval)
+            break;
+
+        int base = lily_u16_pos(emit->code) - ci.offset;
+
+        for (i = 0;i < ci.round_total;i++)
+            lily_u16_write_1(emit->code, code[ci.offset + i]);
+
+        uint16_t *out = emit->code->data + base;
+
+        out[ci.offset + 1] = ast->line_num;
+        opt_get_operands(&ci, &ops);
+
+        for (i = ops.read_start;i < ops.read_stop;i++)
+            out[i] = map[code[i]];
+
+        for (i = ops.write_start;i < ops.write_stop;i++) {
+            out[i] = map[code[i]];
+
+            if (code[i] == return_reg)
+                result_pos = base + i;
+        }
+    }
+
+    if (result && result_direct == 0) {
+        lily_u16_write_4(emit->code, o_assign, ast->line_num, map[return_reg],
+                result->reg_spot);
+        result_pos = lily_u16_pos(emit->code) - 1;
+    }
+
+    ast->result = (lily_sym *)result;
+    ast->maybe_result_pos = result_pos;
+    return 1;
+}
+
 /* The call's subtrees have been evaluated now. Write the instruction to do the
    call and make a storage to put the result in (if needed). */
 static void write_call(lily_emit_state *emit, lily_emit_call_state *cs)
@@ -3586,6 +5681,11 @@ static void write_call(lily_emit_state *emit, lily_emit_call_state *cs)
     lily_sym *call_sym = cs->sym;
     lily_ast *ast = cs->ast;
 
+    if ((call_sym->flags & (VAR_IS_READONLY | VAR_CAN_INLINE)) ==
+        (VAR_IS_READONLY | VAR_CAN_INLINE) &&
+        write_inline_call(emit, cs))
+        return;
+
     if (call_sym->flags & VAR_IS_READONLY) {
         uint16_t opcode;
         if (call_sym->flags & VAR_IS_FOREIGN_FUNC)
@@ -3786,6 +5886,10 @@ static void eval_func_pipe(lily_emit_state *emit, lily_ast *ast,
    what 'ast' should be), 'expect' can be NULL. */
 static void eval_tree(lily_emit_state *emit, lily_ast *ast, lily_type *expect)
 {
+    if (emit->optimize &&
+        (ast->tree_type == tree_binary || ast->tree_type == tree_unary))
+        fold_tree(emit, ast);
+
     if (ast->tree_type == tree_global_var ||
         ast->tree_type == tree_defined_func ||
         ast->tree_type == tree_static_func ||
@@ -3929,6 +6033,9 @@ void lily_emit_eval_condition(lily_emit_state *emit, lily_expr_state *es)
     lily_ast *ast = es->root;
     lily_block_type current_type = emit->block->block_type;
 
+    if (emit->optimize)
+        fold_tree(emit, ast);
+
     if (((ast->tree_type == tree_boolean ||
           ast->tree_type == tree_integer) &&
           ast->backing_value != 0) == 0) {
@@ -3939,7 +6046,16 @@ void lily_emit_eval_condition(lily_emit_state *emit, lily_expr_state *es)
         /* For a do...while block, on success the target jumps back up and thus
            stays within the loop. Everything else checks for failure, and will
            jump to the next branch on failure. */
-        emit_jump_if(emit, ast, current_type == block_do_while);
+        if (current_type != block_do_while)
+            emit_jump_if(emit, ast, 0);
+        else {
+            /* Patches go to the end of the block, but this jump has to go
+               back to the top. Drop the patch and target the top directly. */
+            emit_jump_if(emit, ast, 1);
+            emit->patches->pos--;
+            lily_u16_insert(emit->code, lily_u16_pos(emit->code) - 1,
+                    emit->block->loop_start - emit->block->jump_offset);
+        }
     }
     else {
         if (current_type != block_do_while) {
@@ -3949,7 +6065,8 @@ void lily_emit_eval_condition(lily_emit_state *emit, lily_expr_state *es)
             lily_u16_write_1(emit->patches, (uint16_t)-1);
         }
         else
-            lily_u16_write_2(emit->code, o_jump, emit->block->loop_start);
+            lily_u16_write_2(emit->code, o_jump,
+                    emit->block->loop_start - emit->block->jump_offset);
     }
 }
 
@@ -4003,13 +6120,11 @@ void lily_emit_eval_return(lily_emit_state *emit, lily_expr_state *es)
                     ast->result->type);
         }
 
-        write_pop_try_blocks_up_to(emit, emit->function_block);
         lily_u16_write_3(emit->code, o_return_val, ast->line_num,
                 ast->result->reg_spot);
         emit->block->last_exit = lily_u16_pos(emit->code);
     }
     else {
-        write_pop_try_blocks_up_to(emit, emit->function_block);
         lily_u16_write_2(emit->code, o_return_noval, *emit->lex_linenum);
     }
 }
@@ -4059,6 +6174,7 @@ void lily_emit_raise(lily_emit_state *emit, lily_expr_state *es)
 void lily_reset_main(lily_emit_state *emit)
 {
     emit->code->pos = 0;
+    emit->try_table->pos = 0;
 }
 
 
@@ -4082,5 +6198,7 @@ void lily_prepare_main(lily_emit_state *emit)
     lily_u16_write_1(emit->code, o_return_from_vm);
 
     f->code = emit->code->data;
+    f->try_table = emit->try_table->data;
+    f->try_count = lily_u16_pos(emit->try_table) / 3;
     f->reg_count = register_count;
 }
@@ -43,7 +43,10 @@ typedef struct lily_block_ {
     /* An index where the patches for this block start off. */
     uint16_t patch_start;
 
-    uint16_t pad;
+    /* Try blocks: Where the code of the try starts, relative to the function.
+       Functions: Where the entries of this function start in emitter's
+       try_table. */
+    uint16_t try_start;
 
     /* Match blocks: The starting position in emitter's match_cases. */
     uint16_t match_case_start;
@@ -170,6 +173,24 @@ typedef struct {
     /* This is a buffer used when transforming code to build a closure. */
     lily_buffer_u16 *closure_aux_code;
 
+    /* The peephole pass uses this to hold flags for each position of the
+       code, which then become where each position has moved to. */
+    lily_buffer_u16 *optimize_map;
+
+    /* When a try block is done, the positions of it are written here. When a
+       function is done, the entries it wrote are moved into the function
+       value. The vm uses these to find where an exception is caught. */
+    lily_buffer_u16 *try_table;
+
+    /* Functions small enough to be written into their callers are saved here.
+       Each entry is the readonly spot of the function, how many registers and
+       arguments it has, where its register types start, the size of the code,
+       and then the code. */
+    lily_buffer_u16 *inline_code;
+
+    /* The type of each register of the functions saved in inline_code. */
+    lily_type **inline_types;
+
     lily_sym **closed_syms;
 
     uint16_t *transform_table;
@@ -184,7 +205,9 @@ typedef struct {
 
     uint16_t closed_size;
 
-    uint32_t pad;
+    uint16_t inline_types_pos;
+
+    uint16_t inline_types_size;
 
     uint16_t match_case_pos;
 
@@ -217,7 +240,9 @@ typedef struct {
        implicitly entered before any user code. */
     lily_block *block;
 
-    uint16_t pad2;
+    /* These are copied from the options that the interpreter was made with. */
+    uint8_t optimize;
+    uint8_t show_code;
 
     /* How deep the current functions are. */
     uint16_t function_depth;
@@ -274,7 +299,7 @@ void lily_emit_enter_simple_block(lily_emit_state *, int);
 void lily_emit_enter_block(lily_emit_state *, lily_block_type);
 void lily_emit_leave_block(lily_emit_state *);
 
-void lily_emit_try(lily_emit_state *, int);
+void lily_emit_try(lily_emit_state *);
 void lily_emit_except(lily_emit_state *, lily_type *, lily_var *, int);
 void lily_emit_raise(lily_emit_state *, lily_expr_state *);
 
@@ -296,5 +321,6 @@ lily_var *lily_emit_new_dyna_var(lily_emit_state *, lily_module_entry *,
 
 void lily_free_emit_state(lily_emit_state *);
 void lily_emit_enter_main(lily_emit_state *);
-lily_emit_state *lily_new_emit_state(lily_symtab *, lily_raiser *);
+lily_emit_state *lily_new_emit_state(struct lily_options_ *, lily_symtab *,
+        lily_raiser *);
 #endif
@@ -0,0 +1,539 @@
+#include "lily_list_kernels.h"
+
+#if defined(LILY_SIMD_KERNELS) && defined(__x86_64__) && defined(__GNUC__)
+# define KERNELS_X86
+# include <immintrin.h>
+#endif
+
+/** Packed Lists hold their elements as a flat run of raw values, so bulk
+    operations over them don't need to look at flags or refcounts. Each kernel
+    here has a plain C version that works everywhere. On x86-64, there are also
+    versions using SSE2 (which every x86-64 cpu has) and AVX2 (which is checked
+    for at runtime). Kernels that SSE2 can't help with use the C version in the
+    SSE2 table.
+    The vector versions do as many full blocks as they can, then send whatever
+    is left to the C version. **/
+
+typedef struct {
+    int64_t (*sum_int)(const lily_raw_value *, uint32_t);
+    int64_t (*min_int)(const lily_raw_value *, uint32_t);
+    int64_t (*max_int)(const lily_raw_value *, uint32_t);
+    int64_t (*find_int)(const lily_raw_value *, uint32_t, int64_t);
+    int64_t (*find_double)(const lily_raw_value *, uint32_t, double);
+    int (*eq_int)(const lily_raw_value *, const lily_raw_value *, uint32_t);
+    int (*eq_double)(const lily_raw_value *, const lily_raw_value *,
+            uint32_t);
+    void (*fill)(lily_raw_value *, uint32_t, lily_raw_value);
+} lily_kernel_table;
+
+/***
+ *       ____
+ *      / ___|
+ *     | |
+ *     | |___
+ *      \____|
+ *
+ */
+
+static int64_t sum_int_c(const lily_raw_value *raw, uint32_t count)
+{
+    /* Unsigned, so that overflow wraps instead of being undefined. */
+    uint64_t total = 0;
+    uint32_t i;
+
+    for (i = 0;i < count;i++)
+        total += (uint64_t)raw[i].integer;
+
+    return (int64_t)total;
+}
+
+static int64_t min_int_c(const lily_raw_value *raw, uint32_t count)
+{
+    int64_t result = raw[0].integer;
+    uint32_t i;
+
+    for (i = 1;i < count;i++) {
+        if (raw[i].integer < result)
+            result = raw[i].integer;
+    }
+
+    return result;
+}
+
+static int64_t max_int_c(const lily_raw_value *raw, uint32_t count)
+{
+    int64_t result = raw[0].integer;
+    uint32_t i;
+
+    for (i = 1;i < count;i++) {
+        if (raw[i].integer > result)
+            result = raw[i].integer;
+    }
+
+    return result;
+}
+
+static int64_t find_int_c(const lily_raw_value *raw, uint32_t count,
+        int64_t needle)
+{
+    uint32_t i;
+
+    for (i = 0;i < count;i++) {
+        if (raw[i].integer == needle)
+            return i;
+    }
+
+    return -1;
+}
+
+static int64_t find_double_c(const lily_raw_value *raw, uint32_t count,
+        double needle)
+{
+    uint32_t i;
+
+    for (i = 0;i < count;i++) {
+        if (raw[i].doubleval == needle)
+            return i;
+    }
+
+    return -1;
+}
+
+static int eq_int_c(const lily_raw_value *left, const lily_raw_value *right,
+        uint32_t count)
+{
+    uint32_t i;
+
+    for (i = 0;i < count;i++) {
+        if (left[i].integer != right[i].integer)
+            return 0;
+    }
+
+    return 1;
+}
+
+static int eq_double_c(const lily_raw_value *left, const lily_raw_value *right,
+        uint32_t count)
+{
+    uint32_t i;
+
+    for (i = 0;i < count;i++) {
+        if (left[i].doubleval != right[i].doubleval)
+            return 0;
+    }
+
+    return 1;
+}
+
+static void fill_c(lily_raw_value *raw, uint32_t count, lily_raw_value source)
+{
+    uint32_t i;
+
+    for (i = 0;i < count;i++)
+        raw[i] = source;
+}
+
+static const lily_kernel_table c_kernels =
+{
+    sum_int_c,
+    min_int_c,
+    max_int_c,
+    find_int_c,
+    find_double_c,
+    eq_int_c,
+    eq_double_c,
+    fill_c,
+};
+
+#ifdef KERNELS_X86
+
+/***
+ *      ____  ____  _____ ____
+ *     / ___|/ ___|| ____|___ \
+ *     \___ \\___ \|  _|   __) |
+ *      ___) |___) | |___ / __/
+ *     |____/|____/|_____|_____|
+ *
+ */
+
+static int64_t sum_int_sse2(const lily_raw_value *raw, uint32_t count)
+{
+    __m128i total = _mm_setzero_si128();
+    uint32_t i;
+
+    for (i = 0;i + 2 <= count;i += 2)
+        total = _mm_add_epi64(total,
+                _mm_loadu_si128((const __m128i *)(raw + i)));
+
+    total = _mm_add_epi64(total, _mm_unpackhi_epi64(total, total));
+
+    return (int64_t)((uint64_t)_mm_cvtsi128_si64(total) +
+            (uint64_t)sum_int_c(raw + i, count - i));
+}
+
+/* SSE2 can only compare 32 bits at a time. Two 64-bit values are equal when
+   both of their halves are, so each half is and-ed with its neighbor. */
+static int64_t find_int_sse2(const lily_raw_value *raw, uint32_t count,
+        int64_t needle)
+{
+    __m128i key = _mm_set1_epi64x(needle);
+    uint32_t i;
+
+    for (i = 0;i + 2 <= count;i += 2) {
+        __m128i halves = _mm_cmpeq_epi32(key,
+                _mm_loadu_si128((const __m128i *)(raw + i)));
+        __m128i full = _mm_and_si128(halves,
+                _mm_shuffle_epi32(halves, _MM_SHUFFLE(2, 3, 0, 1)));
+        int mask = _mm_movemask_pd(_mm_castsi128_pd(full));
+
+        if (mask)
+            return i + __builtin_ctz(mask);
+    }
+
+    int64_t rest = find_int_c(raw + i, count - i, needle);
+    return rest == -1 ? -1 : i + rest;
+}
+
+static int64_t find_double_sse2(const lily_raw_value *raw, uint32_t count,
+        double needle)
+{
+    __m128d key = _mm_set1_pd(needle);
+    uint32_t i;
+
+    for (i = 0;i + 2 <= count;i += 2) {
+        __m128d block = _mm_loadu_pd((const double *)(raw + i));
+        int mask = _mm_movemask_pd(_mm_cmpeq_pd(key, block));
+
+        if (mask)
+            return i + __builtin_ctz(mask);
+    }
+
+    int64_t rest = find_double_c(raw + i, count - i, needle);
+    return rest == -1 ? -1 : i + rest;
+}
+
+/* Integers are the same if all of their bytes are. */
+static int eq_int_sse2(const lily_raw_value *left,
+        const lily_raw_value *right, uint32_t count)
+{
+    uint32_t i;
+
+    for (i = 0;i + 2 <= count;i += 2) {
+        __m128i l = _mm_loadu_si128((const __m128i *)(left + i));
+        __m128i r = _mm_loadu_si128((const __m128i *)(right + i));
+
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(l, r)) != 0xFFFF)
+            return 0;
+    }
+
+    return eq_int_c(left + i, right + i, count - i);
+}
+
+static int eq_double_sse2(const lily_raw_value *left,
+        const lily_raw_value *right, uint32_t count)
+{
+    uint32_t i;
+
+    for (i = 0;i + 2 <= count;i += 2) {
+        __m128d l = _mm_loadu_pd((const double *)(left + i));
+        __m128d r = _mm_loadu_pd((const double *)(right + i));
+
+        if (_mm_movemask_pd(_mm_cmpeq_pd(l, r)) != 0x3)
+            return 0;
+    }
+
+    return eq_double_c(left + i, right + i, count - i);
+}
+
+static void fill_sse2(lily_raw_value *raw, uint32_t count,
+        lily_raw_value source)
+{
+    __m128i block = _mm_set1_epi64x(source.integer);
+    uint32_t i;
+
+    for (i = 0;i + 2 <= count;i += 2)
+        _mm_storeu_si128((__m128i *)(raw + i), block);
+
+    fill_c(raw + i, count - i, source);
+}
+
+static const lily_kernel_table sse2_kernels =
+{
+    sum_int_sse2,
+    min_int_c,
+    max_int_c,
+    find_int_sse2,
+    find_double_sse2,
+    eq_int_sse2,
+    eq_double_sse2,
+    fill_sse2,
+};
+
+/***
+ *         ___     ____  ______
+ *        / \ \   / /\ \/ /___ \
+ *       / _ \ \ / /  \  /  __) |
+ *      / ___ \ V /   /  \ / __/
+ *     /_/   \_\_/   /_/\_\_____|
+ *
+ */
+
+#define AVX2 __attribute__((target("avx2")))
+
+AVX2 static int64_t sum_int_avx2(const lily_raw_value *raw, uint32_t count)
+{
+    __m256i total = _mm256_setzero_si256();
+    uint32_t i;
+
+    for (i = 0;i + 4 <= count;i += 4)
+        total = _mm256_add_epi64(total,
+                _mm256_loadu_si256((const __m256i *)(raw + i)));
+
+    __m128i half = _mm_add_epi64(_mm256_castsi256_si128(total),
+            _mm256_extracti128_si256(total, 1));
+    half = _mm_add_epi64(half, _mm_unpackhi_epi64(half, half));
+
+    return (int64_t)((uint64_t)_mm_cvtsi128_si64(half) +
+            (uint64_t)sum_int_c(raw + i, count - i));
+}
+
+/* min and max keep four running results, then fold those with the leftover
+   elements at the end. */
+AVX2 static int64_t min_int_avx2(const lily_raw_value *raw, uint32_t count)
+{
+    if (count < 4)
+        return min_int_c(raw, count);
+
+    __m256i best = _mm256_loadu_si256((const __m256i *)raw);
+    int64_t lanes[4];
+    uint32_t i;
+
+    for (i = 4;i + 4 <= count;i += 4) {
+        __m256i block = _mm256_loadu_si256((const __m256i *)(raw + i));
+        __m256i lower = _mm256_cmpgt_epi64(best, block);
+        best = _mm256_blendv_epi8(best, block, lower);
+    }
+
+    _mm256_storeu_si256((__m256i *)lanes, best);
+
+    int64_t result = lanes[0];
+    int j;
+
+    for (j = 1;j < 4;j++) {
+        if (lanes[j] < result)
+            result = lanes[j];
+    }
+
+    for (;i < count;i++) {
+        if (raw[i].integer < result)
+            result = raw[i].integer;
+    }
+
+    return result;
+}
+
+AVX2 static int64_t max_int_avx2(const lily_raw_value *raw, uint32_t count)
+{
+    if (count < 4)
+        return max_int_c(raw, count);
+
+    __m256i best = _mm256_loadu_si256((const __m256i *)raw);
+    int64_t lanes[4];
+    uint32_t i;
+
+    for (i = 4;i + 4 <= count;i += 4) {
+        __m256i block = _mm256_loadu_si256((const __m256i *)(raw + i));
+        __m256i higher = _mm256_cmpgt_epi64(block, best);
+        best = _mm256_blendv_epi8(best, block, higher);
+    }
+
+    _mm256_storeu_si256((__m256i *)lanes, best);
+
+    int64_t result = lanes[0];
+    int j;
+
+    for (j = 1;j < 4;j++) {
+        if (lanes[j] > result)
+            result = lanes[j];
+    }
+
+    for (;i < count;i++) {
+        if (raw[i].integer > result)
+            result = raw[i].integer;
+    }
+
+    return result;
+}
+
+AVX2 static int64_t find_int_avx2(const lily_raw_value *raw, uint32_t count,
+        int64_t needle)
+{
+    __m256i key = _mm256_set1_epi64x(needle);
+    uint32_t i;
+
+    for (i = 0;i + 4 <= count;i += 4) {
+        __m256i block = _mm256_loadu_si256((const __m256i *)(raw + i));
+        int mask = _mm256_movemask_pd(
+                _mm256_castsi256_pd(_mm256_cmpeq_epi64(key, block)));
+
+        if (mask)
+            return i + __builtin_ctz(mask);
+    }
+
+    int64_t rest = find_int_c(raw + i, count - i, needle);
+    return rest == -1 ? -1 : i + rest;
+}
+
+AVX2 static int64_t find_double_avx2(const lily_raw_value *raw,
+        uint32_t count, double needle)
+{
+    __m256d key = _mm256_set1_pd(needle);
+    uint32_t i;
+
+    for (i = 0;i + 4 <= count;i += 4) {
+        __m256d block = _mm256_loadu_pd((const double *)(raw + i));
+        int mask = _mm256_movemask_pd(_mm256_cmp_pd(key, block, _CMP_EQ_OQ));
+
+        if (mask)
+            return i + __builtin_ctz(mask);
+    }
+
+    int64_t rest = find_double_c(raw + i, count - i, needle);
+    return rest == -1 ? -1 : i + rest;
+}
+
+AVX2 static int eq_int_avx2(const lily_raw_value *left,
+        const lily_raw_value *right, uint32_t count)
+{
+    uint32_t i;
+
+    for (i = 0;i + 4 <= count;i += 4) {
+        __m256i l = _mm256_loadu_si256((const __m256i *)(left + i));
+        __m256i r = _mm256_loadu_si256((const __m256i *)(right + i));
+
+        if ((uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(l, r)) !=
+            0xFFFFFFFF)
+            return 0;
+    }
+
+    return eq_int_c(left + i, right + i, count - i);
+}
+
+AVX2 static int eq_double_avx2(const lily_raw_value *left,
+        const lily_raw_value *right, uint32_t count)
+{
+    uint32_t i;
+
+    for (i = 0;i + 4 <= count;i += 4) {
+        __m256d l = _mm256_loadu_pd((const double *)(left + i));
+        __m256d r = _mm256_loadu_pd((const double *)(right + i));
+
+        if (_mm256_movemask_pd(_mm256_cmp_pd(l, r, _CMP_EQ_OQ)) != 0xF)
+            return 0;
+    }
+
+    return eq_double_c(left + i, right + i, count - i);
+}
+
+AVX2 static void fill_avx2(lily_raw_value *raw, uint32_t count,
+        lily_raw_value source)
+{
+    __m256i block = _mm256_set1_epi64x(source.integer);
+    uint32_t i;
+
+    for (i = 0;i + 4 <= count;i += 4)
+        _mm256_storeu_si256((__m256i *)(raw + i), block);
+
+    fill_c(raw + i, count - i, source);
+}
+
+static const lily_kernel_table avx2_kernels =
+{
+    sum_int_avx2,
+    min_int_avx2,
+    max_int_avx2,
+    find_int_avx2,
+    find_double_avx2,
+    eq_int_avx2,
+    eq_double_avx2,
+    fill_avx2,
+};
+
+#endif
+
+/***
+ *      ____  _                 _       _
+ *     |  _ \(_)___ _ __   __ _| |_ ___| |__
+ *     | | | | / __| '_ \ / _` | __/ __| '_ \
+ *     | |_| | \__ \ |_) | (_| | || (__| | | |
+ *     |____/|_|___/ .__/ \__,_|\__\___|_| |_|
+ *                 |_|
+ */
+
+/* Every interpreter in the process shares this. Picking the table more than
+   once (two threads racing to do it) is harmless, since both get the same
+   answer. */
+static const lily_kernel_table *kernels = NULL;
+
+static const lily_kernel_table *pick_kernels(void)
+{
+    kernels = &c_kernels;
+
+#ifdef KERNELS_X86
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx2"))
+        kernels = &avx2_kernels;
+    else
+        kernels = &sse2_kernels;
+#endif
+
+    return kernels;
+}
+
+#define KERNELS (kernels ? kernels : pick_kernels())
+
+int64_t lily_kernel_sum_int(const lily_raw_value *raw, uint32_t count)
+{
+    return KERNELS->sum_int(raw, count);
+}
+
+int64_t lily_kernel_min_int(const lily_raw_value *raw, uint32_t count)
+{
+    return KERNELS->min_int(raw, count);
+}
+
+int64_t lily_kernel_max_int(const lily_raw_value *raw, uint32_t count)
+{
+    return KERNELS->max_int(raw, count);
+}
+
+int64_t lily_kernel_find_int(const lily_raw_value *raw, uint32_t count,
+        int64_t needle)
+{
+    return KERNELS->find_int(raw, count, needle);
+}
+
+int64_t lily_kernel_find_double(const lily_raw_value *raw, uint32_t count,
+        double needle)
+{
+    return KERNELS->find_double(raw, count, needle);
+}
+
+int lily_kernel_eq_int(const lily_raw_value *left,
+        const lily_raw_value *right, uint32_t count)
+{
+    return KERNELS->eq_int(left, right, count);
+}
+
+int lily_kernel_eq_double(const lily_raw_value *left,
+        const lily_raw_value *right, uint32_t count)
+{
+    return KERNELS->eq_double(left, right, count);
+}
+
+void lily_kernel_fill(lily_raw_value *raw, uint32_t count,
+        lily_raw_value source)
+{
+    KERNELS->fill(raw, count, source);
+}
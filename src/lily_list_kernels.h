@@ -0,0 +1,33 @@
+#ifndef LILY_LIST_KERNELS_H
+# define LILY_LIST_KERNELS_H
+
+# include <stdint.h>
+
+# include "lily_core_types.h"
+
+/* These work over the raw elements of a packed List. Each of them has a plain
+   C version, and (when built with LILY_SIMD_KERNELS on x86-64) SSE2 and AVX2
+   versions. The best version the cpu supports is picked the first time any of
+   them is called. */
+
+/* Integer sums wrap around on overflow, like the + operator does. */
+int64_t lily_kernel_sum_int(const lily_raw_value *, uint32_t);
+
+/* These require that the count is at least 1. */
+int64_t lily_kernel_min_int(const lily_raw_value *, uint32_t);
+int64_t lily_kernel_max_int(const lily_raw_value *, uint32_t);
+
+/* These return the index of the first element equal to the value given, or -1
+   if there isn't one. A Double is found using ==, so nan is never found. */
+int64_t lily_kernel_find_int(const lily_raw_value *, uint32_t, int64_t);
+int64_t lily_kernel_find_double(const lily_raw_value *, uint32_t, double);
+
+/* These return 1 if every element of the two sources is equal, 0 otherwise. */
+int lily_kernel_eq_int(const lily_raw_value *, const lily_raw_value *,
+        uint32_t);
+int lily_kernel_eq_double(const lily_raw_value *, const lily_raw_value *,
+        uint32_t);
+
+void lily_kernel_fill(lily_raw_value *, uint32_t, lily_raw_value);
+
+#endif
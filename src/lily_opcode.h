@@ -84,9 +84,12 @@ typedef enum {
 
     /* Binary comparison ops:
        * int lineno
-       * reg(integer/double/string) left
-       * reg(typeof(left)) right
-       * reg(integer) result */
+       * reg(integer/double) left
+       * reg(integer/double) right
+       * reg(boolean) result
+       These are the slower comparison ops. They're used when one side is an
+       integer and the other a double. o_is_equal and o_not_eq are also used
+       for types that aren't integer, double, or string. */
     o_is_equal,
     o_not_eq,
     o_less,
@@ -94,6 +97,34 @@ typedef enum {
     o_greater,
     o_greater_eq,
 
+    /* Typed comparison ops:
+       * int lineno
+       * reg(integer/double/string) left
+       * reg(typeof(left)) right
+       * reg(boolean) result
+       These are used when both sides are known to have the same type, so
+       that the vm does not need to check the flags of either side. */
+    o_integer_eq,
+    o_integer_not_eq,
+    o_integer_less,
+    o_integer_less_eq,
+    o_integer_greater,
+    o_integer_greater_eq,
+
+    o_double_eq,
+    o_double_not_eq,
+    o_double_less,
+    o_double_less_eq,
+    o_double_greater,
+    o_double_greater_eq,
+
+    o_string_eq,
+    o_string_not_eq,
+    o_string_less,
+    o_string_less_eq,
+    o_string_greater,
+    o_string_greater_eq,
+
     /* jump:
        * int jump
        This specifies a jump to a future position in the code. Emitter is
@@ -111,6 +142,29 @@ typedef enum {
        Emitter is responsible for ensuring the jump is valid. */
     o_jump_if,
 
+    /* Fused compare and jump ops:
+       * int jump_on
+       * reg(integer/double) left
+       * reg(typeof(left)) right
+       * int jump
+       These combine a typed comparison with the jump_if that tests it. The
+       jump is taken when the result of the comparison is equal to jump_on.
+       Emitter writes these instead of a comparison and a jump_if when the
+       comparison's result is only used by the jump. */
+    o_jump_if_integer_eq,
+    o_jump_if_integer_not_eq,
+    o_jump_if_integer_less,
+    o_jump_if_integer_less_eq,
+    o_jump_if_integer_greater,
+    o_jump_if_integer_greater_eq,
+
+    o_jump_if_double_eq,
+    o_jump_if_double_not_eq,
+    o_jump_if_double_less,
+    o_jump_if_double_less_eq,
+    o_jump_if_double_greater,
+    o_jump_if_double_greater_eq,
+
     o_foreign_call,
 
     o_native_call,
@@ -230,6 +284,24 @@ typedef enum {
        * right is the value. The type is the value of the hash.  */
     o_set_item,
 
+    /* Get packed item:
+       * int lineno
+       * reg(list) left
+       * reg(integer) index
+       * reg(Boolean/Integer/Double) right
+       This is o_get_item for a List of Boolean, Integer, or Double. The emitter
+       writes this when it knows that the List will be packed, so the value is
+       copied straight out of the raw elements. */
+    o_get_packed_item,
+
+    /* Set packed item:
+       * int lineno
+       * reg(list) left
+       * reg(integer) index
+       * reg(Boolean/Integer/Double) right
+       This is o_set_item for a List of Boolean, Integer, or Double. */
+    o_set_packed_item,
+
     /* get global:
        * int lineno
        * reg global_reg
@@ -281,9 +353,13 @@ typedef enum {
        load a literal to use as an index. */
     o_set_property,
 
-    o_push_try,
-    o_pop_try,
-
+    /* except ignore, except catch:
+       * int lineno
+       * int class id
+       * reg target (ignore: always 0)
+       * int next except (0 if this is the last)
+       These are never run. A function's try table points to the first of
+       them, and the vm follows the chain when an exception is raised. */
     o_except_ignore,
     o_except_catch,
     o_raise,
@@ -306,6 +382,10 @@ typedef enum {
 
     o_create_function,
 
+    /* This is o_create_function, but the copy isn't tagged. The emitter writes
+       it for copies that won't outlive the expression they're made for. */
+    o_create_local_function,
+
     o_load_class_closure,
 
     o_load_closure,
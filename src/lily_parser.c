@@ -12,6 +12,7 @@
 
 #include "lily_pkg_builtin.h"
 #include "lily_pkg_sys.h"
+#include "lily_pkg_gc.h"
 
 #include "lily_api_alloc.h"
 #include "lily_api_value_ops.h"
@@ -47,7 +48,10 @@ static lily_package *new_package(lily_parse_state *, const char *,
    when it shouldn't. */
 lily_parse_state *lily_new_parse_state(lily_options *options)
 {
+    int uses_allocator = lily_use_allocator(options->allocator);
+
     lily_parse_state *parser = lily_malloc(sizeof(lily_parse_state));
+    parser->uses_allocator = uses_allocator;
     parser->data = options->data;
     parser->package_top = NULL;
     parser->package_start = NULL;
@@ -66,7 +70,7 @@ lily_parse_state *lily_new_parse_state(lily_options *options)
     lily_set_first_package(parser->symtab, parser->package_top);
     lily_init_pkg_builtin(parser->symtab);
 
-    parser->emit = lily_new_emit_state(parser->symtab, raiser);
+    parser->emit = lily_new_emit_state(options, parser->symtab, raiser);
     parser->lex = lily_new_lex_state(options, raiser);
     parser->vm = lily_new_vm_state(options, raiser);
     parser->msgbuf = lily_new_msgbuf();
@@ -112,6 +116,7 @@ lily_parse_state *lily_new_parse_state(lily_options *options)
     parser->symtab->active_module = parser->main_module;
 
     lily_pkg_sys_init(parser, options);
+    lily_pkg_gc_init(parser, options);
 
     parser->executing = 0;
 
@@ -186,7 +191,14 @@ void lily_free_parse_state(lily_parse_state *parser)
 
     lily_free_msgbuf(parser->msgbuf);
     lily_free_type_maker(parser->tm);
+
+    int uses_allocator = parser->uses_allocator;
+
     lily_free(parser);
+
+    /* Everything this parser allocated has been freed now. */
+    if (uses_allocator)
+        lily_release_allocator();
 }
 
 /***
@@ -3341,7 +3353,7 @@ static void try_handler(lily_parse_state *parser, int multi)
     lily_lex_state *lex = parser->lex;
 
     lily_emit_enter_block(parser->emit, block_try);
-    lily_emit_try(parser->emit, parser->lex->line_num);
+    lily_emit_try(parser->emit);
 
     NEED_CURRENT_TOK(tk_colon)
     lily_lexer(lex);
@@ -4202,10 +4214,11 @@ char *lily_build_error_message(lily_parse_state *parser)
     }
     else {
         lily_call_frame *frame = parser->vm->call_chain;
+        lily_call_frame *first_frame = parser->vm->call_frames;
 
         lily_msgbuf_add(msgbuf, "Traceback:\n");
 
-        while (frame) {
+        while (frame >= first_frame) {
             lily_function_val *func = frame->function;
             const char *class_name = func->class_name;
             char *separator;
@@ -4225,7 +4238,7 @@ char *lily_build_error_message(lily_parse_state *parser)
                         func->module->path, frame->line_num, class_name,
                         separator, func->trace_name);
 
-            frame = frame->prev;
+            frame--;
         }
     }
 
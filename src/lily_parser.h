@@ -22,7 +22,10 @@ typedef struct lily_parse_state_ {
     uint16_t executing;
     uint8_t first_pass;
     uint8_t generic_count;
-    uint32_t pad;
+    /* This is 1 if the parser has to give back the allocator when freed. */
+    uint8_t uses_allocator;
+    uint8_t pad;
+    uint16_t pad2;
 
     /* The current expression state. */
     lily_expr_state *expr;
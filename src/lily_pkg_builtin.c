@@ -3,6 +3,7 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "lily_list_kernels.h"
 #include "lily_parser.h"
 #include "lily_symtab.h"
 #include "lily_utf8.h"
@@ -32,18 +33,18 @@ const lily_gc_entry lily_gc_stopper =
 
 void lily_boolean_to_i(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 {
-    lily_value **vm_regs = vm->vm_regs;
-    lily_value *input_reg = vm_regs[code[1]];
-    lily_value *result_reg = vm_regs[code[0]];
+    lily_value *vm_regs = vm->vm_regs;
+    lily_value *input_reg = &vm_regs[code[1]];
+    lily_value *result_reg = &vm_regs[code[0]];
 
     lily_move_integer(result_reg, input_reg->value.integer);
 }
 
 void lily_boolean_to_s(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 {
-    lily_value **vm_regs = vm->vm_regs;
-    int64_t input = vm_regs[code[1]]->value.integer;
-    lily_value *result_reg = vm_regs[code[0]];
+    lily_value *vm_regs = vm->vm_regs;
+    int64_t input = vm_regs[code[1]].value.integer;
+    lily_value *result_reg = &vm_regs[code[0]];
     char *to_copy;
 
     if (input == 0)
@@ -65,11 +66,11 @@ void lily_boolean_to_s(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 
 void lily_bytestring_encode(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 {
-    lily_value **vm_regs = vm->vm_regs;
-    lily_string_val *input_bytestring = vm_regs[code[1]]->value.string;
+    lily_value *vm_regs = vm->vm_regs;
+    lily_string_val *input_bytestring = vm_regs[code[1]].value.string;
     const char *encode_method =
-            (argc == 2) ? vm_regs[code[2]]->value.string->string : "error";
-    lily_value *result = vm_regs[code[0]];
+            (argc == 2) ? vm_regs[code[2]].value.string->string : "error";
+    lily_value *result = &vm_regs[code[0]];
     char *byte_buffer = NULL;
 
     if (strcmp(encode_method, "error") == 0) {
@@ -101,9 +102,9 @@ void lily_bytestring_encode(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 
 void lily_double_to_i(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 {
-    lily_value **vm_regs = vm->vm_regs;
-    int64_t integer_val = (int64_t)vm_regs[code[1]]->value.doubleval;
-    lily_value *result_reg = vm_regs[code[0]];
+    lily_value *vm_regs = vm->vm_regs;
+    int64_t integer_val = (int64_t)vm_regs[code[1]].value.doubleval;
+    lily_value *result_reg = &vm_regs[code[0]];
 
     lily_move_integer(result_reg, integer_val);
 }
@@ -119,9 +120,9 @@ void lily_double_to_i(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 
 void lily_dynamic_new(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 {
-    lily_value **vm_regs = vm->vm_regs;
-    lily_value *result = vm_regs[code[0]];
-    lily_value *input = vm_regs[code[1]];
+    lily_value *vm_regs = vm->vm_regs;
+    lily_value *result = &vm_regs[code[0]];
+    lily_value *input = &vm_regs[code[1]];
 
     if (input->flags & VAL_IS_DEREFABLE)
         input->value.generic->refcount++;
@@ -144,9 +145,9 @@ void lily_dynamic_new(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 
 static void either_is_left_right(lily_vm_state *vm, uint16_t *code, int expect)
 {
-    lily_value **vm_regs = vm->vm_regs;
-    lily_instance_val *iv = vm_regs[code[1]]->value.instance;
-    lily_value *result_reg = vm_regs[code[0]];
+    lily_value *vm_regs = vm->vm_regs;
+    lily_instance_val *iv = vm_regs[code[1]].value.instance;
+    lily_value *result_reg = &vm_regs[code[0]];
 
     lily_move_boolean(result_reg, (iv->variant_id == expect));
 }
@@ -163,13 +164,13 @@ void lily_either_is_right(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 
 static void either_optionize_left_right(lily_vm_state *vm, uint16_t *code, int expect)
 {
-    lily_value **vm_regs = vm->vm_regs;
-    lily_instance_val *iv = vm_regs[code[1]]->value.instance;
-    lily_value *result_reg = vm_regs[code[0]];
+    lily_value *vm_regs = vm->vm_regs;
+    lily_instance_val *iv = vm_regs[code[1]].value.instance;
+    lily_value *result_reg = &vm_regs[code[0]];
 
     if (iv->variant_id == expect)
         lily_move_enum_f(MOVE_DEREF_SPECULATIVE, result_reg,
-                lily_new_some(lily_copy_value(iv->values[0])));
+                lily_new_some(lily_copy_value(&iv->values[0])));
     else
         lily_move_enum_f(MOVE_SHARED_NO_GC, result_reg, lily_get_none(vm));
 }
@@ -213,8 +214,8 @@ static void read_check(lily_vm_state *vm, lily_file_val *filev)
 
 void lily_file_close(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 {
-    lily_value **vm_regs = vm->vm_regs;
-    lily_file_val *filev = vm_regs[code[1]]->value.file;
+    lily_value *vm_regs = vm->vm_regs;
+    lily_file_val *filev = vm_regs[code[1]].value.file;
 
     if (filev->inner_file != NULL) {
         if (filev->is_builtin == 0)
@@ -225,10 +226,10 @@ void lily_file_close(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 
 void lily_file_open(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 {
-    lily_value **vm_regs = vm->vm_regs;
-    char *path = vm_regs[code[1]]->value.string->string;
-    char *mode = vm_regs[code[2]]->value.string->string;
-    lily_value *result_reg = vm_regs[code[0]];
+    lily_value *vm_regs = vm->vm_regs;
+    char *path = vm_regs[code[1]].value.string->string;
+    char *mode = vm_regs[code[2]].value.string->string;
+    lily_value *result_reg = &vm_regs[code[0]];
 
     errno = 0;
     int ok;
@@ -269,14 +270,14 @@ void lily_file_write(lily_vm_state *, uint16_t, uint16_t *);
 void lily_file_print(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 {
     lily_file_write(vm, argc, code);
-    fputc('\n', vm->vm_regs[code[1]]->value.file->inner_file);
+    fputc('\n', vm->vm_regs[code[1]].value.file->inner_file);
 }
 
 void lily_file_read_line(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 {
-    lily_value **vm_regs = vm->vm_regs;
-    lily_file_val *filev = vm_regs[code[1]]->value.file;
-    lily_value *result_reg = vm_regs[code[0]];
+    lily_value *vm_regs = vm->vm_regs;
+    lily_file_val *filev = vm_regs[code[1]].value.file;
+    lily_value *result_reg = &vm_regs[code[0]];
     lily_msgbuf *vm_buffer = vm->vm_buffer;
     lily_msgbuf_flush(vm_buffer);
 
@@ -320,9 +321,9 @@ void lily_file_read_line(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 
 void lily_file_write(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 {
-    lily_value **vm_regs = vm->vm_regs;
-    lily_file_val *filev = vm_regs[code[1]]->value.file;
-    lily_value *to_write = vm_regs[code[2]];
+    lily_value *vm_regs = vm->vm_regs;
+    lily_file_val *filev = vm_regs[code[1]].value.file;
+    lily_value *to_write = &vm_regs[code[2]];
 
     write_check(vm, filev);
 
@@ -345,75 +346,175 @@ void lily_file_write(lily_vm_state *vm, uint16_t argc, uint16_t *code)
  *                            
  */
 
+/* Integer keys use the integer as their siphash, so the bits need to be mixed
+   up before being used to pick a bucket. Otherwise, keys that are multiples of
+   the bucket count would all land in the same bucket. */
+static inline uint32_t bucket_for(uint64_t siphash, uint32_t mask)
+{
+    siphash ^= siphash >> 33;
+    siphash *= 0xff51afd7ed558ccdULL;
+    siphash ^= siphash >> 33;
+
+    return (uint32_t)siphash & mask;
+}
+
+static int hash_key_eq(lily_value *left, lily_value *right)
+{
+    if (left->flags & VAL_IS_INTEGER)
+        return left->value.integer == right->value.integer;
+
+    lily_string_val *left_sv = left->value.string;
+    lily_string_val *right_sv = right->value.string;
+
+    /* Strings are immutable, so try a ptr compare first. If that fails, then
+       make sure the sizes match before calling strcmp. The size check is an
+       easy way to potentially skip a strcmp in case of hash collision. */
+    return left_sv == right_sv ||
+           (left_sv->size == right_sv->size &&
+            strcmp(left_sv->string, right_sv->string) == 0);
+}
+
+/* This returns the bucket that holds the element for 'key', or the empty bucket
+   that 'key' would be put into. The hash must have buckets. */
+static uint32_t find_bucket(lily_hash_val *hash_val, uint64_t key_siphash,
+        lily_value *key)
+{
+    uint32_t mask = hash_val->bucket_mask;
+    uint32_t *buckets = hash_val->buckets;
+    uint32_t i = bucket_for(key_siphash, mask);
+
+    while (buckets[i]) {
+        lily_hash_elem *elem = hash_val->elems + buckets[i] - 1;
+
+        if (elem->key_siphash == key_siphash &&
+            hash_key_eq(&elem->elem_key, key))
+            break;
+
+        i = (i + 1) & mask;
+    }
+
+    return i;
+}
+
 /* Attempt to find 'key' within 'hash_val'. If an element is found, then it is
-   returned. If no element is found, then NULL is returned. */
+   returned. If no element is found, then NULL is returned. The element returned
+   is only valid until the next element is added to the hash. */
 lily_hash_elem *lily_hash_get_elem(lily_vm_state *vm, lily_hash_val *hash_val,
         lily_value *key)
 {
+    if (hash_val->num_elems == 0)
+        return NULL;
+
     uint64_t key_siphash = lily_siphash(vm, key);
-    lily_hash_elem *elem_iter = hash_val->elem_chain;
-    lily_raw_value key_value = key->value;
-    int flags = key->flags;
-    int ok = 0;
-
-    while (elem_iter) {
-        if (elem_iter->key_siphash == key_siphash) {
-            lily_raw_value iter_value = elem_iter->elem_key->value;
-
-            if (flags & VAL_IS_INTEGER &&
-                iter_value.integer == key_value.integer)
-                ok = 1;
-            else if (flags & VAL_IS_STRING &&
-                    /* strings are immutable, so try a ptr compare first. */
-                    ((iter_value.string == key_value.string) ||
-                     /* No? Make sure the sizes match, then call for a strcmp.
-                        The size check is an easy way to potentially skip a
-                        strcmp in case of hash collision. */
-                      (iter_value.string->size == key_value.string->size &&
-                       strcmp(iter_value.string->string,
-                              key_value.string->string) == 0)))
-                ok = 1;
-            else
-                ok = 0;
+    uint32_t bucket = find_bucket(hash_val, key_siphash, key);
+    uint32_t index = hash_val->buckets[bucket];
 
-            if (ok)
-                break;
-        }
-        elem_iter = elem_iter->next;
-    }
+    if (index == 0)
+        return NULL;
 
-    return elem_iter;
+    return hash_val->elems + index - 1;
 }
 
-static inline void remove_key_check(lily_vm_state *vm, lily_hash_val *hash_val)
+/* This rebuilds the hash so that it has room for at least one more element.
+   Deleted elements are squeezed out, which keeps the remaining elements in the
+   same order. If half of the elements are dead, then the space is reused
+   instead of growing. */
+static void grow_hash(lily_hash_val *hash_val)
 {
-    if (hash_val->iter_count)
-        lily_vm_raise(vm, SYM_CLASS_RUNTIMEERROR,
-                "Cannot remove key from hash during iteration.\n");
+    lily_hash_elem *elems = hash_val->elems;
+    uint32_t space = hash_val->elem_space;
+    uint32_t i, j;
+
+    if (space == 0)
+        space = 4;
+    else if (hash_val->num_elems > space / 2)
+        space *= 2;
+
+    for (i = 0, j = 0;i < hash_val->elem_count;i++) {
+        if (elems[i].elem_key.flags == 0)
+            continue;
+
+        if (i != j)
+            elems[j] = elems[i];
+
+        j++;
+    }
+
+    elems = lily_realloc(elems, space * sizeof(lily_hash_elem));
+
+    uint32_t bucket_count = space * 2;
+    uint32_t mask = bucket_count - 1;
+    uint32_t *buckets = lily_realloc(hash_val->buckets,
+            bucket_count * sizeof(uint32_t));
+
+    memset(buckets, 0, bucket_count * sizeof(uint32_t));
+
+    for (i = 0;i < j;i++) {
+        uint32_t b = bucket_for(elems[i].key_siphash, mask);
+        while (buckets[b])
+            b = (b + 1) & mask;
+
+        buckets[b] = i + 1;
+    }
+
+    hash_val->elems = elems;
+    hash_val->elem_count = j;
+    hash_val->elem_space = space;
+    hash_val->buckets = buckets;
+    hash_val->bucket_mask = mask;
 }
 
-/* This adds a new element to the hash, with 'pair_key' and 'pair_value' inside.
-   The key and value are not given a refbump, and are not copied over. For that,
-   see lily_hash_add_unique. */
-static void hash_add_unique_nocopy(lily_vm_state *vm, lily_hash_val *hash_val,
+/* This adds a new element to the hash, with the contents of 'pair_key' and
+   'pair_value' inside. The contents are not given a refbump. Callers should be
+   certain that 'pair_key' is not already within the hash. If it is anyway
+   (Apache tables can repeat keys), then the newest value wins. */
+static void hash_insert(lily_hash_val *hash_val, uint64_t key_siphash,
         lily_value *pair_key, lily_value *pair_value)
 {
-    lily_hash_elem *elem = lily_malloc(sizeof(lily_hash_elem));
+    if (hash_val->elem_count == hash_val->elem_space)
+        grow_hash(hash_val);
 
-    elem->key_siphash = lily_siphash(vm, pair_key);
-    elem->elem_key = pair_key;
-    elem->elem_value = pair_value;
+    uint32_t bucket = find_bucket(hash_val, key_siphash, pair_key);
+    lily_hash_elem *elem;
 
-    if (hash_val->elem_chain)
-        hash_val->elem_chain->prev = elem;
+    if (hash_val->buckets[bucket]) {
+        elem = hash_val->elems + hash_val->buckets[bucket] - 1;
+        lily_deref(pair_key);
+        lily_assign_value_noref(&elem->elem_value, pair_value);
+        return;
+    }
 
-    elem->prev = NULL;
-    elem->next = hash_val->elem_chain;
-    hash_val->elem_chain = elem;
+    elem = hash_val->elems + hash_val->elem_count;
 
+    elem->key_siphash = key_siphash;
+    elem->elem_key = *pair_key;
+    elem->elem_value = *pair_value;
+
+    hash_val->elem_count++;
+    hash_val->buckets[bucket] = hash_val->elem_count;
     hash_val->num_elems++;
 }
 
+/* This adds a new element to the hash, with 'pair_key' and 'pair_value' inside.
+   The hash takes over the contents of 'pair_key' and 'pair_value' (which are
+   not given a refbump), and frees the boxes that held them.
+   This does not need a vm, so that modules can build hashes at load time. */
+void lily_hash_add_unique_take(lily_hash_val *hash_val, uint64_t key_siphash,
+        lily_value *pair_key, lily_value *pair_value)
+{
+    hash_insert(hash_val, key_siphash, pair_key, pair_value);
+
+    lily_free_fixed(pair_key, sizeof(lily_value));
+    lily_free_fixed(pair_value, sizeof(lily_value));
+}
+
+static inline void remove_key_check(lily_vm_state *vm, lily_hash_val *hash_val)
+{
+    if (hash_val->iter_count)
+        lily_vm_raise(vm, SYM_CLASS_RUNTIMEERROR,
+                "Cannot remove key from hash during iteration.\n");
+}
+
 /* This function will add an element to the hash with 'pair_key' as the key and
    'pair_value' as the value. This should only be used in cases where the
    caller is completely certain that 'pair_key' is not within the hash. If the
@@ -423,10 +524,13 @@ void lily_hash_add_unique(lily_vm_state *vm, lily_hash_val *hash_val,
 {
     remove_key_check(vm, hash_val);
 
-    pair_key = lily_copy_value(pair_key);
-    pair_value = lily_copy_value(pair_value);
+    if (pair_key->flags & VAL_IS_DEREFABLE)
+        pair_key->value.generic->refcount++;
 
-    hash_add_unique_nocopy(vm, hash_val, pair_key, pair_value);
+    if (pair_value->flags & VAL_IS_DEREFABLE)
+        pair_value->value.generic->refcount++;
+
+    hash_insert(hash_val, lily_siphash(vm, pair_key), pair_key, pair_value);
 }
 
 /* This attempts to find 'pair_key' within 'hash_val'. If successful, then the
@@ -439,32 +543,30 @@ void lily_hash_set_elem(lily_vm_state *vm, lily_hash_val *hash_val,
     if (elem == NULL)
         lily_hash_add_unique(vm, hash_val, pair_key, pair_value);
     else
-        lily_assign_value(elem->elem_value, pair_value);
+        lily_assign_value(&elem->elem_value, pair_value);
 }
 
 static void destroy_elem(lily_hash_elem *elem)
 {
-    lily_deref(elem->elem_key);
-    lily_free(elem->elem_key);
-
-    lily_deref(elem->elem_value);
-    lily_free(elem->elem_value);
+    lily_deref(&elem->elem_key);
+    lily_deref(&elem->elem_value);
 
-    lily_free(elem);
+    elem->elem_key.flags = 0;
+    elem->elem_value.flags = 0;
 }
 
 static void destroy_hash_elems(lily_hash_val *hash_val)
 {
-    lily_hash_elem *elem_iter = hash_val->elem_chain;
-    lily_hash_elem *elem_next;
-
-    while (elem_iter) {
-        elem_next = elem_iter->next;
+    lily_hash_elem *elems = hash_val->elems;
+    uint32_t i;
 
-        destroy_elem(elem_iter);
-
-        elem_iter = elem_next;
+    for (i = 0;i < hash_val->elem_count;i++) {
+        if (elems[i].elem_key.flags)
+            destroy_elem(elems + i);
     }
+
+    lily_free(hash_val->elems);
+    lily_free(hash_val->buckets);
 }
 
 void lily_destroy_hash(lily_value *v)
@@ -478,8 +580,8 @@ void lily_destroy_hash(lily_value *v)
 
 void lily_hash_clear(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 {
-    lily_value **vm_regs = vm->vm_regs;
-    lily_hash_val *hash_val = vm_regs[code[1]]->value.hash;
+    lily_value *vm_regs = vm->vm_regs;
+    lily_hash_val *hash_val = vm_regs[code[1]].value.hash;
 
     if (hash_val->iter_count != 0)
         lily_vm_raise(vm, SYM_CLASS_RUNTIMEERROR,
@@ -487,93 +589,124 @@ void lily_hash_clear(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 
     destroy_hash_elems(hash_val);
 
-    hash_val->elem_chain = NULL;
+    hash_val->elems = NULL;
+    hash_val->buckets = NULL;
+    hash_val->elem_count = 0;
+    hash_val->elem_space = 0;
+    hash_val->bucket_mask = 0;
     hash_val->num_elems = 0;
 }
 
 void lily_hash_get(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 {
-    lily_value **vm_regs = vm->vm_regs;
-    lily_value *input = vm_regs[code[1]];
-    lily_value *key = vm_regs[code[2]];
-    lily_value *default_value = vm_regs[code[3]];
-    lily_value *result = vm_regs[code[0]];
+    lily_value *vm_regs = vm->vm_regs;
+    lily_value *input = &vm_regs[code[1]];
+    lily_value *key = &vm_regs[code[2]];
+    lily_value *default_value = &vm_regs[code[3]];
+    lily_value *result = &vm_regs[code[0]];
 
     lily_hash_elem *hash_elem = lily_hash_get_elem(vm, input->value.hash, key);
-    lily_value *new_value = hash_elem ? hash_elem->elem_value : default_value;
+    lily_value *new_value = hash_elem ? &hash_elem->elem_value : default_value;
 
     lily_assign_value(result, new_value);
 }
 
 void lily_hash_keys(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 {
-    lily_value **vm_regs = vm->vm_regs;
-    lily_hash_val *hash_val = vm_regs[code[1]]->value.hash;
-    lily_value *result_reg = vm_regs[code[0]];
+    lily_value *vm_regs = vm->vm_regs;
+    lily_hash_val *hash_val = vm_regs[code[1]].value.hash;
+    lily_value *result_reg = &vm_regs[code[0]];
 
     int num_elems = hash_val->num_elems;
 
-    lily_list_val *result_lv = lily_new_list_val();
-    result_lv->num_values = num_elems;
-    result_lv->elems = lily_malloc(num_elems * sizeof(lily_value *));
+    lily_list_val *result_lv = lily_new_list_of(num_elems,
+            num_elems ? &hash_val->elems[0].elem_key : NULL);
 
-    int i = 0;
+    int i, j;
 
-    lily_hash_elem *elem_iter = hash_val->elem_chain;
-    while (elem_iter) {
-        result_lv->elems[i] = lily_copy_value(elem_iter->elem_key);
+    /* Elements are walked from newest to oldest. */
+    for (i = (int)hash_val->elem_count - 1, j = 0;i >= 0;i--) {
+        lily_hash_elem *elem = hash_val->elems + i;
+        if (elem->elem_key.flags == 0)
+            continue;
 
-        i++;
-        elem_iter = elem_iter->next;
+        lily_list_init_elem(result_lv, j, &elem->elem_key);
+        j++;
     }
 
     lily_move_list_f(MOVE_DEREF_SPECULATIVE, result_reg, result_lv);
 }
 
-void lily_hash_delete(lily_vm_state *vm, uint16_t argc, uint16_t *code)
+/* This removes the element that 'bucket' refers to from the buckets. Elements
+   after it in the same run are shifted back, so that lookups never need to step
+   over a deleted bucket. */
+static void remove_bucket(lily_hash_val *hash_val, uint32_t bucket)
 {
-    lily_value **vm_regs = vm->vm_regs;
-    lily_hash_val *hash_val = vm_regs[code[1]]->value.hash;
-    lily_value *key = vm_regs[code[2]];
+    uint32_t mask = hash_val->bucket_mask;
+    uint32_t *buckets = hash_val->buckets;
+    uint32_t hole = bucket;
+    uint32_t i = (bucket + 1) & mask;
 
-    remove_key_check(vm, hash_val);
+    while (buckets[i]) {
+        lily_hash_elem *elem = hash_val->elems + buckets[i] - 1;
+        uint32_t home = bucket_for(elem->key_siphash, mask);
 
-    lily_hash_elem *hash_elem = lily_hash_get_elem(vm, hash_val, key);
+        /* The element can fill the hole if the hole is between where the
+           element wanted to be and where it is. */
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            buckets[hole] = buckets[i];
+            hole = i;
+        }
 
-    if (hash_elem) {
-        if (hash_elem->next)
-            hash_elem->next->prev = hash_elem->prev;
+        i = (i + 1) & mask;
+    }
+
+    buckets[hole] = 0;
+}
 
-        if (hash_elem->prev)
-            hash_elem->prev->next = hash_elem->next;
+void lily_hash_delete(lily_vm_state *vm, uint16_t argc, uint16_t *code)
+{
+    lily_value *vm_regs = vm->vm_regs;
+    lily_hash_val *hash_val = vm_regs[code[1]].value.hash;
+    lily_value *key = &vm_regs[code[2]];
 
-        if (hash_elem == hash_val->elem_chain)
-            hash_val->elem_chain = hash_elem->next;
+    remove_key_check(vm, hash_val);
 
-        destroy_elem(hash_elem);
+    if (hash_val->num_elems == 0)
+        return;
+
+    uint32_t bucket = find_bucket(hash_val, lily_siphash(vm, key), key);
+    uint32_t index = hash_val->buckets[bucket];
+
+    if (index) {
+        remove_bucket(hash_val, bucket);
+        destroy_elem(hash_val->elems + index - 1);
         hash_val->num_elems--;
     }
 }
 
 void lily_hash_each_pair(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 {
-    lily_value **vm_regs = vm->vm_regs;
-    lily_hash_val *hash_val = vm_regs[code[1]]->value.hash;
-    lily_value *function_reg = vm_regs[code[2]];
-    lily_hash_elem *elem_iter = hash_val->elem_chain;
-    int cached = 0;
+    lily_value *vm_regs = vm->vm_regs;
+    lily_hash_val *hash_val = vm_regs[code[1]].value.hash;
+    lily_prepared_call call;
+    int i;
+
+    lily_prepare_call(vm, &call, &vm_regs[code[2]], 2, 0);
 
     hash_val->iter_count++;
     lily_jump_link *link = lily_jump_setup(vm->raiser);
     if (setjmp(link->jump) == 0) {
-        while (elem_iter) {
-            lily_value *e_key = elem_iter->elem_key;
-            lily_value *e_value = elem_iter->elem_value;
-
-            lily_foreign_call(vm, &cached, 0, function_reg, 2, e_key,
-                    e_value);
+        for (i = (int)hash_val->elem_count - 1;i >= 0;i--) {
+            lily_hash_elem *elem = hash_val->elems + i;
+            if (elem->elem_key.flags == 0)
+                continue;
 
-            elem_iter = elem_iter->next;
+            lily_assign_value(lily_prepared_arg(vm, &call, 0),
+                    &elem->elem_key);
+            lily_assign_value(lily_prepared_arg(vm, &call, 1),
+                    &elem->elem_value);
+            lily_call_prepared(vm, &call);
         }
 
         hash_val->iter_count--;
@@ -587,13 +720,13 @@ void lily_hash_each_pair(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 
 void lily_hash_has_key(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 {
-    lily_value **vm_regs = vm->vm_regs;
-    lily_hash_val *hash_val = vm_regs[code[1]]->value.hash;
-    lily_value *key = vm_regs[code[2]];
+    lily_value *vm_regs = vm->vm_regs;
+    lily_hash_val *hash_val = vm_regs[code[1]].value.hash;
+    lily_value *key = &vm_regs[code[2]];
 
     lily_hash_elem *hash_elem = lily_hash_get_elem(vm, hash_val, key);
 
-    lily_move_integer(vm_regs[code[0]], hash_elem != NULL);
+    lily_move_integer(&vm_regs[code[0]], hash_elem != NULL);
 }
 
 static void build_hash_from_vm_list(lily_vm_state *vm, int start,
@@ -602,13 +735,16 @@ static void build_hash_from_vm_list(lily_vm_state *vm, int start,
     int stop = vm->vm_list->pos;
     int i;
     lily_hash_val *hash_val = lily_new_hash_val();
-    lily_value **values = vm->vm_list->values;
+    lily_value *values = vm->vm_list->values;
 
-    for (i = start;i < stop;i += 2) {
-        lily_value *e_key = values[i];
-        lily_value *e_value = values[i + 1];
+    /* The pairs were collected newest to oldest, so add them in reverse to
+       keep the same order in the new hash. The hash takes over the refs that
+       the vm_list held. */
+    for (i = stop - 2;i >= start;i -= 2) {
+        lily_value *e_key = &values[i];
+        lily_value *e_value = &values[i + 1];
 
-        hash_add_unique_nocopy(vm, hash_val, e_key, e_value);
+        hash_insert(hash_val, lily_siphash(vm, e_key), e_key, e_value);
     }
 
     vm->vm_list->pos = start;
@@ -618,36 +754,36 @@ static void build_hash_from_vm_list(lily_vm_state *vm, int start,
 
 void lily_hash_map_values(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 {
-    lily_value **vm_regs = vm->vm_regs;
-    lily_hash_val *hash_val = vm_regs[code[1]]->value.hash;
-    lily_value *function_reg = vm_regs[code[2]];
-    lily_value *result_reg = vm_regs[code[0]];
+    lily_value *vm_regs = vm->vm_regs;
+    lily_hash_val *hash_val = vm_regs[code[1]].value.hash;
 
-    lily_hash_elem *elem_iter = hash_val->elem_chain;
     lily_vm_list *vm_list = vm->vm_list;
-    int cached = 0;
+    lily_prepared_call call;
     int vm_list_start = vm->vm_list->pos;
+    int i;
 
     lily_vm_list_ensure(vm, hash_val->num_elems * 2);
+    lily_prepare_call(vm, &call, &vm_regs[code[2]], 1, 1);
 
     hash_val->iter_count++;
     lily_jump_link *link = lily_jump_setup(vm->raiser);
 
     if (setjmp(link->jump) == 0) {
-        while (elem_iter) {
-            lily_value *e_value = elem_iter->elem_value;
+        for (i = (int)hash_val->elem_count - 1;i >= 0;i--) {
+            lily_hash_elem *elem = hash_val->elems + i;
+            if (elem->elem_key.flags == 0)
+                continue;
 
-            lily_value *new_value = lily_foreign_call(vm, &cached, 1,
-                    function_reg, 1, e_value);
+            lily_assign_value(lily_prepared_arg(vm, &call, 0),
+                    &elem->elem_value);
+            lily_value *new_value = lily_call_prepared(vm, &call);
 
-            vm_list->values[vm_list->pos] = lily_copy_value(elem_iter->elem_key);
-            vm_list->values[vm_list->pos+1] = lily_copy_value(new_value);
+            lily_init_value(&vm_list->values[vm_list->pos], &elem->elem_key);
+            lily_init_value(&vm_list->values[vm_list->pos+1], new_value);
             vm_list->pos += 2;
-
-            elem_iter = elem_iter->next;
         }
 
-        build_hash_from_vm_list(vm, vm_list_start, result_reg);
+        build_hash_from_vm_list(vm, vm_list_start, &vm->vm_regs[code[0]]);
         hash_val->iter_count--;
         lily_release_jump(vm->raiser);
     }
@@ -659,32 +795,36 @@ void lily_hash_map_values(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 
 void lily_hash_merge(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 {
-    lily_value **vm_regs = vm->vm_regs;
-    lily_hash_val *hash_val = vm_regs[code[1]]->value.hash;
-    lily_list_val *to_merge = vm_regs[code[2]]->value.list;
-    lily_value *result_reg = vm_regs[code[0]];
+    lily_value *vm_regs = vm->vm_regs;
+    lily_hash_val *hash_val = vm_regs[code[1]].value.hash;
+    lily_list_val *to_merge = vm_regs[code[2]].value.list;
+    lily_value *result_reg = &vm_regs[code[0]];
 
     lily_hash_val *result_hash = lily_new_hash_val();
+    uint32_t i;
+    int j;
 
     /* The existing hash should be entirely unique, so just add the pairs in
        directly. */
-    lily_hash_elem *elem_iter = hash_val->elem_chain;
-    while (elem_iter) {
-        lily_hash_add_unique(vm, result_hash, elem_iter->elem_key,
-                elem_iter->elem_value);
+    for (i = 0;i < hash_val->elem_count;i++) {
+        lily_hash_elem *elem = hash_val->elems + i;
+        if (elem->elem_key.flags == 0)
+            continue;
 
-        elem_iter = elem_iter->next;
+        lily_hash_add_unique(vm, result_hash, &elem->elem_key,
+                &elem->elem_value);
     }
 
-    int i;
-    for (i = 0;i < to_merge->num_values;i++) {
-        lily_hash_val *merging_hash = to_merge->elems[i]->value.hash;
-        elem_iter = merging_hash->elem_chain;
-        while (elem_iter) {
-            lily_hash_set_elem(vm, result_hash, elem_iter->elem_key,
-                    elem_iter->elem_value);
-
-            elem_iter = elem_iter->next;
+    for (j = 0;j < to_merge->num_values;j++) {
+        lily_hash_val *merging_hash = to_merge->elems[j].value.hash;
+
+        for (i = 0;i < merging_hash->elem_count;i++) {
+            lily_hash_elem *elem = merging_hash->elems + i;
+            if (elem->elem_key.flags == 0)
+                continue;
+
+            lily_hash_set_elem(vm, result_hash, &elem->elem_key,
+                    &elem->elem_value);
         }
     }
 
@@ -694,39 +834,41 @@ void lily_hash_merge(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 static void hash_select_reject_common(lily_vm_state *vm, uint16_t argc,
         uint16_t *code, int expect)
 {
-    lily_value **vm_regs = vm->vm_regs;
-    lily_hash_val *hash_val = vm_regs[code[1]]->value.hash;
-    lily_value *function_reg = vm_regs[code[2]];
-    lily_value *result_reg = vm_regs[code[0]];
+    lily_value *vm_regs = vm->vm_regs;
+    lily_hash_val *hash_val = vm_regs[code[1]].value.hash;
 
-    lily_hash_elem *elem_iter = hash_val->elem_chain;
     lily_vm_list *vm_list = vm->vm_list;
-    int cached = 0;
+    lily_prepared_call call;
     int vm_list_start = vm->vm_list->pos;
+    int i;
 
     lily_vm_list_ensure(vm, hash_val->num_elems * 2);
+    lily_prepare_call(vm, &call, &vm_regs[code[2]], 2, 1);
 
     hash_val->iter_count++;
     lily_jump_link *link = lily_jump_setup(vm->raiser);
 
     if (setjmp(link->jump) == 0) {
-        while (elem_iter) {
-            lily_value *e_key = elem_iter->elem_key;
-            lily_value *e_value = elem_iter->elem_value;
+        for (i = (int)hash_val->elem_count - 1;i >= 0;i--) {
+            lily_hash_elem *elem = hash_val->elems + i;
+            if (elem->elem_key.flags == 0)
+                continue;
 
-            lily_value *result = lily_foreign_call(vm, &cached, 1,
-                    function_reg, 2, e_key, e_value);
+            lily_value *e_key = &elem->elem_key;
+            lily_value *e_value = &elem->elem_value;
+
+            lily_assign_value(lily_prepared_arg(vm, &call, 0), e_key);
+            lily_assign_value(lily_prepared_arg(vm, &call, 1), e_value);
+            lily_value *result = lily_call_prepared(vm, &call);
 
             if (result->value.integer == expect) {
-                vm_list->values[vm_list->pos] = lily_copy_value(e_key);
-                vm_list->values[vm_list->pos+1] = lily_copy_value(e_value);
+                lily_init_value(&vm_list->values[vm_list->pos], e_key);
+                lily_init_value(&vm_list->values[vm_list->pos+1], e_value);
                 vm_list->pos += 2;
             }
-
-            elem_iter = elem_iter->next;
         }
 
-        build_hash_from_vm_list(vm, vm_list_start, result_reg);
+        build_hash_from_vm_list(vm, vm_list_start, &vm->vm_regs[code[0]]);
         hash_val->iter_count--;
         lily_release_jump(vm->raiser);
     }
@@ -748,10 +890,10 @@ void lily_hash_select(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 
 void lily_hash_size(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 {
-    lily_value **vm_regs = vm->vm_regs;
-    lily_hash_val *hash_val = vm_regs[code[1]]->value.hash;
+    lily_value *vm_regs = vm->vm_regs;
+    lily_hash_val *hash_val = vm_regs[code[1]].value.hash;
 
-    lily_move_integer(vm_regs[code[0]], hash_val->num_elems);
+    lily_move_integer(&vm_regs[code[0]], hash_val->num_elems);
 }
 
 /***
@@ -765,18 +907,18 @@ void lily_hash_size(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 
 void lily_integer_to_d(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 {
-    lily_value **vm_regs = vm->vm_regs;
-    lily_value *result_reg = vm_regs[code[0]];
-    double doubleval = (double)vm_regs[code[1]]->value.integer;
+    lily_value *vm_regs = vm->vm_regs;
+    lily_value *result_reg = &vm_regs[code[0]];
+    double doubleval = (double)vm_regs[code[1]].value.integer;
 
     lily_move_double(result_reg, doubleval);
 }
 
 void lily_integer_to_s(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 {
-    lily_value **vm_regs = vm->vm_regs;
-    int64_t integer_val = vm_regs[code[1]]->value.integer;
-    lily_value *result_reg = vm_regs[code[0]];
+    lily_value *vm_regs = vm->vm_regs;
+    int64_t integer_val = vm_regs[code[1]].value.integer;
+    lily_value *result_reg = &vm_regs[code[0]];
 
     char buffer[32];
     snprintf(buffer, 32, "%"PRId64, integer_val);
@@ -795,9 +937,9 @@ void lily_integer_to_s(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 
 void lily_list_size(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 {
-    lily_value **vm_regs = vm->vm_regs;
-    lily_list_val *list_val = vm_regs[code[1]]->value.list;
-    lily_value *ret_reg = vm_regs[code[0]];
+    lily_value *vm_regs = vm->vm_regs;
+    lily_list_val *list_val = vm_regs[code[1]].value.list;
+    lily_value *ret_reg = &vm_regs[code[0]];
 
     lily_move_integer(ret_reg, list_val->num_values);
 }
@@ -809,45 +951,54 @@ static void make_extra_space_in_list(lily_list_val *lv)
     /* There's probably room for improvement here, later on. */
     int extra = (lv->num_values + 8) >> 2;
     lv->elems = lily_realloc(lv->elems,
-            (lv->num_values + extra) * sizeof(lily_value *));
+            (lv->num_values + extra) * LIST_ELEM_SIZE(lv));
     lv->extra_space = extra;
 }
 
+/* This is called before 'v' is added to the list. If the list is empty, then
+   this is where it finds out if it will be packed. */
+static void prepare_list_for(lily_list_val *lv, lily_value *v)
+{
+    if (lv->num_values == 0)
+        lily_list_pack_for(lv, v);
+
+    if (lv->extra_space == 0)
+        make_extra_space_in_list(lv);
+}
+
 void lily_list_push(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 {
-    lily_value **vm_regs = vm->vm_regs;
-    lily_list_val *list_val = vm_regs[code[1]]->value.list;
-    lily_value *insert_value = vm_regs[code[2]];
+    lily_value *vm_regs = vm->vm_regs;
+    lily_list_val *list_val = vm_regs[code[1]].value.list;
+    lily_value *insert_value = &vm_regs[code[2]];
 
-    if (list_val->extra_space == 0)
-        make_extra_space_in_list(list_val);
+    prepare_list_for(list_val, insert_value);
 
     int value_count = list_val->num_values;
 
-    list_val->elems[value_count] = lily_copy_value(insert_value);
+    lily_list_init_elem(list_val, value_count, insert_value);
     list_val->num_values++;
     list_val->extra_space--;
 }
 
 void lily_list_pop(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 {
-    lily_value **vm_regs = vm->vm_regs;
-    lily_list_val *list_val = vm_regs[code[1]]->value.list;
-    lily_value *result_reg = vm_regs[code[0]];
+    lily_value *vm_regs = vm->vm_regs;
+    lily_list_val *list_val = vm_regs[code[1]].value.list;
+    lily_value *result_reg = &vm_regs[code[0]];
 
     if (list_val->num_values == 0)
         lily_vm_raise(vm, SYM_CLASS_INDEXERROR, "Pop from an empty list.\n");
 
-    lily_value *source = list_val->elems[list_val->num_values - 1];
+    lily_value scratch;
+    lily_value *source = lily_list_get_elem(list_val,
+            list_val->num_values - 1, &scratch);
 
     /* This is a special case: The value must be moved, but there will be no
        net increase to refcount. Use assign (because it will copy over flags)
        but not the regular one or the refcount will be wrong. */
     lily_assign_value_noref(result_reg, source);
 
-    /* For now, free extra values instead of trying to keep reserves around.
-       Not the best course of action, perhaps, but certainly the simplest. */
-    lily_free(list_val->elems[list_val->num_values - 1]);
     list_val->num_values--;
     list_val->extra_space++;
 }
@@ -872,31 +1023,34 @@ static int64_t get_relative_index(lily_vm_state *vm, lily_list_val *list_val,
 
 void lily_list_insert(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 {
-    lily_value **vm_regs = vm->vm_regs;
-    lily_list_val *list_val = vm_regs[code[1]]->value.list;
-    int64_t insert_pos = vm_regs[code[2]]->value.integer;
-    lily_value *insert_value = vm_regs[code[3]];
+    lily_value *vm_regs = vm->vm_regs;
+    lily_list_val *list_val = vm_regs[code[1]].value.list;
+    int64_t insert_pos = vm_regs[code[2]].value.integer;
+    lily_value *insert_value = &vm_regs[code[3]];
 
     insert_pos = get_relative_index(vm, list_val, insert_pos);
 
-    if (list_val->extra_space == 0)
-        make_extra_space_in_list(list_val);
+    prepare_list_for(list_val, insert_value);
+
+    size_t elem_size = LIST_ELEM_SIZE(list_val);
+    char *elems = (char *)list_val->elems;
 
     /* Shove everything rightward to make space for the new value. */
     if (insert_pos != list_val->num_values)
-        memmove(list_val->elems + insert_pos + 1, list_val->elems + insert_pos,
-                (list_val->num_values - insert_pos) * sizeof(lily_value *));
+        memmove(elems + ((insert_pos + 1) * elem_size),
+                elems + (insert_pos * elem_size),
+                (list_val->num_values - insert_pos) * elem_size);
 
-    list_val->elems[insert_pos] = lily_copy_value(insert_value);
+    lily_list_init_elem(list_val, insert_pos, insert_value);
     list_val->num_values++;
     list_val->extra_space--;
 }
 
 void lily_list_delete_at(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 {
-    lily_value **vm_regs = vm->vm_regs;
-    lily_list_val *list_val = vm_regs[code[1]]->value.list;
-    int64_t pos = vm_regs[code[2]]->value.integer;
+    lily_value *vm_regs = vm->vm_regs;
+    lily_list_val *list_val = vm_regs[code[1]].value.list;
+    int64_t pos = vm_regs[code[2]].value.integer;
 
     if (list_val->num_values == 0)
         lily_vm_raise(vm, SYM_CLASS_INDEXERROR, "Cannot delete from an empty list.\n");
@@ -906,14 +1060,16 @@ void lily_list_delete_at(lily_vm_state *vm, uint16_t argc, uint16_t *code)
     if (list_val->extra_space == 0)
         make_extra_space_in_list(list_val);
 
-    lily_value *to_delete = list_val->elems[pos];
-    lily_deref(to_delete);
-    lily_free(to_delete);
+    size_t elem_size = LIST_ELEM_SIZE(list_val);
+    char *elems = (char *)list_val->elems;
+
+    if (list_val->packed_flags == 0)
+        lily_deref(&list_val->elems[pos]);
 
     /* Shove everything leftward hide the hole from erasing the value. */
     if (pos != list_val->num_values)
-        memmove(list_val->elems + pos, list_val->elems + pos + 1,
-                (list_val->num_values - pos) * sizeof(lily_value *));
+        memmove(elems + (pos * elem_size), elems + ((pos + 1) * elem_size),
+                (list_val->num_values - pos - 1) * elem_size);
 
     list_val->num_values--;
     list_val->extra_space++;
@@ -921,13 +1077,13 @@ void lily_list_delete_at(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 
 void lily_list_clear(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 {
-    lily_value **vm_regs = vm->vm_regs;
-    lily_list_val *list_val = vm_regs[code[1]]->value.list;
+    lily_value *vm_regs = vm->vm_regs;
+    lily_list_val *list_val = vm_regs[code[1]].value.list;
     int i;
 
-    for (i = 0;i < list_val->num_values;i++) {
-        lily_deref(list_val->elems[i]);
-        lily_free(list_val->elems[i]);
+    if (list_val->packed_flags == 0) {
+        for (i = 0;i < list_val->num_values;i++)
+            lily_deref(&list_val->elems[i]);
     }
 
     list_val->extra_space += list_val->num_values;
@@ -936,64 +1092,64 @@ void lily_list_clear(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 
 void lily_list_each(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 {
-    lily_value **vm_regs = vm->vm_regs;
-    lily_value *list_reg = vm_regs[code[1]];
-    lily_value *function_reg = vm_regs[code[2]];
-    lily_list_val *list_val = list_reg->value.list;
-    lily_value *result_reg = vm_regs[code[0]];
-    int cached = 0;
+    lily_value *vm_regs = vm->vm_regs;
+    lily_list_val *list_val = vm_regs[code[1]].value.list;
+    lily_value scratch;
+    lily_prepared_call call;
+
+    lily_prepare_call(vm, &call, &vm_regs[code[2]], 1, 1);
 
     int i;
-    for (i = 0;i < list_val->num_values;i++)
-        lily_foreign_call(vm, &cached, 1, function_reg, 1,
-                list_val->elems[i]);
+    for (i = 0;i < list_val->num_values;i++) {
+        lily_assign_value(lily_prepared_arg(vm, &call, 0),
+                lily_list_get_elem(list_val, i, &scratch));
+        lily_call_prepared(vm, &call);
+    }
 
-    lily_assign_value(result_reg, list_reg);
+    vm_regs = vm->vm_regs;
+    lily_assign_value(&vm_regs[code[0]], &vm_regs[code[1]]);
 }
 
 void lily_list_each_index(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 {
-    lily_value **vm_regs = vm->vm_regs;
-    lily_value *list_reg = vm_regs[code[1]];
-    lily_value *function_reg = vm_regs[code[2]];
-    lily_list_val *list_val = list_reg->value.list;
-    lily_value *result_reg = vm_regs[code[0]];
-    lily_value fake_reg;
+    lily_value *vm_regs = vm->vm_regs;
+    lily_list_val *list_val = vm_regs[code[1]].value.list;
+    lily_prepared_call call;
 
-    fake_reg.value.integer = 0;
-    fake_reg.flags = VAL_IS_INTEGER;
-
-    int cached = 0;
+    lily_prepare_call(vm, &call, &vm_regs[code[2]], 1, 0);
 
     int i;
-    for (i = 0;i < list_val->num_values;i++, fake_reg.value.integer++)
-        lily_foreign_call(vm, &cached, 0, function_reg, 1, &fake_reg);
+    for (i = 0;i < list_val->num_values;i++) {
+        lily_move_integer(lily_prepared_arg(vm, &call, 0), i);
+        lily_call_prepared(vm, &call);
+    }
 
-    lily_assign_value(result_reg, list_reg);
+    vm_regs = vm->vm_regs;
+    lily_assign_value(&vm_regs[code[0]], &vm_regs[code[1]]);
 }
 
 void lily_list_fill(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 {
-    lily_value **vm_regs = vm->vm_regs;
-    int n = vm_regs[code[1]]->value.integer;
+    lily_value *vm_regs = vm->vm_regs;
+    int n = vm_regs[code[1]].value.integer;
     if (n < 0)
         lily_vm_raise_fmt(vm, SYM_CLASS_VALUEERROR,
                 "Repeat count must be >= 0 (%d given).\n", n);
 
-    lily_value *to_repeat = vm_regs[code[2]];
-    lily_value *result = vm_regs[code[0]];
-    lily_list_val *lv = lily_new_list_val();
-
-    lily_move_list_f(MOVE_DEREF_SPECULATIVE, result, lv);
-
-    lily_value **elems = lily_malloc(sizeof(lily_value *) * n);
-    lv->elems = elems;
+    lily_value *to_repeat = &vm_regs[code[2]];
+    lily_value *result = &vm_regs[code[0]];
+    lily_list_val *lv = lily_new_list_of(n, to_repeat);
 
-    int i;
-    for (i = 0;i < n;i++)
-        elems[i] = lily_copy_value(to_repeat);
+    if (lv->packed_flags)
+        lily_kernel_fill(lv->raw_elems, n, to_repeat->value);
+    else {
+        int i;
+        for (i = 0;i < n;i++)
+            lily_init_value(&lv->elems[i], to_repeat);
+    }
 
-    lv->num_values = n;
+    /* This is done last, since the result may be the value repeated. */
+    lily_move_list_f(MOVE_DEREF_SPECULATIVE, result, lv);
 }
 
 /* This function will take 'vm_list->pos - vm_list_start' elements out of the
@@ -1001,20 +1157,23 @@ void lily_list_fill(lily_vm_state *vm, uint16_t argc, uint16_t *code)
    rewound to vm_list_start.
    This function assumes that values which are put into vm_list are copied (and
    thus receive a refcount bump). This allows the new list to simply take
-   ownership of the values in the vm_list. */
+   ownership of the values in the vm_list, so they are moved over in one block.
+   If the values are packable, only the raw part of each is moved over. */
 static void slice_vm_list(lily_vm_state *vm, int vm_list_start,
         lily_value *result_reg)
 {
     lily_vm_list *vm_list = vm->vm_list;
-    lily_list_val *result_list = lily_new_list_val();
     int num_values = vm_list->pos - vm_list_start;
+    lily_value *source = vm_list->values + vm_list_start;
+    lily_list_val *result_list = lily_new_list_of(num_values, source);
 
-    result_list->num_values = num_values;
-    result_list->elems = lily_malloc(sizeof(lily_value *) * num_values);
-
-    int i;
-    for (i = 0;i < num_values;i++)
-        result_list->elems[i] = vm_list->values[vm_list_start + i];
+    if (result_list->packed_flags) {
+        int i;
+        for (i = 0;i < num_values;i++)
+            result_list->raw_elems[i] = source[i].value;
+    }
+    else
+        memcpy(result_list->elems, source, sizeof(lily_value) * num_values);
 
     vm_list->pos = vm_list_start;
 
@@ -1024,74 +1183,89 @@ static void slice_vm_list(lily_vm_state *vm, int vm_list_start,
 static void list_select_reject_common(lily_vm_state *vm, uint16_t argc,
         uint16_t *code, int expect)
 {
-    lily_value **vm_regs = vm->vm_regs;
-    lily_value *result_reg = vm->vm_regs[code[0]];
-    lily_list_val *list_val = vm_regs[code[1]]->value.list;
-    lily_value *function_reg = vm_regs[code[2]];
+    lily_value *vm_regs = vm->vm_regs;
+    lily_list_val *list_val = vm_regs[code[1]].value.list;
 
     lily_vm_list *vm_list = vm->vm_list;
     int vm_list_start = vm_list->pos;
-    int cached = 0;
+    lily_prepared_call call;
 
     lily_vm_list_ensure(vm, list_val->num_values);
+    lily_prepare_call(vm, &call, &vm_regs[code[2]], 1, 1);
 
+    lily_value scratch;
     int i;
     for (i = 0;i < list_val->num_values;i++) {
-        lily_value *result = lily_foreign_call(vm, &cached, 1,
-                function_reg, 1, list_val->elems[i]);
+        lily_assign_value(lily_prepared_arg(vm, &call, 0),
+                lily_list_get_elem(list_val, i, &scratch));
+        lily_value *result = lily_call_prepared(vm, &call);
 
         if (result->value.integer == expect) {
-            vm_list->values[vm_list->pos] = lily_copy_value(list_val->elems[i]);
+            lily_init_value(&vm_list->values[vm_list->pos],
+                    lily_list_get_elem(list_val, i, &scratch));
             vm_list->pos++;
         }
     }
 
-    slice_vm_list(vm, vm_list_start, result_reg);
+    slice_vm_list(vm, vm_list_start, &vm->vm_regs[code[0]]);
 }
 
 void lily_list_count(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 {
-    lily_value **vm_regs = vm->vm_regs;
-    lily_value *result_reg = vm->vm_regs[code[0]];
-    lily_list_val *list_val = vm_regs[code[1]]->value.list;
-    lily_value *function_reg = vm_regs[code[2]];
+    lily_value *vm_regs = vm->vm_regs;
+    lily_list_val *list_val = vm_regs[code[1]].value.list;
+    lily_value scratch;
+    lily_prepared_call call;
     int count = 0;
 
-    int cached = 0;
+    lily_prepare_call(vm, &call, &vm_regs[code[2]], 1, 1);
 
     int i;
     for (i = 0;i < list_val->num_values;i++) {
-        lily_value *result = lily_foreign_call(vm, &cached, 1,
-                function_reg, 1, list_val->elems[i]);
+        lily_assign_value(lily_prepared_arg(vm, &call, 0),
+                lily_list_get_elem(list_val, i, &scratch));
+        lily_value *result = lily_call_prepared(vm, &call);
 
         if (result->value.integer == 1)
             count++;
     }
 
-    lily_move_integer(result_reg, count);
+    lily_move_integer(&vm->vm_regs[code[0]], count);
 }
 
 void lily_list_join(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 {
-    lily_value **vm_regs = vm->vm_regs;
-    lily_value *result_reg = vm_regs[code[0]];
-    lily_list_val *lv = vm_regs[code[1]]->value.list;
+    lily_value *vm_regs = vm->vm_regs;
+    lily_value *result_reg = &vm_regs[code[0]];
+    lily_list_val *lv = vm_regs[code[1]].value.list;
     const char *delim = "";
     if (argc == 2)
-        delim = vm_regs[code[2]]->value.string->string;
+        delim = vm_regs[code[2]].value.string->string;
 
     lily_msgbuf *vm_buffer = vm->vm_buffer;
     lily_msgbuf_flush(vm_buffer);
 
-    if (lv->num_values) {
+    if (lv->num_values && lv->packed_flags == VAL_IS_INTEGER) {
+        /* This is the most common packed join, so skip building values. */
         int i, stop = lv->num_values - 1;
-        lily_value **values = lv->elems;
+        lily_raw_value *raw_elems = lv->raw_elems;
         for (i = 0;i < stop;i++) {
-            lily_vm_add_value_to_msgbuf(vm, vm_buffer, values[i]);
+            lily_msgbuf_add_int(vm_buffer, raw_elems[i].integer);
+            lily_msgbuf_add(vm_buffer, delim);
+        }
+        lily_msgbuf_add_int(vm_buffer, raw_elems[i].integer);
+    }
+    else if (lv->num_values) {
+        int i, stop = lv->num_values - 1;
+        lily_value scratch;
+        for (i = 0;i < stop;i++) {
+            lily_vm_add_value_to_msgbuf(vm, vm_buffer,
+                    lily_list_get_elem(lv, i, &scratch));
             lily_msgbuf_add(vm_buffer, delim);
         }
         if (stop != -1)
-            lily_vm_add_value_to_msgbuf(vm, vm_buffer, values[i]);
+            lily_vm_add_value_to_msgbuf(vm, vm_buffer,
+                    lily_list_get_elem(lv, i, &scratch));
     }
 
     lily_move_string(result_reg, lily_new_raw_string(vm_buffer->message));
@@ -1109,52 +1283,51 @@ void lily_list_reject(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 
 void lily_list_map(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 {
-    lily_value **vm_regs = vm->vm_regs;
-    lily_value *result_reg = vm->vm_regs[code[0]];
-    lily_list_val *list_val = vm_regs[code[1]]->value.list;
-    lily_value *function_reg = vm_regs[code[2]];
+    lily_value *vm_regs = vm->vm_regs;
+    lily_list_val *list_val = vm_regs[code[1]].value.list;
 
     lily_vm_list *vm_list = vm->vm_list;
     int vm_list_start = vm_list->pos;
-    int cached = 0;
+    lily_prepared_call call;
 
     lily_vm_list_ensure(vm, list_val->num_values);
+    lily_prepare_call(vm, &call, &vm_regs[code[2]], 1, 1);
 
+    lily_value scratch;
     int i;
     for (i = 0;i < list_val->num_values;i++) {
-        lily_value *result = lily_foreign_call(vm, &cached, 1,
-                function_reg, 1, list_val->elems[i]);
+        lily_assign_value(lily_prepared_arg(vm, &call, 0),
+                lily_list_get_elem(list_val, i, &scratch));
+        lily_value *result = lily_call_prepared(vm, &call);
 
-        vm_list->values[vm_list->pos] = lily_copy_value(result);
+        lily_init_value(&vm_list->values[vm_list->pos], result);
         vm_list->pos++;
     }
 
-    slice_vm_list(vm, vm_list_start, result_reg);
+    slice_vm_list(vm, vm_list_start, &vm->vm_regs[code[0]]);
 }
 
 void lily_list_shift(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 {
-    lily_value **vm_regs = vm->vm_regs;
-    lily_list_val *list_val = vm_regs[code[1]]->value.list;
-    lily_value *result_reg = vm_regs[code[0]];
+    lily_value *vm_regs = vm->vm_regs;
+    lily_list_val *list_val = vm_regs[code[1]].value.list;
+    lily_value *result_reg = &vm_regs[code[0]];
 
     if (list_val->num_values == 0)
         lily_vm_raise(vm, SYM_CLASS_INDEXERROR, "Shift on an empty list.\n");
 
-    lily_value *source = list_val->elems[0];
+    lily_value scratch;
+    lily_value *source = lily_list_get_elem(list_val, 0, &scratch);
+    size_t elem_size = LIST_ELEM_SIZE(list_val);
+    char *elems = (char *)list_val->elems;
 
     /* Similar to List.pop, the value is being taken out so use this custom
        assign to keep the refcount the same. */
     lily_assign_value_noref(result_reg, source);
 
-    /* For now, free extra values instead of trying to keep reserves around.
-       Not the best course of action, perhaps, but certainly the simplest. */
-    lily_free(list_val->elems[0]);
-
     if (list_val->num_values != 1)
-        memmove(list_val->elems, list_val->elems + 1,
-                (list_val->num_values - 1) *
-                sizeof(lily_value *));
+        memmove(elems, elems + elem_size,
+                (list_val->num_values - 1) * elem_size);
 
     list_val->num_values--;
     list_val->extra_space++;
@@ -1162,18 +1335,19 @@ void lily_list_shift(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 
 void lily_list_unshift(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 {
-    lily_value **vm_regs = vm->vm_regs;
-    lily_list_val *list_val = vm_regs[code[1]]->value.list;
-    lily_value *input_reg = vm_regs[code[2]];
+    lily_value *vm_regs = vm->vm_regs;
+    lily_list_val *list_val = vm_regs[code[1]].value.list;
+    lily_value *input_reg = &vm_regs[code[2]];
 
-    if (list_val->extra_space == 0)
-        make_extra_space_in_list(list_val);
+    prepare_list_for(list_val, input_reg);
+
+    size_t elem_size = LIST_ELEM_SIZE(list_val);
+    char *elems = (char *)list_val->elems;
 
     if (list_val->num_values != 0)
-        memmove(list_val->elems + 1, list_val->elems,
-                list_val->num_values * sizeof(lily_value *));
+        memmove(elems + elem_size, elems, list_val->num_values * elem_size);
 
-    list_val->elems[0] = lily_copy_value(input_reg);
+    lily_list_init_elem(list_val, 0, input_reg);
 
     list_val->num_values++;
     list_val->extra_space--;
@@ -1181,21 +1355,107 @@ void lily_list_unshift(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 
 void lily_list_fold(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 {
-    lily_value **vm_regs = vm->vm_regs;
-    lily_value *result_reg = vm->vm_regs[code[0]];
-    lily_list_val *list_val = vm_regs[code[1]]->value.list;
-    lily_value *starting_reg = vm_regs[code[2]];
-    lily_value *function_reg = vm_regs[code[3]];
-    lily_value *current = starting_reg;
-    int cached = 0;
+    lily_value *vm_regs = vm->vm_regs;
+    lily_list_val *list_val = vm_regs[code[1]].value.list;
+    lily_value scratch;
+    lily_prepared_call call;
+
+    lily_prepare_call(vm, &call, &vm_regs[code[3]], 2, 1);
+
+    /* The first argument holds the running value between calls. */
+    lily_assign_value(lily_prepared_arg(vm, &call, 0), &vm->vm_regs[code[2]]);
 
     int i;
     for (i = 0;i < list_val->num_values;i++) {
-        current = lily_foreign_call(vm, &cached, 1, function_reg, 2, current,
-                list_val->elems[i]);
+        lily_assign_value(lily_prepared_arg(vm, &call, 1),
+                lily_list_get_elem(list_val, i, &scratch));
+        lily_value *result = lily_call_prepared(vm, &call);
+        lily_assign_value(lily_prepared_arg(vm, &call, 0), result);
+    }
+
+    lily_assign_value(&vm->vm_regs[code[0]], lily_prepared_arg(vm, &call, 0));
+}
+
+/* Set 'result_reg' to Some(value) if 'found' is set, or None otherwise. */
+static void move_integer_option(lily_vm_state *vm, lily_value *result_reg,
+        int found, int64_t value)
+{
+    if (found) {
+        lily_value *v = lily_new_empty_value();
+        lily_move_integer(v, value);
+        lily_move_enum_f(MOVE_DEREF_NO_GC, result_reg, lily_new_some(v));
     }
+    else
+        lily_move_enum_f(MOVE_SHARED_SPECULATIVE, result_reg,
+                lily_get_none(vm));
+}
+
+/* The methods below do a whole pass over a List in one call, instead of
+   calling back into the vm for each element. A List[Integer] that has values
+   is always packed, so they can hand the raw elements to the list kernels. */
+
+void lily_list_sum(lily_vm_state *vm, uint16_t argc, uint16_t *code)
+{
+    lily_value *vm_regs = vm->vm_regs;
+    lily_list_val *list_val = vm_regs[code[1]].value.list;
+
+    lily_move_integer(&vm_regs[code[0]],
+            lily_kernel_sum_int(list_val->raw_elems, list_val->num_values));
+}
+
+void lily_list_min(lily_vm_state *vm, uint16_t argc, uint16_t *code)
+{
+    lily_value *vm_regs = vm->vm_regs;
+    lily_list_val *list_val = vm_regs[code[1]].value.list;
+    int64_t result = 0;
+
+    if (list_val->num_values)
+        result = lily_kernel_min_int(list_val->raw_elems,
+                list_val->num_values);
 
-    lily_assign_value(result_reg, current);
+    move_integer_option(vm, &vm_regs[code[0]], list_val->num_values != 0,
+            result);
+}
+
+void lily_list_max(lily_vm_state *vm, uint16_t argc, uint16_t *code)
+{
+    lily_value *vm_regs = vm->vm_regs;
+    lily_list_val *list_val = vm_regs[code[1]].value.list;
+    int64_t result = 0;
+
+    if (list_val->num_values)
+        result = lily_kernel_max_int(list_val->raw_elems,
+                list_val->num_values);
+
+    move_integer_option(vm, &vm_regs[code[0]], list_val->num_values != 0,
+            result);
+}
+
+void lily_list_index_of(lily_vm_state *vm, uint16_t argc, uint16_t *code)
+{
+    lily_value *vm_regs = vm->vm_regs;
+    lily_list_val *list_val = vm_regs[code[1]].value.list;
+    lily_value *find_reg = &vm_regs[code[2]];
+    uint32_t count = list_val->num_values;
+    int64_t result = -1;
+
+    if (list_val->packed_flags & VAL_IS_DOUBLE)
+        result = lily_kernel_find_double(list_val->raw_elems, count,
+                find_reg->value.doubleval);
+    else if (list_val->packed_flags)
+        result = lily_kernel_find_int(list_val->raw_elems, count,
+                find_reg->value.integer);
+    else {
+        uint32_t i;
+        for (i = 0;i < count;i++) {
+            if (lily_eq_value(vm, &list_val->elems[i], find_reg)) {
+                result = i;
+                break;
+            }
+        }
+    }
+
+    move_integer_option(vm, &vm_regs[code[0]], result != -1, result);
 }
 
 /***
@@ -1209,10 +1469,10 @@ void lily_list_fold(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 
 void lily_option_and(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 {
-    lily_value **vm_regs = vm->vm_regs;
-    lily_value *opt_reg = vm_regs[code[1]];
-    lily_value *and_reg = vm_regs[code[2]];
-    lily_value *result_reg = vm_regs[code[0]];
+    lily_value *vm_regs = vm->vm_regs;
+    lily_value *opt_reg = &vm_regs[code[1]];
+    lily_value *and_reg = &vm_regs[code[2]];
+    lily_value *result_reg = &vm_regs[code[0]];
     lily_value *source;
 
     if (opt_reg->value.instance->variant_id == SOME_VARIANT_ID)
@@ -1225,56 +1485,55 @@ void lily_option_and(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 
 void lily_option_and_then(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 {
-    lily_value **vm_regs = vm->vm_regs;
-    lily_value *opt_reg = vm_regs[code[1]];
-    lily_value *function_reg = vm_regs[code[2]];
-    lily_value *result_reg = vm_regs[code[0]];
+    lily_value *vm_regs = vm->vm_regs;
+    lily_value *opt_reg = &vm_regs[code[1]];
+    lily_value *function_reg = &vm_regs[code[2]];
     lily_instance_val *optval = opt_reg->value.instance;
     lily_value *source;
     int cached = 0;
 
     if (optval->variant_id == SOME_VARIANT_ID) {
         lily_value *output = lily_foreign_call(vm, &cached, 1,
-                function_reg, 1, optval->values[0]);
+                function_reg, 1, &optval->values[0]);
 
         source = output;
     }
     else
         source = opt_reg;
 
-    lily_assign_value(result_reg, source);
+    lily_assign_value(&vm->vm_regs[code[0]], source);
 }
 
 static void option_is_some_or_none(lily_vm_state *vm, uint16_t argc,
         uint16_t *code, int num_expected)
 {
-    lily_value **vm_regs = vm->vm_regs;
-    lily_instance_val *optval = vm_regs[code[1]]->value.instance;
-    lily_value *result_reg = vm_regs[code[0]];
+    lily_value *vm_regs = vm->vm_regs;
+    lily_instance_val *optval = vm_regs[code[1]].value.instance;
+    lily_value *result_reg = &vm_regs[code[0]];
 
     lily_move_boolean(result_reg, (optval->num_values == num_expected));
 }
 
 void lily_option_map(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 {
-    lily_value **vm_regs = vm->vm_regs;
-    lily_value *opt_reg = vm_regs[code[1]];
-    lily_value *function_reg = vm_regs[code[2]];
-    lily_value *result_reg = vm_regs[code[0]];
+    lily_value *vm_regs = vm->vm_regs;
+    lily_value *opt_reg = &vm_regs[code[1]];
+    lily_value *function_reg = &vm_regs[code[2]];
     lily_instance_val *optval = opt_reg->value.instance;
     lily_instance_val *source;
     int cached = 0;
 
     if (optval->variant_id == SOME_VARIANT_ID) {
         lily_value *output = lily_foreign_call(vm, &cached, 1,
-                function_reg, 1, optval->values[0]);
+                function_reg, 1, &optval->values[0]);
 
         source = lily_new_some(lily_copy_value(output));
-        lily_move_enum_f(MOVE_DEREF_SPECULATIVE, result_reg, source);
+        lily_move_enum_f(MOVE_DEREF_SPECULATIVE, &vm->vm_regs[code[0]],
+                source);
     }
     else {
         source = lily_get_none(vm);
-        lily_move_enum_f(MOVE_SHARED_SPECULATIVE, result_reg, source);
+        lily_move_enum_f(MOVE_SHARED_SPECULATIVE, &vm_regs[code[0]], source);
     }
 }
 
@@ -1290,10 +1549,10 @@ void lily_option_is_none(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 
 void lily_option_or(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 {
-    lily_value **vm_regs = vm->vm_regs;
-    lily_value *opt_reg = vm_regs[code[1]];
-    lily_value *or_reg = vm_regs[code[2]];
-    lily_value *result_reg = vm_regs[code[0]];
+    lily_value *vm_regs = vm->vm_regs;
+    lily_value *opt_reg = &vm_regs[code[1]];
+    lily_value *or_reg = &vm_regs[code[2]];
+    lily_value *result_reg = &vm_regs[code[0]];
     lily_value *source;
 
     if (opt_reg->value.instance->variant_id == SOME_VARIANT_ID)
@@ -1306,28 +1565,28 @@ void lily_option_or(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 
 void lily_option_unwrap(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 {
-    lily_value **vm_regs = vm->vm_regs;
-    lily_value *opt_reg = vm_regs[code[1]];
+    lily_value *vm_regs = vm->vm_regs;
+    lily_value *opt_reg = &vm_regs[code[1]];
     lily_instance_val *optval = opt_reg->value.instance;
-    lily_value *result_reg = vm_regs[code[0]];
+    lily_value *result_reg = &vm_regs[code[0]];
 
     if (optval->variant_id == SOME_VARIANT_ID)
-        lily_assign_value(result_reg, opt_reg->value.instance->values[0]);
+        lily_assign_value(result_reg, &opt_reg->value.instance->values[0]);
     else
         lily_vm_raise(vm, SYM_CLASS_VALUEERROR, "unwrap called on None.\n");
 }
 
 void lily_option_unwrap_or(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 {
-    lily_value **vm_regs = vm->vm_regs;
-    lily_value *opt_reg = vm_regs[code[1]];
-    lily_value *fallback_reg = vm_regs[code[2]];
+    lily_value *vm_regs = vm->vm_regs;
+    lily_value *opt_reg = &vm_regs[code[1]];
+    lily_value *fallback_reg = &vm_regs[code[2]];
     lily_instance_val *optval = opt_reg->value.instance;
-    lily_value *result_reg = vm_regs[code[0]];
+    lily_value *result_reg = &vm_regs[code[0]];
     lily_value *source;
 
     if (optval->variant_id == SOME_VARIANT_ID)
-        source = opt_reg->value.instance->values[0];
+        source = &opt_reg->value.instance->values[0];
     else
         source = fallback_reg;
 
@@ -1336,10 +1595,9 @@ void lily_option_unwrap_or(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 
 void lily_option_or_else(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 {
-    lily_value **vm_regs = vm->vm_regs;
-    lily_value *opt_reg = vm_regs[code[1]];
-    lily_value *function_reg = vm_regs[code[2]];
-    lily_value *result_reg = vm_regs[code[0]];
+    lily_value *vm_regs = vm->vm_regs;
+    lily_value *opt_reg = &vm_regs[code[1]];
+    lily_value *function_reg = &vm_regs[code[2]];
     lily_instance_val *optval = opt_reg->value.instance;
     lily_value *source;
     int cached = 0;
@@ -1349,25 +1607,24 @@ void lily_option_or_else(lily_vm_state *vm, uint16_t argc, uint16_t *code)
     else
         source = lily_foreign_call(vm, &cached, 1, function_reg, 0);
 
-    lily_assign_value(result_reg, source);
+    lily_assign_value(&vm->vm_regs[code[0]], source);
 }
 
 void lily_option_unwrap_or_else(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 {
-    lily_value **vm_regs = vm->vm_regs;
-    lily_value *opt_reg = vm_regs[code[1]];
-    lily_value *function_reg = vm_regs[code[2]];
-    lily_value *result_reg = vm_regs[code[0]];
+    lily_value *vm_regs = vm->vm_regs;
+    lily_value *opt_reg = &vm_regs[code[1]];
+    lily_value *function_reg = &vm_regs[code[2]];
     lily_instance_val *optval = opt_reg->value.instance;
     lily_value *source;
     int cached = 0;
 
     if (optval->variant_id == SOME_VARIANT_ID)
-        source = opt_reg->value.instance->values[0];
+        source = &opt_reg->value.instance->values[0];
     else
         source = lily_foreign_call(vm, &cached, 1, function_reg, 0);
 
-    lily_assign_value(result_reg, source);
+    lily_assign_value(&vm->vm_regs[code[0]], source);
 }
 
 /***
@@ -1381,22 +1638,15 @@ void lily_option_unwrap_or_else(lily_vm_state *vm, uint16_t argc, uint16_t *code
 
 static lily_string_val *make_sv(lily_vm_state *vm, int size)
 {
-    lily_string_val *new_sv = lily_malloc(sizeof(lily_string_val));
-    char *new_string = lily_malloc(sizeof(char) * size);
-
-    new_sv->string = new_string;
-    new_sv->size = size - 1;
-    new_sv->refcount = 1;
-
-    return new_sv;
+    return lily_new_raw_string_blank(size - 1);
 }
 
 #define CTYPE_WRAP(WRAP_NAME, WRAPPED_CALL) \
 void WRAP_NAME(lily_vm_state *vm, uint16_t argc, uint16_t *code) \
 { \
-    lily_value **vm_regs = vm->vm_regs; \
-    lily_value *ret_arg = vm_regs[code[0]]; \
-    lily_value *input_arg = vm_regs[code[1]]; \
+    lily_value *vm_regs = vm->vm_regs; \
+    lily_value *ret_arg = &vm_regs[code[0]]; \
+    lily_value *input_arg = &vm_regs[code[1]]; \
 \
     if (input_arg->value.string->size == 0) { \
         lily_move_integer(ret_arg, 0); \
@@ -1446,10 +1696,10 @@ static const char follower_table[256] =
 
 void lily_string_ends_with(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 {
-    lily_value **vm_regs = vm->vm_regs;
-    lily_value *input_arg = vm_regs[code[1]];
-    lily_value *suffix_arg = vm_regs[code[2]];
-    lily_value *result_arg = vm_regs[code[0]];
+    lily_value *vm_regs = vm->vm_regs;
+    lily_value *input_arg = &vm_regs[code[1]];
+    lily_value *suffix_arg = &vm_regs[code[2]];
+    lily_value *result_arg = &vm_regs[code[0]];
 
     char *input_raw_str = input_arg->value.string->string;
     char *suffix_raw_str = suffix_arg->value.string->string;
@@ -1476,10 +1726,10 @@ void lily_string_ends_with(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 
 void lily_string_find(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 {
-    lily_value **vm_regs = vm->vm_regs;
-    lily_value *input_arg = vm_regs[code[1]];
-    lily_value *find_arg = vm_regs[code[2]];
-    lily_value *result_arg = vm_regs[code[0]];
+    lily_value *vm_regs = vm->vm_regs;
+    lily_value *input_arg = &vm_regs[code[1]];
+    lily_value *find_arg = &vm_regs[code[2]];
+    lily_value *result_arg = &vm_regs[code[0]];
 
     char *input_str = input_arg->value.string->string;
     int input_length = input_arg->value.string->size;
@@ -1580,9 +1830,9 @@ int lily_maybe_html_encode_to_buffer(lily_vm_state *vm, lily_value *input)
 
 void lily_string_html_encode(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 {
-    lily_value **vm_regs = vm->vm_regs;
-    lily_value *input_arg = vm_regs[code[1]];
-    lily_value *result_arg = vm_regs[code[0]];
+    lily_value *vm_regs = vm->vm_regs;
+    lily_value *input_arg = &vm_regs[code[1]];
+    lily_value *result_arg = &vm_regs[code[0]];
 
     /* If nothing was escaped, output what was input. */
     if (lily_maybe_html_encode_to_buffer(vm, input_arg) == 0)
@@ -1677,16 +1927,17 @@ static int lstrip_utf8_start(lily_value *input_arg, lily_string_val *strip_sv)
 }
 
 /* This is a helper for lstrip wherein input_arg does not have utf-8. */
-static int lstrip_ascii_start(lily_value *input_arg, lily_string_val *strip_sv)
+static int lstrip_ascii_start(lily_value *input_arg, const char *strip_str,
+        int strip_length)
 {
     int i;
     char *input_str = input_arg->value.string->string;
     int input_length = input_arg->value.string->size;
 
-    if (strip_sv->size == 1) {
+    if (strip_length == 1) {
         /* Strip a single byte really fast. The easiest case. */
         char strip_ch;
-        strip_ch = strip_sv->string[0];
+        strip_ch = strip_str[0];
         for (i = 0;i < input_length;i++) {
             if (input_str[i] != strip_ch)
                 break;
@@ -1694,8 +1945,6 @@ static int lstrip_ascii_start(lily_value *input_arg, lily_string_val *strip_sv)
     }
     else {
         /* Strip one of many ascii bytes. A bit tougher, but not much. */
-        char *strip_str = strip_sv->string;
-        int strip_length = strip_sv->size;
         for (i = 0;i < input_length;i++) {
             char ch = input_str[i];
             int found = 0;
@@ -1716,10 +1965,10 @@ static int lstrip_ascii_start(lily_value *input_arg, lily_string_val *strip_sv)
 
 void lily_string_lstrip(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 {
-    lily_value **vm_regs = vm->vm_regs;
-    lily_value *input_arg = vm_regs[code[1]];
-    lily_value *strip_arg = vm_regs[code[2]];
-    lily_value *result_arg = vm_regs[code[0]];
+    lily_value *vm_regs = vm->vm_regs;
+    lily_value *input_arg = &vm_regs[code[1]];
+    lily_value *strip_arg = &vm_regs[code[2]];
+    lily_value *result_arg = &vm_regs[code[0]];
 
     char *strip_str;
     unsigned char ch;
@@ -1747,7 +1996,8 @@ void lily_string_lstrip(lily_vm_state *vm, uint16_t argc, uint16_t *code)
     }
 
     if (has_multibyte_char == 0)
-        copy_from = lstrip_ascii_start(input_arg, strip_sv);
+        copy_from = lstrip_ascii_start(input_arg, strip_sv->string,
+                strip_sv->size);
     else
         copy_from = lstrip_utf8_start(input_arg, strip_sv);
 
@@ -1761,9 +2011,9 @@ void lily_string_lstrip(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 
 void lily_string_lower(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 {
-    lily_value **vm_regs = vm->vm_regs;
-    lily_value *input_arg = vm_regs[code[1]];
-    lily_value *result_arg = vm_regs[code[0]];
+    lily_value *vm_regs = vm->vm_regs;
+    lily_value *input_arg = &vm_regs[code[1]];
+    lily_value *result_arg = &vm_regs[code[0]];
 
     int new_size = input_arg->value.string->size + 1;
     lily_string_val *new_sv = make_sv(vm, new_size);
@@ -1787,9 +2037,9 @@ void lily_string_lower(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 
 void lily_string_parse_i(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 {
-    lily_value **vm_regs = vm->vm_regs;
-    lily_value *result_reg = vm_regs[code[0]];
-    char *input = vm_regs[code[1]]->value.string->string;
+    lily_value *vm_regs = vm->vm_regs;
+    lily_value *result_reg = &vm_regs[code[0]];
+    char *input = vm_regs[code[1]].value.string->string;
     uint64_t value = 0;
     int is_negative = 0;
     unsigned int rounds = 0;
@@ -1839,22 +2089,21 @@ void lily_string_parse_i(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 }
 
 /* This is a helper for rstrip when there's no utf-8 in input_arg. */
-static int rstrip_ascii_stop(lily_value *input_arg, lily_string_val *strip_sv)
+static int rstrip_ascii_stop(lily_value *input_arg, const char *strip_str,
+        int strip_length)
 {
     int i;
     char *input_str = input_arg->value.string->string;
     int input_length = input_arg->value.string->size;
 
-    if (strip_sv->size == 1) {
-        char strip_ch = strip_sv->string[0];
+    if (strip_length == 1) {
+        char strip_ch = strip_str[0];
         for (i = input_length - 1;i >= 0;i--) {
             if (input_str[i] != strip_ch)
                 break;
         }
     }
     else {
-        char *strip_str = strip_sv->string;
-        int strip_length = strip_sv->size;
         for (i = input_length - 1;i >= 0;i--) {
             char ch = input_str[i];
             int found = 0;
@@ -1930,10 +2179,10 @@ static int rstrip_utf8_stop(lily_value *input_arg, lily_string_val *strip_sv)
 
 void lily_string_rstrip(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 {
-    lily_value **vm_regs = vm->vm_regs;
-    lily_value *input_arg = vm_regs[code[1]];
-    lily_value *strip_arg = vm_regs[code[2]];
-    lily_value *result_arg = vm_regs[code[0]];
+    lily_value *vm_regs = vm->vm_regs;
+    lily_value *input_arg = &vm_regs[code[1]];
+    lily_value *strip_arg = &vm_regs[code[2]];
+    lily_value *result_arg = &vm_regs[code[0]];
 
     char *strip_str;
     unsigned char ch;
@@ -1961,7 +2210,8 @@ void lily_string_rstrip(lily_vm_state *vm, uint16_t argc, uint16_t *code)
     }
 
     if (has_multibyte_char == 0)
-        copy_to = rstrip_ascii_stop(input_arg, strip_sv);
+        copy_to = rstrip_ascii_stop(input_arg, strip_sv->string,
+                strip_sv->size);
     else
         copy_to = rstrip_utf8_stop(input_arg, strip_sv);
 
@@ -1977,10 +2227,10 @@ void lily_string_rstrip(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 
 void lily_string_starts_with(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 {
-    lily_value **vm_regs = vm->vm_regs;
-    lily_value *input_arg = vm_regs[code[1]];
-    lily_value *prefix_arg = vm_regs[code[2]];
-    lily_value *result_arg = vm_regs[code[0]];
+    lily_value *vm_regs = vm->vm_regs;
+    lily_value *input_arg = &vm_regs[code[1]];
+    lily_value *prefix_arg = &vm_regs[code[2]];
+    lily_value *result_arg = &vm_regs[code[0]];
 
     char *input_raw_str = input_arg->value.string->string;
     char *prefix_raw_str = prefix_arg->value.string->string;
@@ -2004,10 +2254,10 @@ void lily_string_starts_with(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 
 void lily_string_strip(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 {
-    lily_value **vm_regs = vm->vm_regs;
-    lily_value *input_arg = vm_regs[code[1]];
-    lily_value *strip_arg = vm_regs[code[2]];
-    lily_value *result_arg = vm_regs[code[0]];
+    lily_value *vm_regs = vm->vm_regs;
+    lily_value *input_arg = &vm_regs[code[1]];
+    lily_value *strip_arg = &vm_regs[code[2]];
+    lily_value *result_arg = &vm_regs[code[0]];
 
     /* Either there is nothing to strip (1st), or stripping nothing (2nd). */
     if (input_arg->value.string->size == 0 ||
@@ -2032,13 +2282,15 @@ void lily_string_strip(lily_vm_state *vm, uint16_t argc, uint16_t *code)
     }
 
     if (has_multibyte_char == 0)
-        copy_from = lstrip_ascii_start(input_arg, strip_sv);
+        copy_from = lstrip_ascii_start(input_arg, strip_sv->string,
+                strip_sv->size);
     else
         copy_from = lstrip_utf8_start(input_arg, strip_sv);
 
     if (copy_from != input_arg->value.string->size) {
         if (has_multibyte_char)
-            copy_to = rstrip_ascii_stop(input_arg, strip_sv);
+            copy_to = rstrip_ascii_stop(input_arg, strip_sv->string,
+                    strip_sv->size);
         else
             copy_to = rstrip_utf8_stop(input_arg, strip_sv);
     }
@@ -2084,7 +2336,7 @@ static void string_split_by_val(lily_vm_state *vm, char *input, char *splitby,
     char *input_ch = &input[0];
     char *splitby_ch = &splitby[0];
     int values_needed = 0;
-    lily_value **elems;
+    lily_value *elems;
 
     while (move_table[(unsigned char)*input_ch] != 0) {
         if (*input_ch == *splitby_ch) {
@@ -2112,7 +2364,7 @@ static void string_split_by_val(lily_vm_state *vm, char *input, char *splitby,
 
     values_needed++;
     input_ch = &input[0];
-    elems = lily_malloc(sizeof(lily_value *) * values_needed);
+    elems = lily_malloc(sizeof(lily_value) * values_needed);
     int i = 0;
     char *last_start = input_ch;
 
@@ -2142,7 +2394,9 @@ static void string_split_by_val(lily_vm_state *vm, char *input, char *splitby,
         if (is_match || *input_ch == '\0') {
             int sv_size = match_start - last_start;
 
-            elems[i] = lily_new_string_ncpy(last_start, sv_size);
+            elems[i].flags = 0;
+            lily_move_string(&elems[i],
+                    lily_new_raw_string_sized(last_start, sv_size));
             i++;
             if (*input_ch == '\0')
                 break;
@@ -2161,46 +2415,38 @@ static void string_split_by_val(lily_vm_state *vm, char *input, char *splitby,
 
 void lily_string_split(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 {
-    lily_value **vm_regs = vm->vm_regs;
-    lily_string_val *input_strval = vm_regs[code[1]]->value.string;
-    lily_string_val *split_strval;
+    lily_value *vm_regs = vm->vm_regs;
+    lily_string_val *input_strval = vm_regs[code[1]].value.string;
+    char *split_str = " ";
     if (argc == 2)
-        split_strval = vm_regs[code[2]]->value.string;
-    else {
-        lily_string_val fake_sv;
-        fake_sv.string = " ";
-        fake_sv.size = 1;
-        split_strval = &fake_sv;
-    }
+        split_str = vm_regs[code[2]].value.string->string;
 
-    lily_value *result_reg = vm_regs[code[0]];
+    lily_value *result_reg = &vm_regs[code[0]];
 
-    if (split_strval->size == 0)
+    if (split_str[0] == '\0')
         lily_vm_raise(vm, SYM_CLASS_VALUEERROR, "Cannot split by empty string.\n");
 
     lily_list_val *lv = lily_new_list_val();
 
-    string_split_by_val(vm, input_strval->string, split_strval->string, lv);
+    string_split_by_val(vm, input_strval->string, split_str, lv);
 
     lily_move_list_f(MOVE_DEREF_NO_GC, result_reg, lv);
 }
 
 void lily_string_trim(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 {
-    lily_value **vm_regs = vm->vm_regs;
-    lily_value *input_arg = vm_regs[code[1]];
-    lily_value *result_arg = vm_regs[code[0]];
+    lily_value *vm_regs = vm->vm_regs;
+    lily_value *input_arg = &vm_regs[code[1]];
+    lily_value *result_arg = &vm_regs[code[0]];
 
-    char fake_buffer[5] = " \t\r\n";
-    lily_string_val fake_sv;
-    fake_sv.string = fake_buffer;
-    fake_sv.size = strlen(fake_buffer);
+    const char *trim_str = " \t\r\n";
+    int trim_length = strlen(trim_str);
 
-    int copy_from = lstrip_ascii_start(input_arg, &fake_sv);
+    int copy_from = lstrip_ascii_start(input_arg, trim_str, trim_length);
     lily_string_val *new_sv;
 
     if (copy_from != input_arg->value.string->size) {
-        int copy_to = rstrip_ascii_stop(input_arg, &fake_sv);
+        int copy_to = rstrip_ascii_stop(input_arg, trim_str, trim_length);
         int new_size = (copy_to - copy_from) + 1;
         new_sv = make_sv(vm, new_size);
         char *new_str = new_sv->string;
@@ -2219,9 +2465,9 @@ void lily_string_trim(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 
 void lily_string_upper(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 {
-    lily_value **vm_regs = vm->vm_regs;
-    lily_value *input_arg = vm_regs[code[1]];
-    lily_value *result_arg = vm_regs[code[0]];
+    lily_value *vm_regs = vm->vm_regs;
+    lily_value *input_arg = &vm_regs[code[1]];
+    lily_value *result_arg = &vm_regs[code[0]];
 
     int new_size = input_arg->value.string->size + 1;
     lily_string_val *new_sv = make_sv(vm, new_size);
@@ -2299,16 +2545,15 @@ void lily_string_subscript(lily_vm_state *vm, lily_value *input_reg,
 
 void lily_tainted_sanitize(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 {
-    lily_value **vm_regs = vm->vm_regs;
-    lily_instance_val *iv = vm_regs[code[1]]->value.instance;
-    lily_value *function_reg = vm_regs[code[2]];
-    lily_value *result_reg = vm_regs[code[0]];
+    lily_value *vm_regs = vm->vm_regs;
+    lily_instance_val *iv = vm_regs[code[1]].value.instance;
+    lily_value *function_reg = &vm_regs[code[2]];
     int cached = 0;
 
     lily_value *v = lily_foreign_call(vm, &cached, 1, function_reg, 1,
-            iv->values[0]);
+            &iv->values[0]);
 
-    lily_assign_value(result_reg, v);
+    lily_assign_value(&vm->vm_regs[code[0]], v);
 }
 
 /***
@@ -2322,43 +2567,43 @@ void lily_tainted_sanitize(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 
 void lily_tuple_merge(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 {
-    lily_value **vm_regs = vm->vm_regs;
-    lily_list_val *left_tuple = vm_regs[code[1]]->value.list;
-    lily_list_val *right_tuple = vm_regs[code[2]]->value.list;
-    lily_value *result_reg = vm_regs[code[0]];
+    lily_value *vm_regs = vm->vm_regs;
+    lily_list_val *left_tuple = vm_regs[code[1]].value.list;
+    lily_list_val *right_tuple = vm_regs[code[2]].value.list;
+    lily_value *result_reg = &vm_regs[code[0]];
 
     lily_list_val *lv = lily_new_list_val();
     int new_count = left_tuple->num_values + right_tuple->num_values;
-    lv->elems = lily_malloc(sizeof(lily_value *) * new_count);
+    lv->elems = lily_malloc(sizeof(lily_value) * new_count);
     lv->num_values = new_count;
 
     int i, j;
     for (i = 0, j = 0;i < left_tuple->num_values;i++, j++)
-        lv->elems[j] = lily_copy_value(left_tuple->elems[i]);
+        lily_init_value(&lv->elems[j], &left_tuple->elems[i]);
 
     for (i = 0;i < right_tuple->num_values;i++, j++)
-        lv->elems[j] = lily_copy_value(right_tuple->elems[i]);
+        lily_init_value(&lv->elems[j], &right_tuple->elems[i]);
 
     lily_move_tuple_f(MOVE_DEREF_SPECULATIVE, result_reg, lv);
 }
 
 void lily_tuple_push(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 {
-    lily_value **vm_regs = vm->vm_regs;
-    lily_list_val *left_tuple = vm_regs[code[1]]->value.list;
-    lily_value *right = vm_regs[code[2]];
-    lily_value *result_reg = vm_regs[code[0]];
+    lily_value *vm_regs = vm->vm_regs;
+    lily_list_val *left_tuple = vm_regs[code[1]].value.list;
+    lily_value *right = &vm_regs[code[2]];
+    lily_value *result_reg = &vm_regs[code[0]];
 
     lily_list_val *lv = lily_new_list_val();
     int new_count = left_tuple->num_values + 1;
-    lv->elems = lily_malloc(sizeof(lily_value *) * new_count);
+    lv->elems = lily_malloc(sizeof(lily_value) * new_count);
     lv->num_values = new_count;
 
     int i, j;
     for (i = 0, j = 0;i < left_tuple->num_values;i++, j++)
-        lv->elems[j] = lily_copy_value(left_tuple->elems[i]);
+        lily_init_value(&lv->elems[j], &left_tuple->elems[i]);
 
-    lv->elems[j] = lily_copy_value(right);
+    lily_init_value(&lv->elems[j], right);
 
     lily_move_tuple_f(MOVE_DEREF_SPECULATIVE, result_reg, lv);
 }
@@ -2389,13 +2634,13 @@ static lily_value *new_builtin_file(FILE *source, const char *mode)
 #define BOOLEAN_OFFSET    26
 #define DYNAMIC_OFFSET    30
 #define LIST_OFFSET       32
-#define HASH_OFFSET       50
-#define TUPLE_OFFSET      62
-#define FILE_OFFSET       65
-#define OPTION_OFFSET     73
-#define EITHER_OFFSET     86
-#define TAINTED_OFFSET   101
-#define MISC_OFFSET      102
+#define HASH_OFFSET       54
+#define TUPLE_OFFSET      66
+#define FILE_OFFSET       69
+#define OPTION_OFFSET     77
+#define EITHER_OFFSET     90
+#define TAINTED_OFFSET   105
+#define MISC_OFFSET      106
 
 extern void lily_builtin_calltrace(lily_vm_state *, uint16_t, uint16_t *);
 extern void lily_builtin_print(lily_vm_state *, uint16_t, uint16_t *);
@@ -2439,16 +2684,20 @@ void *lily_builtin_loader(lily_options *options, uint16_t *cid_table, int id)
         case LIST_OFFSET +  4: return lily_list_each_index;
         case LIST_OFFSET +  5: return lily_list_fill;
         case LIST_OFFSET +  6: return lily_list_fold;
-        case LIST_OFFSET +  7: return lily_list_insert;
-        case LIST_OFFSET +  8: return lily_list_join;
-        case LIST_OFFSET +  9: return lily_list_map;
-        case LIST_OFFSET + 10: return lily_list_pop;
-        case LIST_OFFSET + 11: return lily_list_push;
-        case LIST_OFFSET + 12: return lily_list_reject;
-        case LIST_OFFSET + 13: return lily_list_select;
-        case LIST_OFFSET + 14: return lily_list_size;
-        case LIST_OFFSET + 15: return lily_list_shift;
-        case LIST_OFFSET + 16: return lily_list_unshift;
+        case LIST_OFFSET +  7: return lily_list_index_of;
+        case LIST_OFFSET +  8: return lily_list_insert;
+        case LIST_OFFSET +  9: return lily_list_join;
+        case LIST_OFFSET + 10: return lily_list_map;
+        case LIST_OFFSET + 11: return lily_list_max;
+        case LIST_OFFSET + 12: return lily_list_min;
+        case LIST_OFFSET + 13: return lily_list_pop;
+        case LIST_OFFSET + 14: return lily_list_push;
+        case LIST_OFFSET + 15: return lily_list_reject;
+        case LIST_OFFSET + 16: return lily_list_select;
+        case LIST_OFFSET + 17: return lily_list_size;
+        case LIST_OFFSET + 18: return lily_list_shift;
+        case LIST_OFFSET + 19: return lily_list_sum;
+        case LIST_OFFSET + 20: return lily_list_unshift;
 
         case HASH_OFFSET +  0: return lily_hash_clear;
         case HASH_OFFSET +  1: return lily_hash_delete;
@@ -2539,7 +2788,7 @@ const char *dynaload_table[] =
     ,"!\001Dynamic"
     ,"m:new\0[A](A):Dynamic"
 
-    ,"!\021List"
+    ,"!\025List"
     ,"m:clear\0[A](List[A])"
     ,"m:count\0[A](List[A], Function(A => Boolean)):Integer"
     ,"m:delete_at\0[A](List[A], Integer)"
@@ -2547,15 +2796,19 @@ const char *dynaload_table[] =
     ,"m:each_index\0[A](List[A], Function(Integer)):List[A]"
     ,"m:fill\0[A](Integer, A):List[A]"
     ,"m:fold\0[A](List[A], A, Function(A, A => A)):A"
+    ,"m:index_of\0[A](List[A], A):Option[Integer]"
     ,"m:insert\0[A](List[A], Integer, A)"
     ,"m:join\0[A](List[A], *String):String"
     ,"m:map\0[A,B](List[A], Function(A => B)):List[B]"
+    ,"m:max\0(List[Integer]):Option[Integer]"
+    ,"m:min\0(List[Integer]):Option[Integer]"
     ,"m:pop\0[A](List[A]):A"
     ,"m:push\0[A](List[A], A)"
     ,"m:reject\0[A](List[A], Function(A => Boolean)):List[A]"
     ,"m:select\0[A](List[A], Function(A => Boolean)):List[A]"
     ,"m:size\0[A](List[A]):Integer"
     ,"m:shift\0[A](List[A]):A"
+    ,"m:sum\0(List[Integer]):Integer"
     ,"m:unshift\0[A](List[A], A)"
 
     ,"!\013Hash"
@@ -0,0 +1,109 @@
+#include <stdint.h>
+
+#include "lily_parser.h"
+#include "lily_vm.h"
+
+#include "lily_api_gc.h"
+#include "lily_api_hash.h"
+#include "lily_api_value_ops.h"
+
+/*  Implements gc.collect
+
+    This does a young pass, then a full sweep, no matter how many values have
+    been tagged. */
+void lily_pkg_gc_collect(lily_vm_state *vm, uint16_t argc, uint16_t *code)
+{
+    lily_vm_gc_collect(vm);
+}
+
+static void add_stat(lily_vm_state *vm, lily_hash_val *hash_val,
+        const char *name, uint64_t stat)
+{
+    lily_value *key = lily_new_string(name);
+    lily_value *value = lily_new_empty_value();
+
+    lily_move_integer(value, (int64_t)stat);
+    lily_hash_add_unique_take(hash_val,
+            lily_string_siphash(key->value.string, vm->sipkey), key, value);
+}
+
+/*  Implements gc.stats
+
+    This returns a Hash of the counters that the vm keeps about the gc. Times
+    are in microseconds. */
+void lily_pkg_gc_stats(lily_vm_state *vm, uint16_t argc, uint16_t *code)
+{
+    lily_value *result = &vm->vm_regs[code[0]];
+    lily_hash_val *hash_val = lily_new_hash_val();
+    lily_gc_stats stats;
+
+    lily_vm_get_gc_stats(vm, &stats);
+
+    add_stat(vm, hash_val, "young_collections", stats.young_collections);
+    add_stat(vm, hash_val, "full_collections", stats.full_collections);
+    add_stat(vm, hash_val, "marked", stats.marked);
+    add_stat(vm, hash_val, "swept", stats.swept);
+    add_stat(vm, hash_val, "reused", stats.reused);
+    add_stat(vm, hash_val, "pause_usec", stats.pause_usec);
+    add_stat(vm, hash_val, "max_pause_usec", stats.max_pause_usec);
+    add_stat(vm, hash_val, "young_entries", vm->gc_young_count);
+    add_stat(vm, hash_val, "old_entries", vm->gc_live_entry_count);
+
+    lily_move_hash_f(MOVE_DEREF_NO_GC, result, hash_val);
+}
+
+/*  Implements gc.threshold
+
+    This returns how many values can be tagged before a young pass. */
+void lily_pkg_gc_threshold(lily_vm_state *vm, uint16_t argc, uint16_t *code)
+{
+    lily_value *result = &vm->vm_regs[code[0]];
+
+    lily_move_integer(result, lily_vm_get_gc_threshold(vm));
+}
+
+/*  Implements gc.set_threshold
+
+    This sets how many values can be tagged before a young pass. ValueError is
+    raised if the threshold is negative or too large. */
+void lily_pkg_gc_set_threshold(lily_vm_state *vm, uint16_t argc, uint16_t *code)
+{
+    int64_t threshold = vm->vm_regs[code[1]].value.integer;
+
+    if (threshold < 0 || threshold > UINT32_MAX)
+        lily_vm_raise(vm, SYM_CLASS_VALUEERROR,
+                "Threshold must be between 0 and 4294967295.\n");
+
+    lily_vm_set_gc_threshold(vm, (uint32_t)threshold);
+}
+
+#define GC_COLLECT       1
+#define GC_STATS         2
+#define GC_THRESHOLD     3
+#define GC_SET_THRESHOLD 4
+
+void *lily_pkg_gc_loader(lily_options *options, uint16_t *cid_table, int id)
+{
+    switch (id) {
+        case GC_COLLECT:       return lily_pkg_gc_collect;
+        case GC_STATS:         return lily_pkg_gc_stats;
+        case GC_THRESHOLD:     return lily_pkg_gc_threshold;
+        case GC_SET_THRESHOLD: return lily_pkg_gc_set_threshold;
+        default:               return NULL;
+    }
+}
+
+const char *gc_table[] =
+{
+    "\000"
+    ,"F\000collect\0"
+    ,"F\000stats\0:Hash[String, Integer]"
+    ,"F\000threshold\0:Integer"
+    ,"F\000set_threshold\0(Integer)"
+    ,"Z"
+};
+
+void lily_pkg_gc_init(lily_parse_state *parser, lily_options *options)
+{
+    lily_register_package(parser, "gc", gc_table, lily_pkg_gc_loader);
+}
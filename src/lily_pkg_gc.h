@@ -0,0 +1,8 @@
+#ifndef LILY_PKG_GC_H
+# define LILY_PKG_GC_H
+
+# include "lily_parser.h"
+
+void lily_pkg_gc_init(lily_parse_state *, struct lily_options_ *);
+
+#endif
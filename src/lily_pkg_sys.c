@@ -10,14 +10,16 @@ void *lily_sys_loader(lily_options *options, uint16_t *unused, int id)
 {
     lily_value *result = lily_new_empty_value();
     lily_list_val *lv = lily_new_list_val();
-    lily_value **values = lily_malloc(options->argc * sizeof(lily_value *));
+    lily_value *values = lily_malloc(options->argc * sizeof(lily_value));
 
     lv->elems = values;
     lv->num_values = options->argc;
 
     int i;
-    for (i = 0;i < options->argc;i++)
-        values[i] = lily_new_string(options->argv[i]);
+    for (i = 0;i < options->argc;i++) {
+        values[i].flags = 0;
+        lily_move_string(&values[i], lily_new_raw_string(options->argv[i]));
+    }
 
     lily_move_list_f(MOVE_DEREF_NO_GC, result, lv);
     return result;
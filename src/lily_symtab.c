@@ -469,7 +469,7 @@ lily_foreign_tie *lily_new_foreign_tie(lily_symtab *symtab, lily_var *var,
     tie->data.cell_refcount = 0;
     tie->next = symtab->foreign_ties;
     symtab->foreign_ties = tie;
-    lily_free(v);
+    lily_free_fixed(v, sizeof(lily_value));
 
     return tie;
 }
@@ -808,10 +808,9 @@ lily_tie *make_variant_default(lily_symtab *symtab,
     /* This makes it easier to destroy, but makes no other difference. */
     lily_type *enum_self_type = variant->parent->all_subtypes;
 
-    lily_instance_val *iv = lily_new_instance_val();
+    lily_instance_val *iv = lily_new_instance_val(0);
     iv->instance_id = variant->parent->id;
     iv->variant_id = variant->variant_id;
-    iv->num_values = 0;
 
     lily_tie *ret = make_new_literal_of_type(symtab, enum_self_type);
     ret->value.instance = iv;
@@ -2,6 +2,7 @@
 
 #include "lily_vm.h"
 #include "lily_core_types.h"
+#include "lily_list_kernels.h"
 
 #include "lily_api_hash.h"
 #include "lily_api_alloc.h"
@@ -17,29 +18,35 @@
  */
 
 extern void lily_destroy_hash(lily_value *);
-extern lily_gc_entry *lily_gc_stopper;
+extern const lily_gc_entry lily_gc_stopper;
+
+/* Destroy sets a value's gc_entry to this when it has been hollowed by the gc.
+   If the value is entered again, then there is nothing left to do. */
+#define GC_STOPPER ((lily_gc_entry *)&lily_gc_stopper)
 
 static void destroy_instance(lily_value *v)
 {
     lily_instance_val *iv = v->value.instance;
+    if (iv->gc_entry == GC_STOPPER)
+        return;
 
     int full_destroy = 1;
     if (iv->gc_entry) {
         if (iv->gc_entry->last_pass == -1) {
             full_destroy = 0;
-            iv->gc_entry = lily_gc_stopper;
+            iv->gc_entry = GC_STOPPER;
         }
         else
             iv->gc_entry->value.generic = NULL;
     }
 
     int i;
-    for (i = 0;i < iv->num_values;i++) {
-        lily_deref(iv->values[i]);
-        lily_free(iv->values[i]);
-    }
+    for (i = 0;i < iv->num_values;i++)
+        lily_deref(&iv->values[i]);
 
-    lily_free(iv->values);
+    /* The values are part of the instance, so a hollowed instance can only
+       drop what they hold. The gc frees the block later. */
+    iv->num_values = 0;
 
     if (full_destroy)
         lily_free(iv);
@@ -51,27 +58,26 @@ static void destroy_list(lily_value *v)
     lily_list_val *lv = v->value.list;
 
     int i;
-    for (i = 0;i < lv->num_values;i++) {
-        lily_deref(lv->elems[i]);
-        lily_free(lv->elems[i]);
+    if (lv->packed_flags == 0) {
+        for (i = 0;i < lv->num_values;i++)
+            lily_deref(&lv->elems[i]);
     }
 
     lily_free(lv->elems);
-    lily_free(lv);
+    lily_free_fixed(lv, sizeof(lily_list_val));
 }
 
 static void destroy_string(lily_value *v)
 {
     lily_string_val *sv = v->value.string;
 
-    lily_free(sv->string);
-    lily_free(sv);
+    lily_free_fixed(sv, sizeof(lily_string_val) + sv->size + 1);
 }
 
 static void destroy_function(lily_value *v)
 {
     lily_function_val *fv = v->value.function;
-    if (fv->gc_entry == lily_gc_stopper)
+    if (fv->gc_entry == GC_STOPPER)
         return;
 
     if (fv->num_upvalues == (uint16_t)-1) {
@@ -84,7 +90,7 @@ static void destroy_function(lily_value *v)
         if (fv->gc_entry) {
             if (fv->gc_entry->last_pass == -1) {
                 full_destroy = 0;
-                fv->gc_entry = lily_gc_stopper;
+                fv->gc_entry = GC_STOPPER;
             }
             else
                 fv->gc_entry->value.generic = NULL;
@@ -101,11 +107,10 @@ static void destroy_function(lily_value *v)
 
                 if (up->cell_refcount == 0) {
                     lily_deref(up);
-                    lily_free(up);
+                    lily_free_fixed(up, sizeof(lily_value));
                 }
             }
         }
-        lily_free(upvalues);
 
         if (full_destroy)
             lily_free(fv);
@@ -115,19 +120,21 @@ static void destroy_function(lily_value *v)
 static void destroy_dynamic(lily_value *v)
 {
     lily_dynamic_val *dv = v->value.dynamic;
+    if (dv->gc_entry == GC_STOPPER)
+        return;
 
     int full_destroy = 1;
     if (dv->gc_entry) {
         if (dv->gc_entry->last_pass == -1) {
             full_destroy = 0;
-            dv->gc_entry = lily_gc_stopper;
+            dv->gc_entry = GC_STOPPER;
         }
         else
             dv->gc_entry->value.generic = NULL;
     }
 
     lily_deref(dv->inner_value);
-    lily_free(dv->inner_value);
+    lily_free_fixed(dv->inner_value, sizeof(lily_value));
 
     if (full_destroy)
         lily_free(dv);
@@ -208,43 +215,69 @@ lily_value *lily_copy_value(lily_value *input)
     if (input->flags & VAL_IS_DEREFABLE)
         input->value.generic->refcount++;
 
-    lily_value *result = lily_malloc(sizeof(lily_value));
+    lily_value *result = lily_malloc_fixed(sizeof(lily_value));
     result->flags = input->flags;
     result->value = input->value;
 
     return result;
 }
 
+/* This is lily_assign_value for when 'left' has never been set, such as a
+   fresh slot in a list. 'left' is not derefed first. */
+void lily_init_value(lily_value *left, lily_value *right)
+{
+    if (right->flags & VAL_IS_DEREFABLE)
+        right->value.generic->refcount++;
+
+    left->value = right->value;
+    left->flags = right->flags;
+}
+
 static int lily_eq_value_raw(lily_vm_state *, int *, lily_value *,
         lily_value *);
 
 /* This checks of all elements of two (lists, tuples, enums) are equivalent to
    each other. */
+static int values_eq(lily_vm_state *vm, int *depth, lily_value *left_values,
+        lily_value *right_values, uint32_t count)
+{
+    uint32_t i;
+    int ok = 1;
+
+    for (i = 0;i < count;i++) {
+        (*depth)++;
+        ok = lily_eq_value_raw(vm, depth, &left_values[i], &right_values[i]);
+        (*depth)--;
+
+        if (ok == 0)
+            break;
+    }
+
+    return ok;
+}
+
 static int subvalue_eq(lily_vm_state *vm, int *depth, lily_value *left,
         lily_value *right)
 {
     lily_list_val *left_list = left->value.list;
     lily_list_val *right_list = right->value.list;
-    int ok;
-    if (left_list->num_values == right_list->num_values) {
-        ok = 1;
-        int i;
-        for (i = 0;i < left_list->num_values;i++) {
-            lily_value *left_item = left_list->elems[i];
-            lily_value *right_item = right_list->elems[i];
-            (*depth)++;
-            if (lily_eq_value_raw(vm, depth, left_item, right_item) == 0) {
-                (*depth)--;
-                ok = 0;
-                break;
-            }
-            (*depth)--;
-        }
-    }
-    else
-        ok = 0;
+    uint32_t count = left_list->num_values;
 
-    return ok;
+    if (count != right_list->num_values)
+        return 0;
+
+    /* Lists of the same type are either both packed or both not. */
+    if (left_list->packed_flags == 0)
+        return values_eq(vm, depth, left_list->elems, right_list->elems,
+                count);
+
+    lily_raw_value *left_raw = left_list->raw_elems;
+    lily_raw_value *right_raw = right_list->raw_elems;
+
+    if (left_list->packed_flags & VAL_IS_DOUBLE)
+        return lily_kernel_eq_double(left_raw, right_raw, count);
+    else
+        return lily_kernel_eq_int(left_raw, right_raw, count);
 }
 
 /* Determine if two values are equivalent to each other. */
@@ -281,32 +314,23 @@ int lily_eq_value_raw(lily_vm_state *vm, int *depth, lily_value *left, lily_valu
         lily_hash_val *left_hash = left->value.hash;
         lily_hash_val *right_hash = right->value.hash;
 
-        lily_hash_elem *left_iter = left_hash->elem_chain;
-        lily_hash_elem *right_iter;
-        lily_hash_elem *right_start = right_hash->elem_chain;
+        lily_hash_elem *left_elems = left_hash->elems;
         /* Assume success, in case the hash is empty. */
         int ok = 1;
-        for (left_iter = left_hash->elem_chain;
-             left_iter != NULL;
-             left_iter = left_iter->next) {
+        uint32_t i;
+
+        for (i = 0;i < left_hash->elem_count;i++) {
+            lily_hash_elem *left_elem = left_elems + i;
+            if (left_elem->elem_key.flags == 0)
+                continue;
+
             (*depth)++;
-            ok = 0;
-            for (right_iter = right_start;
-                 right_iter != NULL;
-                 right_iter = right_iter->next) {
-                if (left_iter->key_siphash == right_iter->key_siphash) {
-                    ok = lily_eq_value_raw(vm, depth, left_iter->elem_key,
-                            right_iter->elem_key);
-                    ok = ok && lily_eq_value_raw(vm, depth,
-                            left_iter->elem_value, right_iter->elem_value);
-
-                    /* Hash keys are unique, so this won't be found again. */
-                    if (right_iter == right_start)
-                        right_start = right_start->next;
-
-                    break;
-                }
-            }
+            lily_hash_elem *right_elem = lily_hash_get_elem(vm, right_hash,
+                    &left_elem->elem_key);
+
+            ok = (right_elem != NULL &&
+                  lily_eq_value_raw(vm, depth, &left_elem->elem_value,
+                        &right_elem->elem_value));
             (*depth)--;
 
             if (ok == 0)
@@ -408,7 +432,7 @@ MOVE_FN_F(tuple,          lily_list_val *,     list,      VAL_IS_TUPLE)
    the flags. */
 lily_value *lily_new_empty_value(void)
 {
-    lily_value *result = lily_malloc(sizeof(lily_value));
+    lily_value *result = lily_malloc_fixed(sizeof(lily_value));
     result->flags = 0;
 
     return result;
@@ -458,6 +482,8 @@ lily_function_val *lily_new_foreign_function_val(lily_foreign_func func,
     f->trace_name = name;
     f->foreign_func = func;
     f->code = NULL;
+    f->try_table = NULL;
+    f->try_count = 0;
     /* Closures can have zero upvalues, so use -1 to mean no upvalues at all. */
     f->num_upvalues = (uint16_t) -1;
     f->upvalues = NULL;
@@ -478,6 +504,8 @@ lily_function_val *lily_new_native_function_val(char *class_name,
     f->trace_name = name;
     f->foreign_func = NULL;
     f->code = NULL;
+    f->try_table = NULL;
+    f->try_count = 0;
     /* Closures can have zero upvalues, so use -1 to mean no upvalues at all. */
     f->num_upvalues = (uint16_t)-1;
     f->upvalues = NULL;
@@ -487,27 +515,107 @@ lily_function_val *lily_new_native_function_val(char *class_name,
 }
 
 /* This clones the data inside of 'to_copy'. This is used mostly internally as a
-   prelude to closure creation. */
-lily_function_val *lily_new_function_copy(lily_function_val *to_copy)
-{
-    lily_function_val *f = malloc(sizeof(lily_function_val));
+   prelude to closure creation. The upvalues are allocated in the same block as
+   the function, so that making a closure is one allocation instead of two. */
+lily_function_val *lily_new_function_copy(lily_function_val *to_copy,
+        uint16_t count)
+{
+    lily_function_val *f = lily_malloc(sizeof(lily_function_val) +
+            (count * sizeof(lily_value *)));
+    lily_value **upvalues = (lily_value **)(f + 1);
+    int i;
 
     *f = *to_copy;
+
+    for (i = 0;i < count;i++)
+        upvalues[i] = NULL;
+
+    f->refcount = 1;
+    f->gc_entry = NULL;
+    f->num_upvalues = count;
+    f->upvalues = upvalues;
     return f;
 }
 
 
 lily_list_val *lily_new_list_val(void)
 {
-    lily_list_val *lv = lily_malloc(sizeof(lily_list_val));
+    lily_list_val *lv = lily_malloc_fixed(sizeof(lily_list_val));
     lv->refcount = 1;
     lv->elems = NULL;
     lv->num_values = -1;
     lv->extra_space = 0;
+    lv->packed_flags = 0;
+
+    return lv;
+}
+
+/* Create a new List with room for 'count' elements, and num_values set to
+   'count'. 'sample' is one of the values that will go in, and decides if the
+   List is packed. If 'sample' is NULL, then the List is not packed (Tuples are
+   made this way). The elements should be set with lily_list_init_elem. */
+lily_list_val *lily_new_list_of(uint32_t count, lily_value *sample)
+{
+    lily_list_val *lv = lily_new_list_val();
+
+    if (count && sample)
+        lily_list_pack_for(lv, sample);
+
+    lv->elems = lily_malloc(count * LIST_ELEM_SIZE(lv));
+    lv->num_values = count;
 
     return lv;
 }
 
+/* This is called before putting 'sample' into a List that is empty. If the
+   List can be packed for values like 'sample', then it becomes packed.
+   Otherwise it is unpacked. Any space that the List has is kept. */
+void lily_list_pack_for(lily_list_val *lv, lily_value *sample)
+{
+    uint32_t new_flags = sample->flags & LIST_PACKABLE_FLAGS;
+
+    if (lv->packed_flags == new_flags)
+        return;
+
+    uint32_t bytes = lv->extra_space * LIST_ELEM_SIZE(lv);
+
+    lv->packed_flags = new_flags;
+    lv->extra_space = bytes / LIST_ELEM_SIZE(lv);
+}
+
+/* Get the element at 'index' of the List. If the List is packed, then the
+   element is rebuilt into 'scratch', and 'scratch' is returned. The result
+   should be treated as a borrowed value. */
+lily_value *lily_list_get_elem(lily_list_val *lv, uint32_t index,
+        lily_value *scratch)
+{
+    if (lv->packed_flags == 0)
+        return &lv->elems[index];
+
+    scratch->flags = lv->packed_flags;
+    scratch->value = lv->raw_elems[index];
+    return scratch;
+}
+
+/* Assign 'v' to the element at 'index', which has already been set. */
+void lily_list_set_elem(lily_list_val *lv, uint32_t index, lily_value *v)
+{
+    if (lv->packed_flags == 0)
+        lily_assign_value(&lv->elems[index], v);
+    else
+        lv->raw_elems[index] = v->value;
+}
+
+/* Put 'v' into a slot at 'index' that has never been set (or was moved out
+   of). */
+void lily_list_init_elem(lily_list_val *lv, uint32_t index, lily_value *v)
+{
+    if (lv->packed_flags == 0)
+        lily_init_value(&lv->elems[index], v);
+    else
+        lv->raw_elems[index] = v->value;
+}
+
 lily_hash_val *lily_new_hash_val(void)
 {
     lily_hash_val *h = lily_malloc(sizeof(lily_hash_val));
@@ -515,52 +623,67 @@ lily_hash_val *lily_new_hash_val(void)
     h->refcount = 1;
     h->iter_count = 0;
     h->num_elems = 0;
-    h->elem_chain = NULL;
+    h->elem_count = 0;
+    h->elem_space = 0;
+    h->bucket_mask = 0;
+    h->elems = NULL;
+    h->buckets = NULL;
     return h;
 }
 
-lily_instance_val *lily_new_instance_val(void)
+/* Create a new instance that has room for 'num_values' values. The values are
+   allocated with the instance, and start out empty. The caller is expected to
+   set the instance_id (and variant_id if this is for an enum). */
+lily_instance_val *lily_new_instance_val(uint32_t num_values)
 {
-    lily_instance_val *ival = lily_malloc(sizeof(lily_instance_val));
+    lily_instance_val *ival = lily_malloc(sizeof(lily_instance_val) +
+            (num_values * sizeof(lily_value)));
+    uint32_t i;
+
     ival->refcount = 1;
     ival->gc_entry = NULL;
-    ival->values = NULL;
-    ival->num_values = -1;
+    ival->values = (lily_value *)(ival + 1);
+    ival->num_values = num_values;
+    ival->variant_id = 0;
+    ival->pad = 0;
+
+    for (i = 0;i < num_values;i++)
+        ival->values[i].flags = 0;
 
     return ival;
 }
 
-static lily_string_val *new_sv(char *buffer, int size)
+/* Create a new RAW lily_string_val that has room for 'len' bytes and a \0
+   terminator. The contents (including the terminator) are not set. Small
+   strings are the same size as other small fixed structures, so an allocator
+   that pools those will keep small strings in the pool too. */
+lily_string_val *lily_new_raw_string_blank(int len)
 {
-    lily_string_val *sv = lily_malloc(sizeof(lily_string_val));
+    lily_string_val *sv = lily_malloc_fixed(sizeof(lily_string_val) + len + 1);
     sv->refcount = 1;
-    sv->string = buffer;
-    sv->size = size;
+    sv->size = len;
+    sv->siphash = 0;
     return sv;
 }
 
 /* Create a new RAW lily_string_val. The newly-made string will hold 'size'
    bytes of 'source'. 'source' is expected to NOT be \0 terminated, and thus
    'size' SHOULD NOT include any \0 termination. Instead, the \0 termination
-   will */
+   will be added. */
 lily_string_val *lily_new_raw_string_sized(const char *source, int len)
 {
-    char *buffer = lily_malloc(len + 1);
-    memcpy(buffer, source, len);
-    buffer[len] = '\0';
+    lily_string_val *sv = lily_new_raw_string_blank(len);
+    memcpy(sv->string, source, len);
+    sv->string[len] = '\0';
 
-    return new_sv(buffer, len);
+    return sv;
 }
 
 /* Create a new RAW lily_string_val. The newly-made string shall contain a copy
    of what is inside 'source'. The source is expected to be \0 terminated. */
 lily_string_val *lily_new_raw_string(const char *source)
 {
-    int len = strlen(source);
-    char *buffer = lily_malloc(len + 1);
-    strcpy(buffer, source);
-
-    return new_sv(buffer, len);
+    return lily_new_raw_string_sized(source, strlen(source));
 }
 
 /* Create a new value holding a string. That string shall contain a copy of what
@@ -582,23 +705,24 @@ lily_value *lily_new_string_ncpy(const char *source, int len)
     return result;
 }
 
-/* Create a new value holding a string. That string's source will be exactly
-   'source'. The string made assumes that it owns 'source' from here on. The
-   source given must be \0 terminated. */
+/* Create a new value holding a string with the contents of 'source'. The source
+   given must be \0 terminated, and must come from lily_malloc. It is freed once
+   the contents have been copied over. */
 lily_value *lily_new_string_take(char *source)
 {
-    lily_value *result = lily_new_empty_value();
-    lily_move_string(result, new_sv(source, strlen(source)));
+    lily_value *result = lily_new_string(source);
+    lily_free(source);
     return result;
 }
 
 static lily_instance_val *new_enum_1(uint16_t class_id, uint16_t variant_id,
         lily_value *v)
 {
-    lily_instance_val *iv = lily_new_instance_val();
-    iv->values = lily_malloc(sizeof(lily_value));
-    iv->values[0] = v;
-    iv->num_values = 1;
+    lily_instance_val *iv = lily_new_instance_val(1);
+    /* The enum takes over the ref that 'v' holds. Only the value box is left
+       to be freed. */
+    iv->values[0] = *v;
+    lily_free_fixed(v, sizeof(lily_value));
     iv->variant_id = variant_id;
     iv->instance_id = class_id;
 
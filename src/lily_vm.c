@@ -1,5 +1,6 @@
 #include <stddef.h>
 #include <string.h>
+#include <time.h>
 
 #include "lily_opcode.h"
 #include "lily_vm.h"
@@ -13,104 +14,173 @@
 extern void lily_string_subscript(lily_vm_state *, lily_value *, lily_value *,
         lily_value *);
 extern uint64_t siphash24(const void *src, unsigned long src_sz, const char key[16]);
-extern lily_gc_entry *lily_gc_stopper;
+extern const lily_gc_entry lily_gc_stopper;
 /* This isn't included in a header file because only vm should use this. */
 void lily_destroy_value(lily_value *);
 
 #define INTEGER_OP(OP) \
-lhs_reg = vm_regs[code[code_pos + 2]]; \
-rhs_reg = vm_regs[code[code_pos + 3]]; \
-vm_regs[code[code_pos+4]]->value.integer = \
+lhs_reg = &vm_regs[code[code_pos + 2]]; \
+rhs_reg = &vm_regs[code[code_pos + 3]]; \
+vm_regs[code[code_pos+4]].value.integer = \
 lhs_reg->value.integer OP rhs_reg->value.integer; \
-vm_regs[code[code_pos+4]]->flags = VAL_IS_INTEGER; \
+vm_regs[code[code_pos+4]].flags = VAL_IS_INTEGER; \
+code_pos += 5;
+
+/* Integer add, minus, and mul wrap around. The math is done unsigned, since
+   signed overflow is undefined. The emitter folds constants the same way. */
+#define WRAPPING_OP(OP) \
+lhs_reg = &vm_regs[code[code_pos + 2]]; \
+rhs_reg = &vm_regs[code[code_pos + 3]]; \
+vm_regs[code[code_pos+4]].value.integer = \
+(int64_t)((uint64_t)lhs_reg->value.integer OP \
+          (uint64_t)rhs_reg->value.integer); \
+vm_regs[code[code_pos+4]].flags = VAL_IS_INTEGER; \
 code_pos += 5;
 
 #define INTDBL_OP(OP) \
-lhs_reg = vm_regs[code[code_pos + 2]]; \
-rhs_reg = vm_regs[code[code_pos + 3]]; \
+lhs_reg = &vm_regs[code[code_pos + 2]]; \
+rhs_reg = &vm_regs[code[code_pos + 3]]; \
 if (lhs_reg->flags & VAL_IS_DOUBLE) { \
     if (rhs_reg->flags & VAL_IS_DOUBLE) \
-        vm_regs[code[code_pos+4]]->value.doubleval = \
+        vm_regs[code[code_pos+4]].value.doubleval = \
         lhs_reg->value.doubleval OP rhs_reg->value.doubleval; \
     else \
-        vm_regs[code[code_pos+4]]->value.doubleval = \
+        vm_regs[code[code_pos+4]].value.doubleval = \
         lhs_reg->value.doubleval OP rhs_reg->value.integer; \
 } \
 else \
-    vm_regs[code[code_pos+4]]->value.doubleval = \
+    vm_regs[code[code_pos+4]].value.doubleval = \
     lhs_reg->value.integer OP rhs_reg->value.doubleval; \
-vm_regs[code[code_pos+4]]->flags = VAL_IS_DOUBLE; \
+vm_regs[code[code_pos+4]].flags = VAL_IS_DOUBLE; \
 code_pos += 5;
 
+/* code_pos is not kept around when the vm raises, so opcodes that can raise
+   use this to write down the current line beforehand. The position of the line
+   is written down too, so that the frame's try table can be searched. */
+#define SAVE_LINE \
+current_frame->line_num = code[code_pos+1]; \
+current_frame->code_pos = code_pos+1;
+
 /* EQUALITY_COMPARE_OP is used for == and !=, instead of a normal COMPARE_OP.
    The difference is that this will allow op on any type, so long as the lhs
    and rhs agree on the full type. This allows comparing functions, hashes
-   lists, and more.
+   lists, and more. Strings, and values that are both integers or both doubles
+   use the typed comparison ops instead.
 
    Arguments are:
    * op:       The operation to perform relative to the values given. This will
-               be substituted like: lhs->value OP rhs->value
-               This is done for everything BUT string.
-   * stringop: The operation to perform relative to the result of strcmp. ==
-               does == 0, as an example. */
-#define EQUALITY_COMPARE_OP(OP, STRINGOP) \
-lhs_reg = vm_regs[code[code_pos + 2]]; \
-rhs_reg = vm_regs[code[code_pos + 3]]; \
+               be substituted like: lhs->value OP rhs->value */
+#define EQUALITY_COMPARE_OP(OP) \
+lhs_reg = &vm_regs[code[code_pos + 2]]; \
+rhs_reg = &vm_regs[code[code_pos + 3]]; \
 if (lhs_reg->flags & VAL_IS_DOUBLE) { \
     if (rhs_reg->flags & VAL_IS_DOUBLE) \
-        vm_regs[code[code_pos+4]]->value.integer = \
+        vm_regs[code[code_pos+4]].value.integer = \
         (lhs_reg->value.doubleval OP rhs_reg->value.doubleval); \
     else \
-        vm_regs[code[code_pos+4]]->value.integer = \
+        vm_regs[code[code_pos+4]].value.integer = \
         (lhs_reg->value.doubleval OP rhs_reg->value.integer); \
 } \
 else if (lhs_reg->flags & VAL_IS_INTEGER) { \
     if (rhs_reg->flags & VAL_IS_INTEGER) \
-        vm_regs[code[code_pos+4]]->value.integer =  \
+        vm_regs[code[code_pos+4]].value.integer =  \
         (lhs_reg->value.integer OP rhs_reg->value.integer); \
     else \
-        vm_regs[code[code_pos+4]]->value.integer = \
+        vm_regs[code[code_pos+4]].value.integer = \
         (lhs_reg->value.integer OP rhs_reg->value.doubleval); \
 } \
-else if (lhs_reg->flags & VAL_IS_STRING) { \
-    vm_regs[code[code_pos+4]]->value.integer = \
-    strcmp(lhs_reg->value.string->string, \
-           rhs_reg->value.string->string) STRINGOP; \
-} \
 else { \
-    vm_regs[code[code_pos+4]]->value.integer = \
+    SAVE_LINE \
+    vm_regs[code[code_pos+4]].value.integer = \
     lily_eq_value(vm, lhs_reg, rhs_reg) OP 1; \
 } \
-vm_regs[code[code_pos+4]]->flags = VAL_IS_BOOLEAN; \
+vm_regs[code[code_pos+4]].flags = VAL_IS_BOOLEAN; \
 code_pos += 5;
 
-#define COMPARE_OP(OP, STRINGOP) \
-lhs_reg = vm_regs[code[code_pos + 2]]; \
-rhs_reg = vm_regs[code[code_pos + 3]]; \
+/* COMPARE_OP is used when one side is an integer and the other is a double. */
+#define COMPARE_OP(OP) \
+lhs_reg = &vm_regs[code[code_pos + 2]]; \
+rhs_reg = &vm_regs[code[code_pos + 3]]; \
 if (lhs_reg->flags & VAL_IS_DOUBLE) { \
     if (rhs_reg->flags & VAL_IS_DOUBLE) \
-        vm_regs[code[code_pos+4]]->value.integer = \
+        vm_regs[code[code_pos+4]].value.integer = \
         (lhs_reg->value.doubleval OP rhs_reg->value.doubleval); \
     else \
-        vm_regs[code[code_pos+4]]->value.integer = \
+        vm_regs[code[code_pos+4]].value.integer = \
         (lhs_reg->value.doubleval OP rhs_reg->value.integer); \
 } \
-else if (lhs_reg->flags & VAL_IS_INTEGER) { \
+else { \
     if (rhs_reg->flags & VAL_IS_INTEGER) \
-        vm_regs[code[code_pos+4]]->value.integer =  \
+        vm_regs[code[code_pos+4]].value.integer =  \
         (lhs_reg->value.integer OP rhs_reg->value.integer); \
     else \
-        vm_regs[code[code_pos+4]]->value.integer = \
+        vm_regs[code[code_pos+4]].value.integer = \
         (lhs_reg->value.integer OP rhs_reg->value.doubleval); \
 } \
-else if (lhs_reg->flags & VAL_IS_STRING) { \
-    vm_regs[code[code_pos+4]]->value.integer = \
-    strcmp(lhs_reg->value.string->string, \
-           rhs_reg->value.string->string) STRINGOP; \
-} \
-vm_regs[code[code_pos+4]]->flags = VAL_IS_BOOLEAN; \
+vm_regs[code[code_pos+4]].flags = VAL_IS_BOOLEAN; \
+code_pos += 5;
+
+/* These are used by the typed comparison ops. The emitter has already verified
+   the type of both sides, so there's no need to check flags. */
+#define INTEGER_COMPARE_OP(OP) \
+lhs_reg = &vm_regs[code[code_pos + 2]]; \
+rhs_reg = &vm_regs[code[code_pos + 3]]; \
+vm_regs[code[code_pos+4]].value.integer = \
+(lhs_reg->value.integer OP rhs_reg->value.integer); \
+vm_regs[code[code_pos+4]].flags = VAL_IS_BOOLEAN; \
+code_pos += 5;
+
+#define DOUBLE_COMPARE_OP(OP) \
+lhs_reg = &vm_regs[code[code_pos + 2]]; \
+rhs_reg = &vm_regs[code[code_pos + 3]]; \
+vm_regs[code[code_pos+4]].value.integer = \
+(lhs_reg->value.doubleval OP rhs_reg->value.doubleval); \
+vm_regs[code[code_pos+4]].flags = VAL_IS_BOOLEAN; \
+code_pos += 5;
+
+/* STRINGOP is applied to the result of strcmp. == does == 0, as an example. */
+#define STRING_COMPARE_OP(STRINGOP) \
+lhs_reg = &vm_regs[code[code_pos + 2]]; \
+rhs_reg = &vm_regs[code[code_pos + 3]]; \
+vm_regs[code[code_pos+4]].value.integer = \
+(strcmp(lhs_reg->value.string->string, \
+        rhs_reg->value.string->string) STRINGOP); \
+vm_regs[code[code_pos+4]].flags = VAL_IS_BOOLEAN; \
 code_pos += 5;
 
+/* The fused compare and jump ops test the comparison against jump_on, instead
+   of storing the result for o_jump_if to look at later. */
+#define INTEGER_JUMP_IF_OP(OP) \
+lhs_reg = &vm_regs[code[code_pos + 2]]; \
+rhs_reg = &vm_regs[code[code_pos + 3]]; \
+if ((lhs_reg->value.integer OP rhs_reg->value.integer) == code[code_pos+1]) \
+    code_pos = code[code_pos+4]; \
+else \
+    code_pos += 5;
+
+#define DOUBLE_JUMP_IF_OP(OP) \
+lhs_reg = &vm_regs[code[code_pos + 2]]; \
+rhs_reg = &vm_regs[code[code_pos + 3]]; \
+if ((lhs_reg->value.doubleval OP rhs_reg->value.doubleval) == \
+    code[code_pos+1]) \
+    code_pos = code[code_pos+4]; \
+else \
+    code_pos += 5;
+
+/* The main loop of the vm either uses a switch, or jumps through a table of
+   labels when LILY_COMPUTED_GOTO is defined (gcc and clang only). Jumping from
+   the end of each opcode gives each one a separate branch, which predicts
+   better than the single branch of a switch. */
+#ifdef LILY_COMPUTED_GOTO
+# define VM_DISPATCH goto *dispatch_table[code[code_pos]];
+# define VM_CASE(op) label_##op
+# define VM_NEXT goto *dispatch_table[code[code_pos]]
+#else
+# define VM_DISPATCH switch (code[code_pos])
+# define VM_CASE(op) case op
+# define VM_NEXT break
+#endif
+
 /** If you're interested in working on the vm, or having trouble with it, here's
     some advice that might make things easier.
 
@@ -127,7 +197,8 @@ code_pos += 5;
 
     * Foreign functions can cache vm->vm_regs (most all do). Do not ever use
       a cached value of vm->vm_regs after lily_foreign_call, as the registers
-      may have been resized. **/
+      may have been resized. Registers are stored inline, so this also goes
+      for any pointer to a register. **/
 
 /* This demands some explanation. A foreign function takes three arguments: The
    vm, a number of arguments, and the arguments themselves. There are times when
@@ -166,7 +237,7 @@ static uint16_t foreign_code[1] = {o_return_from_vm};
  *                          |_|
  */
 
-static void add_call_frame(lily_vm_state *);
+static void grow_call_frames(lily_vm_state *);
 static void invoke_gc(lily_vm_state *);
 
 lily_vm_state *lily_new_vm_state(lily_options *options,
@@ -188,30 +259,44 @@ lily_vm_state *lily_new_vm_state(lily_options *options,
     vm->offset_max_registers = 0;
     vm->true_max_registers = 0;
     vm->gc_live_entries = NULL;
+    vm->gc_young_entries = NULL;
     vm->gc_spare_entries = NULL;
     vm->gc_live_entry_count = 0;
+    vm->gc_young_count = 0;
+    vm->gc_young_threshold = options->gc_start;
+    memset(&vm->gc_stats, 0, sizeof(vm->gc_stats));
     vm->gc_pass = 0;
-    vm->catch_chain = NULL;
     vm->symtab = NULL;
     vm->readonly_table = NULL;
     vm->readonly_count = 0;
-    vm->call_chain = NULL;
+    /* The limit is on calls, and __main__ has a frame before any of those. */
+    vm->max_call_depth = options->max_call_depth + 1;
+    if (vm->max_call_depth == 0)
+        vm->max_call_depth = UINT32_MAX;
+
+    /* Start small, since most programs don't go very deep. */
+    uint32_t frame_count = 32, i;
+    if (frame_count > vm->max_call_depth)
+        frame_count = vm->max_call_depth;
+
+    vm->call_frames = lily_malloc(frame_count * sizeof(lily_call_frame));
+    vm->call_frames_end = vm->call_frames + frame_count;
+    vm->call_chain = vm->call_frames;
+
+    for (i = 0;i < frame_count;i++) {
+        vm->call_frames[i].return_target = NULL;
+        vm->call_frames[i].build_value = NULL;
+    }
+
     vm->vm_list = lily_malloc(sizeof(lily_vm_list));
-    vm->vm_list->values = lily_malloc(4 * sizeof(lily_value *));
+    vm->vm_list->values = lily_malloc(4 * sizeof(lily_value));
     vm->vm_list->pos = 0;
     vm->vm_list->size = 4;
     vm->class_count = 0;
     vm->class_table = NULL;
     vm->stdout_reg = NULL;
     vm->exception_value = NULL;
-
-    add_call_frame(vm);
-
-    lily_vm_catch_entry *catch_entry = lily_malloc(sizeof(lily_vm_catch_entry));
-    catch_entry->prev = NULL;
-    catch_entry->next = NULL;
-
-    vm->catch_chain = catch_entry;
+    vm->catch_base = NULL;
 
     return vm;
 }
@@ -224,7 +309,16 @@ static void destroy_gc_entries(lily_vm_state *vm)
     while (gc_iter != NULL) {
         gc_temp = gc_iter->next;
 
-        lily_free(gc_iter);
+        lily_free_fixed(gc_iter, sizeof(lily_gc_entry));
+
+        gc_iter = gc_temp;
+    }
+
+    gc_iter = vm->gc_young_entries;
+    while (gc_iter != NULL) {
+        gc_temp = gc_iter->next;
+
+        lily_free_fixed(gc_iter, sizeof(lily_gc_entry));
 
         gc_iter = gc_temp;
     }
@@ -233,38 +327,39 @@ static void destroy_gc_entries(lily_vm_state *vm)
     while (gc_iter != NULL) {
         gc_temp = gc_iter->next;
 
-        lily_free(gc_iter);
+        lily_free_fixed(gc_iter, sizeof(lily_gc_entry));
 
         gc_iter = gc_temp;
     }
 }
 
+/* Drop the values in the vm_list that are past 'start'. This is for when a
+   foreign function that was building values is left through an error. */
+static void drop_vm_list_values(lily_vm_state *vm, uint32_t start)
+{
+    lily_vm_list *vm_list = vm->vm_list;
+    uint32_t i;
+
+    for (i = start;i < vm_list->pos;i++)
+        lily_deref(&vm_list->values[i]);
+
+    vm_list->pos = start;
+}
+
 void lily_free_vm(lily_vm_state *vm)
 {
-    lily_value **regs_from_main = vm->regs_from_main;
+    lily_value *regs_from_main = vm->regs_from_main;
     lily_value *reg;
     int i;
-    if (vm->catch_chain != NULL) {
-        while (vm->catch_chain->prev)
-            vm->catch_chain = vm->catch_chain->prev;
-
-        lily_vm_catch_entry *catch_iter = vm->catch_chain;
-        lily_vm_catch_entry *catch_next;
-        while (catch_iter) {
-            catch_next = catch_iter->next;
-            lily_free(catch_iter);
-            catch_iter = catch_next;
-        }
-    }
 
     for (i = vm->true_max_registers-1;i >= 0;i--) {
-        reg = regs_from_main[i];
+        reg = &regs_from_main[i];
 
         lily_deref(reg);
-
-        lily_free(reg);
     }
 
+    drop_vm_list_values(vm, 0);
+
     /* This keeps the final gc invoke from touching the now-deleted registers.
        It also ensures the last invoke will get everything. */
     vm->num_registers = 0;
@@ -273,20 +368,21 @@ void lily_free_vm(lily_vm_state *vm)
 
     lily_free(regs_from_main);
 
-    lily_call_frame *frame_iter = vm->call_chain;
-    lily_call_frame *frame_next;
-
-    while (frame_iter->prev)
-        frame_iter = frame_iter->prev;
+    lily_free(vm->call_frames);
 
-    while (frame_iter) {
-        frame_next = frame_iter->next;
-        lily_free(frame_iter);
-        frame_iter = frame_next;
+    /* If there are any entries left over, then do a final gc pass that will
+       destroy the tagged values. The full pass only looks at the old entries,
+       so send the young ones over first. */
+    while (vm->gc_young_entries) {
+        lily_gc_entry *young_next = vm->gc_young_entries->next;
+
+        vm->gc_young_entries->is_young = 0;
+        vm->gc_young_entries->next = vm->gc_live_entries;
+        vm->gc_live_entries = vm->gc_young_entries;
+        vm->gc_live_entry_count++;
+        vm->gc_young_entries = young_next;
     }
 
-    /* If there are any entries left over, then do a final gc pass that will
-       destroy the tagged values. */
     if (vm->gc_live_entry_count)
         invoke_gc(vm);
 
@@ -311,9 +407,13 @@ void lily_free_vm(lily_vm_state *vm)
 static void gc_mark(int, lily_value *);
 
 /* This is Lily's garbage collector. It runs in multiple stages:
-   1: Go to each _in-use_ register that is not nil and use the appropriate
-      gc_marker call to mark all values inside that value which are visible.
-      Visible items are set to the vm's ->gc_pass.
+   1: Go to each register that is not nil and use the appropriate gc_marker
+      call to mark all values inside that value which are visible. Visible
+      items are set to the vm's ->gc_pass. Registers past the ones in use are
+      marked too. They still hold refs to what a finished call left behind,
+      and those are dropped when the registers are next used. A List left
+      there isn't tagged, so hollowing what it holds would leave the List
+      pointing at freed values.
    2: Go through all the gc items now. Anything which doesn't have the current
       pass as its last_pass is considered unreachable. This will deref values
       that cannot be circular, or forcibly collect possibly-circular values.
@@ -326,14 +426,13 @@ static void gc_mark(int, lily_value *);
         This is necessary because it's possible that a value may be visited
         multiple times. If it's deleted during this step, then extra visits will
         trigger invalid reads.
-   3: Stage 1 skipped registers that are not in-use, because Lily just hasn't
-      gotten around to clearing them yet. However, some of those registers may
-      contain a value that has a gc_entry that indicates that the value is to be
-      destroyed. It's -very- important that these registers be marked as nil so
-      that prep_registers will not try to deref a value that has been destroyed
-      by the gc.
-   4: Finally, destroy any values that stage 2 didn't clear.
-      Absolutely nothing is using these now, so it's safe to destroy them. */
+   3: Finally, destroy any values that stage 2 didn't clear.
+      Absolutely nothing is using these now, so it's safe to destroy them.
+      Entries whose value was deleted through ref/deref are made spare here
+      too, so that they stop counting against the threshold.
+
+   This full sweep is only done on the old entries, and only after a young pass
+   (see invoke_young_gc below) has moved the survivors over. */
 static void invoke_gc(lily_vm_state *vm)
 {
     /* This is (sort of) a mark-and-sweep garbage collector. This is called when
@@ -342,15 +441,15 @@ static void invoke_gc(lily_vm_state *vm)
        value set to NULL as an indicator. */
     vm->gc_pass++;
 
-    lily_value **regs_from_main = vm->regs_from_main;
+    lily_value *regs_from_main = vm->regs_from_main;
     int pass = vm->gc_pass;
     int i;
     lily_gc_entry *gc_iter;
 
     /* Stage 1: Go through all registers and use the appropriate gc_marker call
                 that will mark every inner value that's visible. */
-    for (i = 0;i < vm->num_registers;i++) {
-        lily_value *reg = regs_from_main[i];
+    for (i = 0;i < vm->true_max_registers;i++) {
+        lily_value *reg = &regs_from_main[i];
         if (reg->flags & VAL_IS_GC_SWEEPABLE)
             gc_mark(pass, reg);
     }
@@ -370,18 +469,7 @@ static void invoke_gc(lily_vm_state *vm)
         }
     }
 
-    /* Stage 3: Check registers not currently in use to see if they hold a
-                value that's going to be collected. If so, then mark the
-                register as nil so that the value will be cleared later. */
-    for (i = vm->num_registers;i < vm->true_max_registers;i++) {
-        lily_value *reg = regs_from_main[i];
-        if (reg->flags & VAL_IS_GC_TAGGED &&
-            reg->value.gc_generic->gc_entry == lily_gc_stopper) {
-            reg->flags = 0;
-        }
-    }
-
-    /* Stage 4: Delete the values that stage 2 didn't delete.
+    /* Stage 3: Delete the values that stage 2 didn't delete.
                 Nothing is using them anymore. Also, sort entries into those
                 that are living and those that are no longer used. */
     i = 0;
@@ -393,8 +481,12 @@ static void invoke_gc(lily_vm_state *vm)
     while (gc_iter) {
         iter_next = gc_iter->next;
 
-        if (gc_iter->last_pass == -1) {
-            lily_free(gc_iter->value.generic);
+        if (gc_iter->last_pass == -1 ||
+            gc_iter->value.generic == NULL) {
+            if (gc_iter->value.generic) {
+                lily_free(gc_iter->value.generic);
+                vm->gc_stats.swept++;
+            }
 
             gc_iter->next = new_spare_entries;
             new_spare_entries = gc_iter;
@@ -416,6 +508,8 @@ static void invoke_gc(lily_vm_state *vm)
     vm->gc_live_entry_count = i;
     vm->gc_live_entries = new_live_entries;
     vm->gc_spare_entries = new_spare_entries;
+    vm->gc_stats.full_collections++;
+    vm->gc_stats.marked += i;
 }
 
 void dynamic_marker(int pass, lily_value *v)
@@ -431,8 +525,12 @@ void list_marker(int pass, lily_value *v)
     lily_list_val *list_val = v->value.list;
     int i;
 
+    /* Packed lists only hold numbers. */
+    if (list_val->packed_flags)
+        return;
+
     for (i = 0;i < list_val->num_values;i++) {
-        lily_value *elem = list_val->elems[i];
+        lily_value *elem = &list_val->elems[i];
 
         if (elem->flags & VAL_IS_GC_SWEEPABLE)
             gc_mark(pass, elem);
@@ -442,12 +540,13 @@ void list_marker(int pass, lily_value *v)
 void hash_marker(int pass, lily_value *v)
 {
     lily_hash_val *hash_val = v->value.hash;
-    lily_hash_elem *elem_iter = hash_val->elem_chain;
-    while (elem_iter) {
-        lily_value *elem_value = elem_iter->elem_value;
-        gc_mark(pass, elem_value);
+    uint32_t i;
 
-        elem_iter = elem_iter->next;
+    for (i = 0;i < hash_val->elem_count;i++) {
+        lily_value *elem_value = &hash_val->elems[i].elem_value;
+
+        if (elem_value->flags & VAL_IS_GC_SWEEPABLE)
+            gc_mark(pass, elem_value);
     }
 }
 
@@ -468,9 +567,11 @@ static void function_marker(int pass, lily_value *v)
 
 static void gc_mark(int pass, lily_value *v)
 {
-    if (((v->flags & VAL_IS_GC_TAGGED) &&
-         v->value.gc_generic->gc_entry->last_pass != pass) ||
-         v->flags & VAL_IS_GC_SPECULATIVE)
+    /* Dynamic values are both tagged and speculative. The tag has to win, or a
+       Dynamic that holds itself would be marked forever. */
+    if ((v->flags & VAL_IS_GC_TAGGED) ?
+        v->value.gc_generic->gc_entry->last_pass != pass :
+        v->flags & VAL_IS_GC_SPECULATIVE)
     {
         if (v->flags & VAL_IS_GC_TAGGED) {
             lily_generic_gc_val *gen_val = v->value.gc_generic;
@@ -489,36 +590,254 @@ static void gc_mark(int pass, lily_value *v)
     }
 }
 
+/** Most tagged values do not live for long, and the ones that do tend to stay
+    around. Instead of marking from every register each time, values that are
+    newly tagged go onto a young list. When that list is full, a young pass
+    finds out which of those values are still reachable and moves them to the
+    old list. The young pass only looks at the young values, so the time it
+    takes depends on how much was recently tagged, instead of the whole heap.
+
+    A young value can be held by an old value, and those holds need to be
+    found without visiting the old values. Lily is refcounted, so this uses the
+    refcounts in place of a write barrier:
+    1: Each young entry starts with the refcount of the value as the number of
+       refs that come from outside of the young values.
+    2: Walk the inside of each young value. Every young value that is found
+       directly inside takes away one outside ref. Values that are not tagged
+       are walked into if they have exactly one ref (so that the ref is from
+       the young value being walked). The same goes for closure cells.
+    3: Any young value with refs left over is held by a register, an old value,
+       or some value that has more than one owner. Those are marked, and so is
+       every young value that they hold.
+    4: Young values that were not marked can only be reached from each other.
+       Those are destroyed the same way that the full sweep destroys values.
+    5: Survivors are moved to the old list. If that list is past the threshold,
+       gc_collect follows with a full sweep to collect cycles that involve old
+       values. **/
+
+#define GC_YOUNG_SCAN 0
+#define GC_YOUNG_MARK 1
+
+static void gc_young_walk(int, int, lily_value *);
+
+static void gc_young_visit(int pass, int mode, lily_value *v)
+{
+    if (v->flags & VAL_IS_GC_TAGGED) {
+        lily_gc_entry *entry = v->value.gc_generic->gc_entry;
+
+        /* Old values are left alone. They hold refs to young values, and that
+           is what keeps those young values alive. */
+        if (entry->is_young == 0)
+            return;
+
+        if (mode == GC_YOUNG_SCAN)
+            entry->outside_refs--;
+        else if (entry->last_pass != pass) {
+            entry->last_pass = pass;
+            gc_young_walk(pass, mode, v);
+        }
+    }
+    else if (v->flags & VAL_IS_GC_SPECULATIVE) {
+        if (mode == GC_YOUNG_MARK || v->value.generic->refcount == 1)
+            gc_young_walk(pass, mode, v);
+    }
+}
+
+/* This visits every value held by 'v'. */
+static void gc_young_walk(int pass, int mode, lily_value *v)
+{
+    int i;
+
+    if (v->flags &
+        (VAL_IS_LIST | VAL_IS_INSTANCE | VAL_IS_ENUM | VAL_IS_TUPLE)) {
+        lily_list_val *list_val = v->value.list;
+
+        if (list_val->packed_flags)
+            return;
+
+        for (i = 0;i < list_val->num_values;i++) {
+            lily_value *elem = &list_val->elems[i];
+
+            if (elem->flags & VAL_IS_GC_SWEEPABLE)
+                gc_young_visit(pass, mode, elem);
+        }
+    }
+    else if (v->flags & VAL_IS_HASH) {
+        lily_hash_val *hash_val = v->value.hash;
+        uint32_t j;
+
+        for (j = 0;j < hash_val->elem_count;j++) {
+            lily_value *elem_value = &hash_val->elems[j].elem_value;
+
+            if (elem_value->flags & VAL_IS_GC_SWEEPABLE)
+                gc_young_visit(pass, mode, elem_value);
+        }
+    }
+    else if (v->flags & VAL_IS_DYNAMIC) {
+        lily_value *inner_value = v->value.dynamic->inner_value;
+
+        if (inner_value->flags & VAL_IS_GC_SWEEPABLE)
+            gc_young_visit(pass, mode, inner_value);
+    }
+    else if (v->flags & VAL_IS_FUNCTION) {
+        lily_function_val *function_val = v->value.function;
+        lily_value **upvalues = function_val->upvalues;
+        int count = function_val->num_upvalues;
+
+        for (i = 0;i < count;i++) {
+            lily_value *up = upvalues[i];
+
+            if (up && (up->flags & VAL_IS_GC_SWEEPABLE) &&
+                (mode == GC_YOUNG_MARK || up->cell_refcount == 1))
+                gc_young_visit(pass, mode, up);
+        }
+    }
+}
+
+static void invoke_young_gc(lily_vm_state *vm)
+{
+    vm->gc_pass++;
+
+    int pass = vm->gc_pass;
+    lily_gc_entry *gc_iter;
+
+    /* Stages 1 and 2: Find out how many refs come from outside. Entries with a
+                       NULL value were destroyed through ref/deref. */
+    for (gc_iter = vm->gc_young_entries;gc_iter;gc_iter = gc_iter->next) {
+        if (gc_iter->value.generic)
+            gc_iter->outside_refs = gc_iter->value.generic->refcount;
+    }
+
+    for (gc_iter = vm->gc_young_entries;gc_iter;gc_iter = gc_iter->next) {
+        if (gc_iter->value.generic)
+            gc_young_walk(pass, GC_YOUNG_SCAN, (lily_value *)gc_iter);
+    }
+
+    /* Stage 3: Mark everything that can be reached from outside. */
+    for (gc_iter = vm->gc_young_entries;gc_iter;gc_iter = gc_iter->next) {
+        if (gc_iter->value.generic &&
+            gc_iter->outside_refs != 0 &&
+            gc_iter->last_pass != pass) {
+            gc_iter->last_pass = pass;
+            gc_young_walk(pass, GC_YOUNG_MARK, (lily_value *)gc_iter);
+        }
+    }
+
+    /* Stage 4: Hollow what wasn't marked. This may cause marked values to be
+                destroyed through deref, so ->value is checked again later. */
+    for (gc_iter = vm->gc_young_entries;gc_iter;gc_iter = gc_iter->next) {
+        if (gc_iter->last_pass != pass &&
+            gc_iter->value.generic != NULL) {
+            gc_iter->last_pass = -1;
+            lily_destroy_value((lily_value *)gc_iter);
+        }
+    }
+
+    /* Stage 5: Finish off hollowed values, and move survivors to the old
+                list. */
+    lily_gc_entry *iter_next;
+    gc_iter = vm->gc_young_entries;
+
+    while (gc_iter) {
+        iter_next = gc_iter->next;
+
+        if (gc_iter->last_pass == -1 ||
+            gc_iter->value.generic == NULL) {
+            if (gc_iter->value.generic) {
+                lily_free(gc_iter->value.generic);
+                vm->gc_stats.swept++;
+            }
+
+            gc_iter->next = vm->gc_spare_entries;
+            vm->gc_spare_entries = gc_iter;
+        }
+        else {
+            gc_iter->is_young = 0;
+            gc_iter->next = vm->gc_live_entries;
+            vm->gc_live_entries = gc_iter;
+            vm->gc_live_entry_count++;
+            vm->gc_stats.marked++;
+        }
+
+        gc_iter = iter_next;
+    }
+
+    vm->gc_young_entries = NULL;
+    vm->gc_young_count = 0;
+    vm->gc_stats.young_collections++;
+}
+
+/* This does a young pass, then a full sweep if the old list is too big (or if
+   'force_full' is set). The time taken is added to the stats. */
+static void gc_collect(lily_vm_state *vm, int force_full)
+{
+    clock_t start = clock();
+
+    invoke_young_gc(vm);
+
+    if (force_full || vm->gc_live_entry_count >= vm->gc_threshold)
+        invoke_gc(vm);
+
+    uint64_t usec = (uint64_t)(clock() - start) * 1000000 / CLOCKS_PER_SEC;
+
+    vm->gc_stats.pause_usec += usec;
+    if (vm->gc_stats.max_pause_usec < usec)
+        vm->gc_stats.max_pause_usec = usec;
+}
+
+void lily_vm_gc_collect(lily_vm_state *vm)
+{
+    gc_collect(vm, 1);
+}
+
+void lily_vm_get_gc_stats(lily_vm_state *vm, lily_gc_stats *stats)
+{
+    *stats = vm->gc_stats;
+}
+
+void lily_vm_set_gc_threshold(lily_vm_state *vm, uint32_t threshold)
+{
+    vm->gc_young_threshold = threshold;
+}
+
+uint32_t lily_vm_get_gc_threshold(lily_vm_state *vm)
+{
+    return vm->gc_young_threshold;
+}
+
 /* This will attempt to grab a spare entry and associate it with the value
    given. If there are no spare entries, then a new entry is made. These entries
    are how the gc is able to locate values later.
 
-   If the number of living gc objects is at or past the threshold, then the
+   If the number of young gc objects is at or past the threshold, then the
    collector will run BEFORE the association. This is intentional, as 'value' is
    not guaranteed to be in a register. */
 void lily_tag_value(lily_vm_state *vm, lily_value *v)
 {
-    if (vm->gc_live_entry_count >= vm->gc_threshold)
-        invoke_gc(vm);
+    if (vm->gc_young_count >= vm->gc_young_threshold)
+        gc_collect(vm, 0);
 
     lily_gc_entry *new_entry;
     if (vm->gc_spare_entries != NULL) {
         new_entry = vm->gc_spare_entries;
         vm->gc_spare_entries = vm->gc_spare_entries->next;
+        vm->gc_stats.reused++;
     }
     else
-        new_entry = lily_malloc(sizeof(lily_gc_entry));
+        new_entry = lily_malloc_fixed(sizeof(lily_gc_entry));
 
     new_entry->value.gc_generic = v->value.gc_generic;
     new_entry->last_pass = 0;
     new_entry->flags = v->flags;
 
-    new_entry->next = vm->gc_live_entries;
-    vm->gc_live_entries = new_entry;
+    new_entry->is_young = 1;
+
+    new_entry->next = vm->gc_young_entries;
+    vm->gc_young_entries = new_entry;
 
     /* Attach the gc_entry to the value so the caller doesn't have to. */
     v->value.gc_generic->gc_entry = new_entry;
-    vm->gc_live_entry_count++;
+    vm->gc_young_count++;
 
     v->flags |= VAL_IS_GC_TAGGED;
 }
@@ -544,6 +863,39 @@ void lily_tag_value(lily_vm_state *vm, lily_value *v)
     a register with a seed type of, say, A, into whatever it should be for the
     given invocation. **/
 
+/* This moves 'reg' over to 'new_regs' if it was within the 'count' registers
+   that started at 'old_regs'. The old block is gone, so compare addresses. */
+static lily_value *rebase_register(lily_value *reg, lily_value *old_regs,
+        int count, lily_value *new_regs)
+{
+    uintptr_t start = (uintptr_t)old_regs;
+    uintptr_t at = (uintptr_t)reg;
+
+    if (at >= start && at < start + (count * sizeof(lily_value)))
+        reg = new_regs + ((at - start) / sizeof(lily_value));
+
+    return reg;
+}
+
+/* Call frames hold onto registers for returning and for building classes, and
+   stdout is held directly. Fix all of those up after the registers move. */
+static void rebase_register_pointers(lily_vm_state *vm, lily_value *old_regs,
+        int count, lily_value *new_regs)
+{
+    lily_call_frame *frame_iter = vm->call_chain;
+
+    while (frame_iter >= vm->call_frames) {
+        frame_iter->return_target = rebase_register(frame_iter->return_target,
+                old_regs, count, new_regs);
+        frame_iter->build_value = rebase_register(frame_iter->build_value,
+                old_regs, count, new_regs);
+        frame_iter--;
+    }
+
+    vm->stdout_reg = rebase_register(vm->stdout_reg, old_regs, count,
+            new_regs);
+}
+
 /* This function ensures that 'register_need' more registers will be available.
    This may resize (and thus invalidate) vm->regs_from_main and vm->vm_regs. */
 static void grow_vm_registers(lily_vm_state *vm, int register_need)
@@ -553,7 +905,8 @@ static void grow_vm_registers(lily_vm_state *vm, int register_need)
        calls. */
     register_need += 2;
 
-    lily_value **new_regs;
+    lily_value *old_regs = vm->regs_from_main;
+    lily_value *new_regs;
     int i = vm->true_max_registers;
 
     ptrdiff_t reg_offset = vm->vm_regs - vm->regs_from_main;
@@ -569,18 +922,22 @@ static void grow_vm_registers(lily_vm_state *vm, int register_need)
     while (size < register_need);
 
     /* Remember, use regs_from_main, NOT vm_regs, which is likely adjusted. */
-    new_regs = lily_realloc(vm->regs_from_main, size *
-            sizeof(lily_value *));
+    new_regs = lily_realloc(vm->regs_from_main, size * sizeof(lily_value));
 
     /* Realloc can move the pointer, so always recalculate vm_regs again using
        regs_from_main and the offset. */
     vm->regs_from_main = new_regs;
     vm->vm_regs = new_regs + reg_offset;
 
-    /* Now create the registers as a bunch of empty values, to be filled in
-       whenever they are needed. */
+    /* The registers are stored inline, so anything pointing into the old block
+       has to be moved over to the new one. */
+    if (old_regs != new_regs && old_regs != NULL)
+        rebase_register_pointers(vm, old_regs, i, new_regs);
+
+    /* The new registers start off empty, to be filled in whenever they are
+       needed. */
     for (;i < size;i++)
-        new_regs[i] = lily_new_empty_value();
+        new_regs[i].flags = 0;
 
     vm->true_max_registers = size;
     vm->offset_max_registers = size - 2;
@@ -592,10 +949,11 @@ static void grow_vm_registers(lily_vm_state *vm, int register_need)
 static inline void scrub_registers(lily_vm_state *vm,
         lily_function_val *fval, int args_collected)
 {
-    lily_value **target_regs = vm->regs_from_main + vm->num_registers;
+    lily_value *target_regs = vm->regs_from_main + vm->num_registers;
     for (;args_collected < fval->reg_count;args_collected++) {
-        lily_value *reg = target_regs[args_collected];
-        lily_deref(reg);
+        lily_value *reg = &target_regs[args_collected];
+        if (reg->flags & VAL_IS_DEREFABLE)
+            lily_deref(reg);
 
         reg->flags = 0;
     }
@@ -604,19 +962,19 @@ static inline void scrub_registers(lily_vm_state *vm,
 /* This is called to initialize the registers that 'fval' will need to types
    that it expects. Old values are given a deref. Parameters are copied over and
    given refs. */
-static void prep_registers(lily_vm_state *vm, lily_function_val *fval,
+static inline void prep_registers(lily_vm_state *vm, lily_function_val *fval,
         uint16_t *code)
 {
     int register_need = vm->num_registers + fval->reg_count;
     int i;
-    lily_value **input_regs = vm->vm_regs;
-    lily_value **target_regs = vm->regs_from_main + vm->num_registers;
+    lily_value *input_regs = vm->vm_regs;
+    lily_value *target_regs = vm->regs_from_main + vm->num_registers;
 
     /* A function's args always come first, so copy arguments over while clearing
        old values. */
     for (i = 0;i < code[3];i++) {
-        lily_value *get_reg = input_regs[code[5+i]];
-        lily_value *set_reg = target_regs[i];
+        lily_value *get_reg = &input_regs[code[5+i]];
+        lily_value *set_reg = &target_regs[i];
 
         if (get_reg->flags & VAL_IS_DEREFABLE)
             get_reg->value.generic->refcount++;
@@ -642,30 +1000,35 @@ static void prep_registers(lily_vm_state *vm, lily_function_val *fval,
  *                  |_|
  */
 
-static void add_call_frame(lily_vm_state *vm)
+/* This is called when the current frame is the last one in the block, and a
+   call needs another frame. The block is doubled (up to the max depth), and
+   the current frame is moved over. Since the frame that callers have may have
+   moved, they should reload it from vm->call_chain. */
+static void grow_call_frames(lily_vm_state *vm)
 {
-    lily_call_frame *new_frame = lily_malloc(sizeof(lily_call_frame));
+    lily_call_frame *old_frames = vm->call_frames;
+    uint32_t old_count = vm->call_frames_end - old_frames;
+    uint32_t new_count = old_count * 2;
+    uint32_t i;
 
-    /* This intentionally doesn't set anything but prev and next because the
-       caller will have proper values for those. */
-    new_frame->prev = vm->call_chain;
-    new_frame->next = NULL;
-    new_frame->return_target = NULL;
-    new_frame->build_value = NULL;
+    if (old_count >= vm->max_call_depth)
+        lily_vm_raise(vm, SYM_CLASS_RUNTIMEERROR,
+                "Function call recursion limit reached.\n");
 
-    if (vm->call_chain != NULL)
-        vm->call_chain->next = new_frame;
+    if (new_count > vm->max_call_depth)
+        new_count = vm->max_call_depth;
 
-    vm->call_chain = new_frame;
-}
+    lily_call_frame *new_frames = lily_realloc(old_frames,
+            new_count * sizeof(lily_call_frame));
 
-static void add_catch_entry(lily_vm_state *vm)
-{
-    lily_vm_catch_entry *new_entry = lily_malloc(sizeof(lily_vm_catch_entry));
+    for (i = old_count;i < new_count;i++) {
+        new_frames[i].return_target = NULL;
+        new_frames[i].build_value = NULL;
+    }
 
-    vm->catch_chain->next = new_entry;
-    new_entry->next = NULL;
-    new_entry->prev = vm->catch_chain;
+    vm->call_chain = new_frames + (vm->call_chain - old_frames);
+    vm->call_frames = new_frames;
+    vm->call_frames_end = new_frames + new_count;
 }
 
 /***
@@ -727,6 +1090,7 @@ void lily_vm_raise_fmt(lily_vm_state *vm, uint8_t id, const char *fmt, ...)
 static void key_error(lily_vm_state *vm, int code_pos, lily_value *key)
 {
     vm->call_chain->line_num = vm->call_chain->code[code_pos + 1];
+    vm->call_chain->code_pos = code_pos + 1;
 
     lily_msgbuf *msgbuf = vm->raiser->aux_msgbuf;
 
@@ -741,8 +1105,11 @@ static void key_error(lily_vm_state *vm, int code_pos, lily_value *key)
 }
 
 /* Raise IndexError, noting that 'bad_index' is, well, bad. */
-static void boundary_error(lily_vm_state *vm, int bad_index)
+static void boundary_error(lily_vm_state *vm, int code_pos, int bad_index)
 {
+    vm->call_chain->line_num = vm->call_chain->code[code_pos + 1];
+    vm->call_chain->code_pos = code_pos + 1;
+
     lily_msgbuf *msgbuf = vm->raiser->aux_msgbuf;
     lily_msgbuf_flush(msgbuf);
     lily_msgbuf_add_fmt(msgbuf, "Subscript index %d is out of range.\n",
@@ -764,16 +1131,16 @@ static lily_list_val *build_traceback_raw(lily_vm_state *);
 
 void lily_builtin_calltrace(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 {
-    lily_value *result = vm->vm_regs[code[0]];
+    lily_value *result = &vm->vm_regs[code[0]];
 
     /* Nobody is going to care that the most recent function is calltrace, so
        omit that. */
-    vm->call_chain = vm->call_chain->prev;
+    vm->call_chain--;
     vm->call_depth--;
 
     lily_list_val *traceback_val = build_traceback_raw(vm);
 
-    vm->call_chain = vm->call_chain->next;
+    vm->call_chain++;
     vm->call_depth++;
 
     lily_move_list_f(MOVE_DEREF_NO_GC, result, traceback_val);
@@ -795,7 +1162,7 @@ static void do_print(lily_vm_state *vm, FILE *target, lily_value *source)
 
 void lily_builtin_print(lily_vm_state *vm, uint16_t argc, uint16_t *code)
 {
-    do_print(vm, stdout, vm->vm_regs[code[1]]);
+    do_print(vm, stdout, &vm->vm_regs[code[1]]);
 }
 
 /* Initially, print is implemented through lily_builtin_print. However, when
@@ -809,7 +1176,7 @@ static void builtin_stdout_print(lily_vm_state *vm, uint16_t argc,
         lily_vm_raise(vm, SYM_CLASS_VALUEERROR,
                 "IO operation on closed file.\n");
 
-    do_print(vm, stdout_val->inner_file, vm->vm_regs[code[1]]);
+    do_print(vm, stdout_val->inner_file, &vm->vm_regs[code[1]]);
 }
 
 /***
@@ -829,42 +1196,42 @@ static void builtin_stdout_print(lily_vm_state *vm, uint16_t argc,
    be loaded from a register. */
 static void do_o_set_property(lily_vm_state *vm, uint16_t *code, int code_pos)
 {
-    lily_value **vm_regs = vm->vm_regs;
+    lily_value *vm_regs = vm->vm_regs;
     lily_value *rhs_reg;
     int index;
     lily_instance_val *ival;
 
     index = code[code_pos + 2];
-    ival = vm_regs[code[code_pos + 3]]->value.instance;
-    rhs_reg = vm_regs[code[code_pos + 4]];
+    ival = vm_regs[code[code_pos + 3]].value.instance;
+    rhs_reg = &vm_regs[code[code_pos + 4]];
 
-    lily_assign_value(ival->values[index], rhs_reg);
+    lily_assign_value(&ival->values[index], rhs_reg);
 }
 
 static void do_o_get_property(lily_vm_state *vm, uint16_t *code, int code_pos)
 {
-    lily_value **vm_regs = vm->vm_regs;
+    lily_value *vm_regs = vm->vm_regs;
     lily_value *result_reg;
     int index;
     lily_instance_val *ival;
 
     index = code[code_pos + 2];
-    ival = vm_regs[code[code_pos + 3]]->value.instance;
-    result_reg = vm_regs[code[code_pos + 4]];
+    ival = vm_regs[code[code_pos + 3]].value.instance;
+    result_reg = &vm_regs[code[code_pos + 4]];
 
-    lily_assign_value(result_reg, ival->values[index]);
+    lily_assign_value(result_reg, &ival->values[index]);
 }
 
 /* This handles subscript assignment. The index is a register, and needs to be
    validated. */
 static void do_o_set_item(lily_vm_state *vm, uint16_t *code, int code_pos)
 {
-    lily_value **vm_regs = vm->vm_regs;
+    lily_value *vm_regs = vm->vm_regs;
     lily_value *lhs_reg, *index_reg, *rhs_reg;
 
-    lhs_reg = vm_regs[code[code_pos + 2]];
-    index_reg = vm_regs[code[code_pos + 3]];
-    rhs_reg = vm_regs[code[code_pos + 4]];
+    lhs_reg = &vm_regs[code[code_pos + 2]];
+    index_reg = &vm_regs[code[code_pos + 3]];
+    rhs_reg = &vm_regs[code[code_pos + 4]];
 
     if ((lhs_reg->flags & VAL_IS_HASH) == 0) {
         lily_list_val *list_val = lhs_reg->value.list;
@@ -873,14 +1240,14 @@ static void do_o_set_item(lily_vm_state *vm, uint16_t *code, int code_pos)
         if (index_int < 0) {
             int new_index = list_val->num_values + index_int;
             if (new_index < 0)
-                boundary_error(vm, index_int);
+                boundary_error(vm, code_pos, index_int);
 
             index_int = new_index;
         }
         else if (index_int >= list_val->num_values)
-            boundary_error(vm, index_int);
+            boundary_error(vm, code_pos, index_int);
 
-        lily_assign_value(list_val->elems[index_int], rhs_reg);
+        lily_list_set_elem(list_val, index_int, rhs_reg);
     }
     else
         lily_hash_set_elem(vm, lhs_reg->value.hash, index_reg, rhs_reg);
@@ -890,18 +1257,22 @@ static void do_o_set_item(lily_vm_state *vm, uint16_t *code, int code_pos)
    validated. */
 static void do_o_get_item(lily_vm_state *vm, uint16_t *code, int code_pos)
 {
-    lily_value **vm_regs = vm->vm_regs;
+    lily_value *vm_regs = vm->vm_regs;
     lily_value *lhs_reg, *index_reg, *result_reg;
 
-    lhs_reg = vm_regs[code[code_pos + 2]];
-    index_reg = vm_regs[code[code_pos + 3]];
-    result_reg = vm_regs[code[code_pos + 4]];
+    lhs_reg = &vm_regs[code[code_pos + 2]];
+    index_reg = &vm_regs[code[code_pos + 3]];
+    result_reg = &vm_regs[code[code_pos + 4]];
 
     /* list and tuple have the same representation internally. Since list
        stores proper values, lily_assign_value automagically set the type to
        the right thing. */
-    if (lhs_reg->flags & VAL_IS_STRING)
+    if (lhs_reg->flags & VAL_IS_STRING) {
+        /* This can raise IndexError, so write down the line first. */
+        vm->call_chain->line_num = code[code_pos + 1];
+        vm->call_chain->code_pos = code_pos + 1;
         lily_string_subscript(vm, lhs_reg, index_reg, result_reg);
+    }
     else if (lhs_reg->flags & (VAL_IS_LIST | VAL_IS_TUPLE)) {
         lily_list_val *list_val = lhs_reg->value.list;
         int index_int = index_reg->value.integer;
@@ -909,14 +1280,16 @@ static void do_o_get_item(lily_vm_state *vm, uint16_t *code, int code_pos)
         if (index_int < 0) {
             int new_index = list_val->num_values + index_int;
             if (new_index < 0)
-                boundary_error(vm, index_int);
+                boundary_error(vm, code_pos, index_int);
 
             index_int = new_index;
         }
         else if (index_int >= list_val->num_values)
-            boundary_error(vm, index_int);
+            boundary_error(vm, code_pos, index_int);
 
-        lily_assign_value(result_reg, list_val->elems[index_int]);
+        lily_value scratch;
+        lily_assign_value(result_reg,
+                lily_list_get_elem(list_val, index_int, &scratch));
     }
     else {
         lily_hash_elem *hash_elem = lily_hash_get_elem(vm, lhs_reg->value.hash,
@@ -926,19 +1299,78 @@ static void do_o_get_item(lily_vm_state *vm, uint16_t *code, int code_pos)
         if (hash_elem == NULL)
             key_error(vm, code_pos, index_reg);
 
-        lily_assign_value(result_reg, hash_elem->elem_value);
+        lily_assign_value(result_reg, &hash_elem->elem_value);
+    }
+}
+
+/* These are o_get_item and o_set_item for a List that the emitter knows to be
+   packed. A List built by a foreign function might not be, so those are sent
+   to the regular opcodes. The result (or right side) is a Boolean, Integer, or
+   Double, so it never needs a ref or deref. */
+static void do_o_get_packed_item(lily_vm_state *vm, uint16_t *code,
+        int code_pos)
+{
+    lily_value *vm_regs = vm->vm_regs;
+    lily_list_val *list_val = vm_regs[code[code_pos + 2]].value.list;
+
+    if (list_val->packed_flags == 0) {
+        do_o_get_item(vm, code, code_pos);
+        return;
+    }
+
+    int index_int = vm_regs[code[code_pos + 3]].value.integer;
+    lily_value *result_reg = &vm_regs[code[code_pos + 4]];
+
+    if (index_int < 0) {
+        int new_index = list_val->num_values + index_int;
+        if (new_index < 0)
+            boundary_error(vm, code_pos, index_int);
+
+        index_int = new_index;
+    }
+    else if (index_int >= list_val->num_values)
+        boundary_error(vm, code_pos, index_int);
+
+    result_reg->value = list_val->raw_elems[index_int];
+    result_reg->flags = list_val->packed_flags;
+}
+
+static void do_o_set_packed_item(lily_vm_state *vm, uint16_t *code,
+        int code_pos)
+{
+    lily_value *vm_regs = vm->vm_regs;
+    lily_list_val *list_val = vm_regs[code[code_pos + 2]].value.list;
+
+    if (list_val->packed_flags == 0) {
+        do_o_set_item(vm, code, code_pos);
+        return;
+    }
+
+    int index_int = vm_regs[code[code_pos + 3]].value.integer;
+    lily_value *rhs_reg = &vm_regs[code[code_pos + 4]];
+
+    if (index_int < 0) {
+        int new_index = list_val->num_values + index_int;
+        if (new_index < 0)
+            boundary_error(vm, code_pos, index_int);
+
+        index_int = new_index;
     }
+    else if (index_int >= list_val->num_values)
+        boundary_error(vm, code_pos, index_int);
+
+    list_val->raw_elems[index_int] = rhs_reg->value;
 }
 
 /* This builds a hash. It's written like '#pairs, key, value, key, value...'. */
 static void do_o_build_hash(lily_vm_state *vm, uint16_t *code, int code_pos)
 {
-    lily_value **vm_regs = vm->vm_regs;
+    lily_value *vm_regs = vm->vm_regs;
     int i, num_values;
     lily_value *result, *key_reg, *value_reg;
 
     num_values = code[code_pos + 2];
-    result = vm_regs[code[code_pos + 3 + num_values]];
+    result = &vm_regs[code[code_pos + 3 + num_values]];
 
     lily_hash_val *hash_val = lily_new_hash_val();
     lily_move_hash_f(MOVE_DEREF_SPECULATIVE, result, hash_val);
@@ -946,8 +1378,8 @@ static void do_o_build_hash(lily_vm_state *vm, uint16_t *code, int code_pos)
     for (i = 0;
          i < num_values;
          i += 2) {
-        key_reg = vm_regs[code[code_pos + 3 + i]];
-        value_reg = vm_regs[code[code_pos + 3 + i + 1]];
+        key_reg = &vm_regs[code[code_pos + 3 + i]];
+        value_reg = &vm_regs[code[code_pos + 3 + i + 1]];
 
         lily_hash_set_elem(vm, hash_val, key_reg, value_reg);
     }
@@ -958,50 +1390,53 @@ static void do_o_build_hash(lily_vm_state *vm, uint16_t *code, int code_pos)
    However, variant types are also tuples (but with a different name). */
 static void do_o_build_list_tuple(lily_vm_state *vm, uint16_t *code)
 {
-    lily_value **vm_regs = vm->vm_regs;
+    lily_value *vm_regs = vm->vm_regs;
     int num_elems = code[2];
-    lily_value *result = vm_regs[code[3+num_elems]];
-
-    lily_list_val *lv = lily_new_list_val();
-    lily_value **elems = lily_malloc(num_elems * sizeof(lily_value *));
+    lily_value *result = &vm_regs[code[3+num_elems]];
 
-    lv->num_values = num_elems;
-    lv->elems = elems;
+    lily_list_val *lv;
+    int i;
 
+    /* Only Lists can be packed, since the values of a Tuple may differ. */
     if (code[0] == o_build_list)
-        lily_move_list_f(MOVE_DEREF_SPECULATIVE, result, lv);
+        lv = lily_new_list_of(num_elems,
+                num_elems ? &vm_regs[code[3]] : NULL);
     else
-        lily_move_tuple_f(MOVE_DEREF_SPECULATIVE, result, lv);
+        lv = lily_new_list_of(num_elems, NULL);
 
-    int i;
     for (i = 0;i < num_elems;i++) {
-        lily_value *rhs_reg = vm_regs[code[3+i]];
-        elems[i] = lily_copy_value(rhs_reg);
+        lily_value *rhs_reg = &vm_regs[code[3+i]];
+        lily_list_init_elem(lv, i, rhs_reg);
     }
+
+    /* This is done last, since the result may be one of the elements. */
+    if (code[0] == o_build_list)
+        lily_move_list_f(MOVE_DEREF_SPECULATIVE, result, lv);
+    else
+        lily_move_tuple_f(MOVE_DEREF_SPECULATIVE, result, lv);
 }
 
 static void do_o_build_enum(lily_vm_state *vm, uint16_t *code)
 {
-    lily_value **vm_regs = vm->vm_regs;
+    lily_value *vm_regs = vm->vm_regs;
     int instance_id = code[2];
     int variant_id = code[3];
     int num_values = code[4];
-    lily_value *result = vm_regs[code[code[4] + 5]];
+    lily_value *result = &vm_regs[code[code[4] + 5]];
 
-    lily_instance_val *ival = lily_new_instance_val();
-    lily_value **slots = lily_malloc(num_values * sizeof(lily_value *));
-    ival->num_values = num_values;
-    ival->values = slots;
+    lily_instance_val *ival = lily_new_instance_val(num_values);
+    lily_value *slots = ival->values;
     ival->variant_id = variant_id;
     ival->instance_id = instance_id;
 
-    lily_move_enum_f(MOVE_DEREF_SPECULATIVE, result, ival);
-
     int i;
     for (i = 0;i < num_values;i++) {
-        lily_value *rhs_reg = vm_regs[code[5+i]];
-        slots[i] = lily_copy_value(rhs_reg);
+        lily_value *rhs_reg = &vm_regs[code[5+i]];
+        lily_init_value(&slots[i], rhs_reg);
     }
+
+    /* This is done last, since the result may be one of the values. */
+    lily_move_enum_f(MOVE_DEREF_SPECULATIVE, result, ival);
 }
 
 /* This raises a user-defined exception. The emitter has verified that the thing
@@ -1012,7 +1447,7 @@ static void do_o_raise(lily_vm_state *vm, lily_value *exception_val)
        container for traceback. */
 
     lily_instance_val *ival = exception_val->value.instance;
-    char *message = ival->values[0]->value.string->string;
+    char *message = ival->values[0].value.string->string;
     lily_class *raise_cls = vm->class_table[ival->instance_id];
 
     /* There's no need for a ref/deref here, because the gc cannot trigger
@@ -1028,13 +1463,13 @@ static void do_o_raise(lily_vm_state *vm, lily_value *exception_val)
    This is done outside of the vm's main loop because it's not common. */
 static int do_o_optarg_dispatch(lily_vm_state *vm, uint16_t *code)
 {
-    lily_value **vm_regs = vm->vm_regs;
+    lily_value *vm_regs = vm->vm_regs;
     uint16_t first_spot = code[1];
     int count = code[2] - 1;
     unsigned int i;
 
     for (i = 0;i < count;i++) {
-        lily_value *reg = vm_regs[first_spot - i];
+        lily_value *reg = &vm_regs[first_spot - i];
         if (reg->flags)
             break;
     }
@@ -1049,15 +1484,15 @@ static int do_o_optarg_dispatch(lily_vm_state *vm, uint16_t *code)
    opcode as a way of deducing what to do with the newly-made instance. */
 static void do_o_new_instance(lily_vm_state *vm, uint16_t *code)
 {
-    int i, total_entries;
+    int total_entries;
     int cls_id = code[2];
-    lily_value **vm_regs = vm->vm_regs;
-    lily_value *result = vm_regs[code[3]];
+    lily_value *vm_regs = vm->vm_regs;
+    lily_value *result = &vm_regs[code[3]];
     lily_class *instance_class = vm->class_table[cls_id];
 
     total_entries = instance_class->prop_count;
 
-    lily_call_frame *caller_frame = vm->call_chain->prev;
+    lily_call_frame *caller_frame = vm->call_chain - 1;
 
     /* Check to see if the caller is in the process of building a subclass
        of this value. If that is the case, then use that instance instead of
@@ -1074,13 +1509,7 @@ static void do_o_new_instance(lily_vm_state *vm, uint16_t *code)
         }
     }
 
-    lily_instance_val *iv = lily_malloc(sizeof(lily_instance_val));
-    lily_value **iv_values = lily_malloc(total_entries * sizeof(lily_value *));
-
-    iv->num_values = -1;
-    iv->refcount = 1;
-    iv->values = iv_values;
-    iv->gc_entry = NULL;
+    lily_instance_val *iv = lily_new_instance_val(total_entries);
     iv->instance_id = cls_id;
 
     if (code[0] == o_new_instance_speculative)
@@ -1091,11 +1520,6 @@ static void do_o_new_instance(lily_vm_state *vm, uint16_t *code)
             lily_tag_value(vm, result);
     }
 
-    for (i = 0;i < total_entries;i++)
-        iv->values[i] = lily_new_empty_value();
-
-    iv->num_values = total_entries;
-
     /* This is set so that a superclass .new can simply pull this instance,
        since this instance will have >= the # of types. */
     vm->call_chain->build_value = result;
@@ -1103,28 +1527,28 @@ static void do_o_new_instance(lily_vm_state *vm, uint16_t *code)
 
 void do_o_interpolation(lily_vm_state *vm, uint16_t *code)
 {
-    lily_value **vm_regs = vm->vm_regs;
+    lily_value *vm_regs = vm->vm_regs;
     int count = code[2];
     lily_msgbuf *vm_buffer = vm->vm_buffer;
     lily_msgbuf_flush(vm_buffer);
 
     int i;
     for (i = 0;i < count;i++) {
-        lily_value *v = vm_regs[code[3 + i]];
+        lily_value *v = &vm_regs[code[3 + i]];
         lily_vm_add_value_to_msgbuf(vm, vm_buffer, v);
     }
 
-    lily_value *result_reg = vm_regs[code[3 + i]];
+    lily_value *result_reg = &vm_regs[code[3 + i]];
 
     lily_move_string(result_reg, lily_new_raw_string(vm_buffer->message));
 }
 
 void do_o_dynamic_cast(lily_vm_state *vm, uint16_t *code)
 {
-    lily_value **vm_regs = vm->vm_regs;
+    lily_value *vm_regs = vm->vm_regs;
     lily_class *cast_class = vm->class_table[code[2]];
-    lily_value *rhs_reg = vm_regs[code[3]];
-    lily_value *lhs_reg = vm_regs[code[4]];
+    lily_value *rhs_reg = &vm_regs[code[3]];
+    lily_value *lhs_reg = &vm_regs[code[4]];
 
     lily_value *inner = rhs_reg->value.dynamic->inner_value;
 
@@ -1175,7 +1599,7 @@ void do_o_dynamic_cast(lily_vm_state *vm, uint16_t *code)
    value is given a ref increase. */
 static lily_value *make_cell_from(lily_value *value)
 {
-    lily_value *result = lily_malloc(sizeof(lily_value));
+    lily_value *result = lily_malloc_fixed(sizeof(lily_value));
     *result = *value;
     result->cell_refcount = 1;
     if (value->flags & VAL_IS_DEREFABLE)
@@ -1189,38 +1613,30 @@ static lily_value *make_cell_from(lily_value *value)
 static lily_value **do_o_create_closure(lily_vm_state *vm, uint16_t *code)
 {
     int count = code[2];
-    lily_value *result = vm->vm_regs[code[3]];
+    lily_value *result = &vm->vm_regs[code[3]];
 
     lily_function_val *last_call = vm->call_chain->function;
 
-    lily_function_val *closure_func = lily_new_function_copy(last_call);
-
-    lily_value **upvalues = lily_malloc(sizeof(lily_value *) * count);
-
     /* Cells are initially NULL so that o_set_upvalue knows to copy a new value
        into a cell. */
-    int i;
-    for (i = 0;i < count;i++)
-        upvalues[i] = NULL;
-
-    closure_func->num_upvalues = count;
-    closure_func->upvalues = upvalues;
-    closure_func->refcount = 1;
+    lily_function_val *closure_func = lily_new_function_copy(last_call, count);
 
     lily_move_function_f(MOVE_DEREF_NO_GC, result, closure_func);
     lily_tag_value(vm, result);
 
-    return upvalues;
+    return closure_func->upvalues;
 }
 
-/* This copies cells from 'source' to 'target'. Cells that exist are given a
-   cell_refcount bump. */
-static void copy_upvalues(lily_function_val *target, lily_function_val *source)
+/* This makes a copy of 'target' that shares the cells of 'source'. Cells that
+   exist are given a cell_refcount bump. */
+static lily_function_val *copy_with_upvalues(lily_function_val *target,
+        lily_function_val *source)
 {
     lily_value **source_upvalues = source->upvalues;
     int count = source->num_upvalues;
 
-    lily_value **new_upvalues = lily_malloc(sizeof(lily_value *) * count);
+    lily_function_val *result = lily_new_function_copy(target, count);
+    lily_value **new_upvalues = result->upvalues;
     lily_value *up;
     int i;
 
@@ -1232,28 +1648,30 @@ static void copy_upvalues(lily_function_val *target, lily_function_val *source)
         new_upvalues[i] = up;
     }
 
-    target->upvalues = new_upvalues;
-    target->num_upvalues = count;
+    return result;
 }
 
 /* This opcode will create a copy of a given function that pulls upvalues from
    the specified closure. */
 static void do_o_create_function(lily_vm_state *vm, uint16_t *code)
 {
-    lily_value **vm_regs = vm->vm_regs;
-    lily_value *input_closure_reg = vm_regs[code[1]];
+    lily_value *vm_regs = vm->vm_regs;
+    lily_value *input_closure_reg = &vm_regs[code[1]];
 
     lily_tie *target_literal = vm->readonly_table[code[2]];
     lily_function_val *target_func = target_literal->value.function;
 
-    lily_value *result_reg = vm_regs[code[3]];
-    lily_function_val *new_closure = lily_new_function_copy(target_func);
-    new_closure->refcount = 1;
-
-    copy_upvalues(new_closure, input_closure_reg->value.function);
+    lily_value *result_reg = &vm_regs[code[3]];
+    lily_function_val *new_closure = copy_with_upvalues(target_func,
+            input_closure_reg->value.function);
 
     lily_move_function_f(MOVE_DEREF_SPECULATIVE, result_reg, new_closure);
-    lily_tag_value(vm, result_reg);
+
+    /* The emitter knows that a local function is only handed to a builtin
+       that won't keep it. Refcounting is enough to clean it up, so it isn't
+       given to the gc. */
+    if (code[0] == o_create_function)
+        lily_tag_value(vm, result_reg);
 }
 
 /* This is written at the top of a define that uses a closure (unless that
@@ -1285,21 +1703,28 @@ static lily_value **do_o_load_closure(lily_vm_state *vm, uint16_t *code)
             up->cell_refcount--;
             if (up->cell_refcount == 0) {
                 lily_deref(up);
-                lily_free(up);
+                lily_free_fixed(up, sizeof(lily_value));
             }
 
             upvalues[code[i]] = NULL;
         }
     }
 
-    lily_value *result_reg = vm->vm_regs[code[i]];
+    lily_value *result_reg = &vm->vm_regs[code[i]];
 
     input_closure->refcount++;
 
-    /* Closures are always tagged. Do this as a custom move, because this is,
-       so far, the only scenario where a move needs to mark a tagged value. */
-    lily_move_function_f(VAL_IS_DEREFABLE | VAL_IS_GC_TAGGED, result_reg,
-            input_closure);
+    /* Closures are tagged unless they were made by o_create_local_function.
+       Do this as a custom move, because this is, so far, the only scenario
+       where a move needs to mark a tagged value. */
+    uint32_t move_flags = VAL_IS_DEREFABLE;
+
+    if (input_closure->gc_entry)
+        move_flags |= VAL_IS_GC_TAGGED;
+    else
+        move_flags |= VAL_IS_GC_SPECULATIVE;
+
+    lily_move_function_f(move_flags, result_reg, input_closure);
 
     return input_closure->upvalues;
 }
@@ -1312,12 +1737,11 @@ static lily_value **do_o_load_class_closure(lily_vm_state *vm, uint16_t *code,
         int code_pos)
 {
     do_o_get_property(vm, code, code_pos);
-    lily_value *result_reg = vm->vm_regs[code[code_pos + 4]];
+    lily_value *result_reg = &vm->vm_regs[code[code_pos + 4]];
     lily_function_val *input_closure = result_reg->value.function;
 
-    lily_function_val *new_closure = lily_new_function_copy(input_closure);
-    new_closure->refcount = 1;
-    copy_upvalues(new_closure, input_closure);
+    lily_function_val *new_closure = copy_with_upvalues(input_closure,
+            input_closure);
 
     lily_move_function_f(MOVE_DEREF_SPECULATIVE, result_reg, new_closure);
 
@@ -1347,7 +1771,7 @@ static lily_list_val *build_traceback_raw(lily_vm_state *vm)
 {
     lily_list_val *lv = lily_new_list_val();
 
-    lv->elems = lily_malloc(vm->call_depth * sizeof(lily_value *));
+    lv->elems = lily_malloc(vm->call_depth * sizeof(lily_value));
     lv->num_values = -1;
     lily_call_frame *frame_iter;
 
@@ -1358,7 +1782,7 @@ static lily_list_val *build_traceback_raw(lily_vm_state *vm)
        nothing in this loop can trigger the gc. */
     for (i = vm->call_depth, frame_iter = vm->call_chain;
          i >= 1;
-         i--, frame_iter = frame_iter->prev) {
+         i--, frame_iter--) {
         lily_function_val *func_val = frame_iter->function;
         char *path;
         char line[16] = "";
@@ -1389,7 +1813,9 @@ static lily_list_val *build_traceback_raw(lily_vm_state *vm)
         sprintf(str, "%s:%s from %s%s%s", path, line, class_name, separator,
                 name);
 
-        lv->elems[i - 1] = lily_new_string_take(str);
+        lv->elems[i - 1].flags = 0;
+        lily_move_string(&lv->elems[i - 1], lily_new_raw_string(str));
+        lily_free(str);
     }
 
     lv->num_values = vm->call_depth;
@@ -1403,25 +1829,15 @@ static lily_list_val *build_traceback_raw(lily_vm_state *vm)
 static void make_proper_exception_val(lily_vm_state *vm,
         lily_class *raised_cls, lily_value *result)
 {
-    lily_instance_val *ival = lily_malloc(sizeof(lily_instance_val));
-
-    ival->values = lily_malloc(2 * sizeof(lily_value *));
-    ival->num_values = -1;
-    ival->refcount = 1;
-    ival->gc_entry = NULL;
+    lily_instance_val *ival = lily_new_instance_val(2);
     ival->instance_id = raised_cls->id;
 
-    lily_value *message_val = lily_new_string(vm->raiser->msgbuf->message);
-
+    lily_move_string(&ival->values[0],
+            lily_new_raw_string(vm->raiser->msgbuf->message));
     lily_msgbuf_flush(vm->raiser->msgbuf);
-    ival->values[0] = message_val;
-    ival->num_values = 1;
 
-    lily_value *traceback = lily_new_empty_value();
-    lily_move_list_f(MOVE_DEREF_NO_GC, traceback, build_traceback_raw(vm));
-
-    ival->values[1] = traceback;
-    ival->num_values = 2;
+    lily_move_list_f(MOVE_DEREF_NO_GC, &ival->values[1],
+            build_traceback_raw(vm));
 
     lily_move_instance_f(MOVE_DEREF_SPECULATIVE, result, ival);
 }
@@ -1435,107 +1851,113 @@ static void fixup_exception_val(lily_vm_state *vm, lily_value *result)
     lily_list_val *raw_trace = build_traceback_raw(vm);
     lily_instance_val *iv = result->value.instance;
 
-    lily_move_list_f(MOVE_DEREF_SPECULATIVE, iv->values[1], raw_trace);
+    lily_move_list_f(MOVE_DEREF_SPECULATIVE, &iv->values[1], raw_trace);
 }
 
-/* This attempts to catch the exception that the raiser currently holds. If it
-   succeeds, then the vm's state is updated and the exception is cleared out.
-
-   This function will refuse to catch exceptions that are not on the current
-   internal lily_vm_execute depth. This is so that the vm will return out. To do
-   otherwise leaves the vm thinking it is N levels deep but being, say, N - 2
-   levels deep.
-
-   Returns 1 if the exception has been caught, 0 otherwise. */
-static int maybe_catch_exception(lily_vm_state *vm)
+/* This searches the try table of the frame's function for an except clause
+   that will take 'raised_cls'. Frames that made a call have code_pos after the
+   call, and a frame that raised has code_pos inside the opcode that raised.
+   Either way, code_pos is after the start of the opcode but not past the end of
+   the try. Inner try blocks are first in the table, so they're tried first.
+   Returns the position of the except clause, or 0 if there isn't one. */
+static int find_except(lily_vm_state *vm, lily_call_frame *frame,
+        lily_class *raised_cls)
 {
-    lily_class *raised_cls = vm->raiser->exception_cls;
-
-    /* The catch entry pointer is always one spot ahead of the last entry that
-       was inserted. So this is safe. */
-    if (vm->catch_chain->prev == NULL)
-        return 0;
-
-    lily_jump_link *raiser_jump = vm->raiser->all_jumps;
+    lily_function_val *f = frame->function;
+    uint16_t *table = f->try_table;
+    uint16_t *code = f->code;
+    int pos = frame->code_pos;
+    uint32_t i;
 
-    lily_vm_catch_entry *catch_iter = vm->catch_chain->prev;
-    lily_value *catch_reg = NULL;
-    lily_value **stack_regs;
-    int do_unbox, jump_location, match;
+    for (i = 0;i < f->try_count * 3;i += 3) {
+        if (pos <= table[i] || pos > table[i + 1])
+            continue;
 
-    match = 0;
-
-    while (catch_iter != NULL) {
-        /* It's extremely important that the vm not attempt to catch exceptions
-           that were not made in the same jump level. If it does, the vm could
-           be called from a foreign function, but think it isn't. */
-        if (catch_iter->jump_entry != raiser_jump) {
-            vm->catch_chain = catch_iter->next;
-            break;
-        }
-
-        lily_call_frame *call_frame = catch_iter->call_frame;
-        uint16_t *code = call_frame->function->code;
         /* A try block is done when the next jump is at 0 (because 0 would
            always be going back, which is illogical otherwise). */
-        jump_location = code[catch_iter->code_pos];
-        stack_regs = vm->regs_from_main + catch_iter->offset_from_main;
+        int jump_location = table[i + 2];
 
         while (jump_location != 0) {
             lily_class *catch_class = vm->class_table[code[jump_location + 2]];
 
-            if (lily_class_greater_eq(catch_class, raised_cls)) {
-                /* There are two exception opcodes:
-                 * o_except_catch will have #4 as a valid register, and is
-                   interested in having that register filled with data later on.
-                 * o_except_ignore doesn't care, so #4 is always 0. Having it as
-                   zero allows catch_reg do not need a condition check, since
-                   stack_regs[0] is always safe. */
-                do_unbox = code[jump_location] == o_except_catch;
-
-                catch_reg = stack_regs[code[jump_location + 3]];
-
-                /* ...So that execution resumes from within the except block. */
-                jump_location += 5;
-                match = 1;
-                break;
-            }
-            else
-                jump_location = code[jump_location + 4];
+            if (lily_class_greater_eq(catch_class, raised_cls))
+                return jump_location;
+
+            jump_location = code[jump_location + 4];
         }
+    }
 
-        if (match)
-            break;
+    return 0;
+}
+
+/* This attempts to catch the exception that the raiser currently holds. If it
+   succeeds, then the vm's state is updated and the exception is cleared out.
 
-        catch_iter = catch_iter->prev;
+   The frames that the current lily_vm_execute is running are searched, from
+   the most recent one down to the one it started with. Nothing past that is
+   searched, so that the vm will return out. To do otherwise leaves the vm
+   thinking it is N levels deep but being, say, N - 2 levels deep.
+
+   Returns 1 if the exception has been caught, 0 otherwise. */
+static int maybe_catch_exception(lily_vm_state *vm, lily_vm_catch_base *base)
+{
+    lily_class *raised_cls = vm->raiser->exception_cls;
+    lily_call_frame *base_frame = vm->call_frames + base->frame_index;
+    lily_call_frame *frame = base_frame;
+    lily_value *stack_regs = vm->regs_from_main + base->regs_offset;
+    int jump_location;
+
+    /* Native calls put the registers of the callee right after the caller's.
+       Walk up to the last of them to figure out where each frame's registers
+       are. */
+    while (frame != vm->call_chain &&
+           (frame + 1)->function->code != NULL) {
+        stack_regs += frame->regs_used;
+        frame++;
     }
 
-    if (match) {
-        if (do_unbox) {
-            /* There is a var that the exception needs to be dropped into. If
-               this exception was triggered by raise, then use that (after
-               dumping traceback into it). If not, create a new instance to
-               hold the info. */
-            if (vm->exception_value)
-                fixup_exception_val(vm, catch_reg);
-            else
-                make_proper_exception_val(vm, raised_cls, catch_reg);
-        }
+    while (1) {
+        jump_location = find_except(vm, frame, raised_cls);
+        if (jump_location != 0)
+            break;
+
+        if (frame == base_frame)
+            return 0;
+
+        frame--;
+        stack_regs -= frame->regs_used;
+    }
 
-        /* Make sure any exception value that was held is gone. No ref/deref is
-           necessary, because the value was saved somewhere in a register. */
-        vm->exception_value = NULL;
-        vm->call_chain = catch_iter->call_frame;
-        vm->call_depth = catch_iter->call_frame_depth;
-        vm->vm_list->pos = catch_iter->vm_list_pos;
-        vm->vm_regs = stack_regs;
-        vm->call_chain->code_pos = jump_location;
-        /* Each try block can only successfully handle one exception, so use
-           ->prev to prevent using the same block again. */
-        vm->catch_chain = catch_iter;
+    uint16_t *code = frame->function->code;
+
+    /* There are two exception opcodes:
+     * o_except_catch will have #4 as a valid register, and is interested in
+       having that register filled with data later on.
+     * o_except_ignore doesn't care, so there's nothing to do. */
+    if (code[jump_location] == o_except_catch) {
+        lily_value *catch_reg = &stack_regs[code[jump_location + 3]];
+
+        /* There is a var that the exception needs to be dropped into. If this
+           exception was triggered by raise, then use that (after dumping
+           traceback into it). If not, create a new instance to hold the
+           info. */
+        if (vm->exception_value)
+            fixup_exception_val(vm, catch_reg);
+        else
+            make_proper_exception_val(vm, raised_cls, catch_reg);
     }
 
-    return match;
+    /* Make sure any exception value that was held is gone. No ref/deref is
+       necessary, because the value was saved somewhere in a register. */
+    vm->exception_value = NULL;
+    vm->call_chain = frame;
+    vm->call_depth = base->call_depth + (uint32_t)(frame - base_frame);
+    drop_vm_list_values(vm, base->vm_list_pos);
+    vm->vm_regs = stack_regs;
+    /* ...So that execution resumes from within the except block. */
+    frame->code_pos = jump_location + 5;
+
+    return 1;
 }
 
 /***
@@ -1561,18 +1983,36 @@ static int maybe_catch_exception(lily_vm_state *vm)
    has installed a jump. This function may also cause vm->vm_regs to be
    realloc'd, thus invalidating any cached copy of vm->vm_regs.
 
+   Since registers are stored inline, 'call_val' and the values passed may be
+   registers that a previous call moved. The target is only read from
+   'call_val' on the first call, and values within the registers are rebased if
+   the registers grow here.
+
    The result of this function is the register that the function's value
    returned to, or NULL if there was no returned value. */
 lily_value *lily_foreign_call(lily_vm_state *vm, int *cached,
          int need_result, lily_value *call_val, int num_values, ...)
 {
-    lily_function_val *target = call_val->value.function;
+    lily_function_val *target;
+    lily_value *old_regs = vm->regs_from_main;
+    int old_reg_count = vm->true_max_registers;
+
+    /* A cached call has already set up the frame after this one. */
+    if (*cached == 0 && vm->call_chain + 1 == vm->call_frames_end)
+        grow_call_frames(vm);
+
     lily_call_frame *calling_frame = vm->call_chain;
+
+    if (*cached == 0)
+        target = call_val->value.function;
+    else
+        target = (calling_frame + 1)->function;
+
     int is_native_target = (target->foreign_func == NULL);
     int target_need;
     int register_need;
     /* Don't set this just yet: grow_vm_registers may move it. */
-    lily_value **vm_regs;
+    lily_value *vm_regs;
     lily_value *return_reg;
 
     if (is_native_target)
@@ -1590,37 +2030,16 @@ lily_value *lily_foreign_call(lily_vm_state *vm, int *cached,
        going to put the vm in another function, that increase has to be done.
        This local copy of vm_regs will have [0] set to target the caller's one
        spare register. */
-    vm_regs = vm->vm_regs + calling_frame->prev->regs_used;
-
-    if (need_result) {
-        return_reg = vm_regs[0];
-
-        if (return_reg->flags & VAL_IS_DEREFABLE)
-            lily_deref(return_reg);
-
-        return_reg->flags = 0;
-    }
-    else
-        return_reg = NULL;
+    vm_regs = vm->vm_regs + (calling_frame - 1)->regs_used;
 
     if (*cached == 0) {
-        lily_call_frame *caller_frame = vm->call_chain;
-        caller_frame->code = foreign_code;
-        caller_frame->code_pos = 0;
-        caller_frame->return_target = vm_regs[0];
-        caller_frame->build_value = NULL;
-        caller_frame->line_num = 0;
-
-        if (caller_frame->next == NULL) {
-            add_call_frame(vm);
-            /* The vm's call chain automatically advances when add_call_frame is
-               used. That's useful for the vm, but not here. Rewind the frame
-               back so that every invocation of this call will have the same
-               call_chain. */
-            vm->call_chain = caller_frame;
-        }
+        calling_frame->code = foreign_code;
+        calling_frame->code_pos = 0;
+        calling_frame->return_target = &vm_regs[0];
+        calling_frame->build_value = NULL;
+        calling_frame->line_num = 0;
 
-        lily_call_frame *target_frame = caller_frame->next;
+        lily_call_frame *target_frame = calling_frame + 1;
         target_frame->code = target->code;
         target_frame->code_pos = 0;
         target_frame->regs_used = target_need;
@@ -1641,20 +2060,37 @@ lily_value *lily_foreign_call(lily_vm_state *vm, int *cached,
     int i;
     for (i = 0;i < num_values;i++) {
         lily_value *v = va_arg(values, lily_value *);
-        if (vm_regs[i]->flags & VAL_IS_DEREFABLE)
-            lily_deref(vm_regs[i]);
+        if (old_regs != vm->regs_from_main)
+            v = rebase_register(v, old_regs, old_reg_count,
+                    vm->regs_from_main);
+
+        if (vm_regs[i].flags & VAL_IS_DEREFABLE)
+            lily_deref(&vm_regs[i]);
         if (v->flags & VAL_IS_DEREFABLE)
             v->value.generic->refcount++;
 
-        *vm_regs[i] = *v;
+        vm_regs[i] = *v;
     }
     va_end(values);
 
+    /* This is done after reading the values, because a value may be the result
+       of a previous call (List.fold does this). */
+    if (need_result) {
+        return_reg = vm_regs - 1;
+
+        if (return_reg->flags & VAL_IS_DEREFABLE)
+            lily_deref(return_reg);
+
+        return_reg->flags = 0;
+    }
+    else
+        return_reg = NULL;
+
     if (is_native_target && i != target->reg_count)
         scrub_registers(vm, target, i);
 
     vm->vm_regs = vm_regs;
-    vm->call_chain = vm->call_chain->next;
+    vm->call_chain++;
     vm->num_registers += target_need;
     *cached = 1;
 
@@ -1670,17 +2106,126 @@ lily_value *lily_foreign_call(lily_vm_state *vm, int *cached,
         target->foreign_func(vm, num_values + 1, foreign_call_stack);
         /* The values set above need to be manually scaled back because foreign
            functions assume the vm will do it for them. */
-        vm->call_chain = vm->call_chain->prev;
+        vm->call_chain--;
         vm->num_registers -= target_need;
     }
 
     /* Don't do "vm->vm_regs = vm_regs", because the target may have caused the
-       registers to have reallocated. */
-    vm->vm_regs -= vm->call_chain->prev->regs_used;
+       registers to have reallocated. The frames may have moved too, so use
+       vm->call_chain (which is back at the calling frame) instead of
+       calling_frame. */
+    calling_frame = vm->call_chain;
+    vm->vm_regs -= (calling_frame - 1)->regs_used;
+
+    /* For the same reason, find the return register again. */
+    if (return_reg)
+        return_reg = vm->vm_regs + (calling_frame - 1)->regs_used;
 
     return return_reg;
 }
 
+/* This sets up 'call' to run the function within 'call_val' with 'num_args'
+   arguments. If the result of the calls is needed, then 'need_result' should be
+   1.
+   This does the setup that lily_foreign_call does on the first call: The frames
+   for the call are written down, and the registers are grown to fit the target.
+   Since the registers are grown here, 'call_val' and any register pointers the
+   caller has are invalid after this. */
+void lily_prepare_call(lily_vm_state *vm, lily_prepared_call *call,
+        lily_value *call_val, int num_args, int need_result)
+{
+    lily_function_val *target = call_val->value.function;
+    int target_need;
+
+    if (vm->call_chain + 1 == vm->call_frames_end)
+        grow_call_frames(vm);
+
+    if (target->foreign_func == NULL)
+        target_need = target->reg_count;
+    else
+        target_need = num_args;
+
+    int register_need = vm->num_registers + target_need + need_result;
+
+    if (vm->num_registers + register_need > vm->offset_max_registers)
+        grow_vm_registers(vm, register_need);
+
+    lily_call_frame *calling_frame = vm->call_chain;
+    /* [0] is the caller's spare register, same as with lily_foreign_call. */
+    lily_value *vm_regs = vm->vm_regs + (calling_frame - 1)->regs_used;
+
+    calling_frame->code = foreign_code;
+    calling_frame->code_pos = 0;
+    calling_frame->return_target = &vm_regs[0];
+    calling_frame->build_value = NULL;
+    calling_frame->line_num = 0;
+
+    lily_call_frame *target_frame = calling_frame + 1;
+    target_frame->code = target->code;
+    target_frame->code_pos = 0;
+    target_frame->regs_used = target_need;
+    target_frame->function = target;
+    target_frame->line_num = 0;
+    target_frame->build_value = NULL;
+
+    call->target = target;
+    call->return_offset = vm_regs - vm->regs_from_main;
+    call->num_args = num_args;
+    call->need_result = need_result;
+    call->target_need = target_need;
+}
+
+/* This returns the register that argument 'index' of 'call' goes into. The
+   registers may move during a call, so this should be fetched again for each
+   call. Values are put into these registers with lily_assign_value (or any
+   of the moves), which takes care of whatever the last call left behind. */
+lily_value *lily_prepared_arg(lily_vm_state *vm, lily_prepared_call *call,
+        int index)
+{
+    return vm->regs_from_main + call->return_offset + 1 + index;
+}
+
+/* This runs 'call' using whatever is in the argument registers. The result is
+   the same as what lily_foreign_call would give: The return register, or NULL
+   if the result isn't needed. */
+lily_value *lily_call_prepared(lily_vm_state *vm, lily_prepared_call *call)
+{
+    lily_function_val *target = call->target;
+    lily_value *return_reg = vm->regs_from_main + call->return_offset;
+
+    if (call->need_result) {
+        if (return_reg->flags & VAL_IS_DEREFABLE)
+            lily_deref(return_reg);
+
+        return_reg->flags = 0;
+    }
+
+    if (target->foreign_func == NULL && call->num_args != target->reg_count)
+        scrub_registers(vm, target, call->num_args);
+
+    vm->vm_regs = return_reg + 1;
+    vm->call_chain++;
+    vm->num_registers += call->target_need;
+
+    if (target->code) {
+        vm->call_depth++;
+        lily_vm_execute(vm);
+    }
+    else {
+        vm->vm_regs--;
+        target->foreign_func(vm, call->num_args + 1, foreign_call_stack);
+        vm->call_chain--;
+        vm->num_registers -= call->target_need;
+    }
+
+    vm->vm_regs -= (vm->call_chain - 1)->regs_used;
+
+    if (call->need_result == 0)
+        return NULL;
+
+    return vm->regs_from_main + call->return_offset;
+}
+
 /* This ensures that the vm's vm_list (temporary value storage) will have at
    least 'need' extra slots available. */
 void lily_vm_list_ensure(lily_vm_state *vm, uint32_t need)
@@ -1691,8 +2236,23 @@ void lily_vm_list_ensure(lily_vm_state *vm, uint32_t need)
             vm_list->size *= 2;
 
         vm_list->values = lily_realloc(vm_list->values,
-                sizeof(lily_value *) * vm_list->size);
+                sizeof(lily_value) * vm_list->size);
+    }
+}
+
+/* This returns the siphash of a string, computing it only if the string does
+   not have it saved yet. Every string hashed by an interpreter must use the same
+   sipkey. */
+uint64_t lily_string_siphash(lily_string_val *sv, const char *sipkey)
+{
+    uint64_t key_hash = sv->siphash;
+
+    if (key_hash == 0) {
+        key_hash = siphash24(sv->string, sv->size, sipkey);
+        sv->siphash = key_hash;
     }
+
+    return key_hash;
 }
 
 /* This calculates a siphash for a given hash value. The siphash is based off of
@@ -1704,8 +2264,7 @@ uint64_t lily_siphash(lily_vm_state *vm, lily_value *key)
     uint64_t key_hash;
 
     if (flags & VAL_IS_STRING)
-        key_hash = siphash24(key->value.string->string,
-                key->value.string->size, vm->sipkey);
+        key_hash = lily_string_siphash(key->value.string, vm->sipkey);
     else if (flags & VAL_IS_INTEGER)
         key_hash = key->value.integer;
     else /* Should not happen, because no other classes are valid keys. */
@@ -1726,17 +2285,20 @@ static void add_list_like(lily_vm_state *vm, lily_msgbuf *msgbuf, tag *t,
         lily_value *v, const char *prefix, const char *suffix)
 {
     lily_list_val *lv = v->value.list;
+    lily_value scratch;
     lily_msgbuf_add(msgbuf, prefix);
 
     /* This is necessary because num_values is unsigned. */
     if (lv->num_values != 0) {
         int i;
         for (i = 0;i < lv->num_values - 1;i++) {
-            add_value_to_msgbuf(vm, msgbuf, t, lv->elems[i]);
+            add_value_to_msgbuf(vm, msgbuf, t,
+                    lily_list_get_elem(lv, i, &scratch));
             lily_msgbuf_add(msgbuf, ", ");
         }
         if (i != lv->num_values)
-            add_value_to_msgbuf(vm, msgbuf, t, lv->elems[i]);
+            add_value_to_msgbuf(vm, msgbuf, t,
+                    lily_list_get_elem(lv, i, &scratch));
     }
 
     lily_msgbuf_add(msgbuf, suffix);
@@ -1799,15 +2361,21 @@ static void add_value_to_msgbuf(lily_vm_state *vm, lily_msgbuf *msgbuf,
     else if (v->flags & VAL_IS_HASH) {
         lily_hash_val *hv = v->value.hash;
         lily_msgbuf_add_char(msgbuf, '[');
-        lily_hash_elem *elem = hv->elem_chain;
-        while (elem) {
-            add_value_to_msgbuf(vm, msgbuf, t, elem->elem_key);
-            lily_msgbuf_add(msgbuf, " => ");
-            add_value_to_msgbuf(vm, msgbuf, t, elem->elem_value);
-            if (elem->next != NULL)
+        int i, first = 1;
+
+        /* Elements are shown from newest to oldest. */
+        for (i = (int)hv->elem_count - 1;i >= 0;i--) {
+            lily_hash_elem *elem = hv->elems + i;
+            if (elem->elem_key.flags == 0)
+                continue;
+
+            if (first == 0)
                 lily_msgbuf_add(msgbuf, ", ");
 
-            elem = elem->next;
+            add_value_to_msgbuf(vm, msgbuf, t, &elem->elem_key);
+            lily_msgbuf_add(msgbuf, " => ");
+            add_value_to_msgbuf(vm, msgbuf, t, &elem->elem_value);
+            first = 0;
         }
         lily_msgbuf_add_char(msgbuf, ']');
     }
@@ -1949,10 +2517,10 @@ static void load_foreign_ties(lily_vm_state *vm)
 {
     lily_foreign_tie *tie_iter = vm->symtab->foreign_ties;
     lily_foreign_tie *tie_next;
-    lily_value **regs_from_main = vm->regs_from_main;
+    lily_value *regs_from_main = vm->regs_from_main;
 
     while (tie_iter) {
-        lily_value *reg_value = regs_from_main[tie_iter->reg_spot];
+        lily_value *reg_value = &regs_from_main[tie_iter->reg_spot];
 
         /* Don't use regular assign, because this is transferring ownership. */
         lily_assign_value_noref(reg_value, &tie_iter->data);
@@ -1982,7 +2550,7 @@ static void maybe_fix_print(lily_vm_state *vm)
                for print to the safe one. */
             lily_tie *print_tie = vm->readonly_table[print_var->reg_spot];
             print_tie->value.function->foreign_func = builtin_stdout_print;
-            lily_value *stdout_reg = vm->regs_from_main[stdout_var->reg_spot];
+            lily_value *stdout_reg = &vm->regs_from_main[stdout_var->reg_spot];
             vm->stdout_reg = stdout_reg;
         }
     }
@@ -2044,176 +2612,318 @@ void lily_vm_prep(lily_vm_state *vm, lily_symtab *symtab)
  *
  */
 
-void lily_vm_execute(lily_vm_state *vm)
+/* This runs the code of the current frame, starting from where that frame left
+   off. It returns 0 when o_return_from_vm is reached. Exceptions jump out of
+   here and into lily_vm_execute, which comes back here if the exception was
+   caught. Keeping setjmp out of here lets the compiler keep the locals in
+   registers.
+   If a function with a try block is about to start and the current execute
+   has no jump link, this returns 1 instead. The function has been entered, so
+   calling this again starts it. */
+static int vm_run(lily_vm_state *vm)
 {
     uint16_t *code;
-    lily_value **regs_from_main;
-    lily_value **vm_regs;
+    lily_value *regs_from_main;
+    lily_value *vm_regs;
     int i, num_registers, offset_max_registers;
     register int64_t for_temp;
-    /* This unfortunately has to be volatile because otherwise calltrace() and
-       traceback tend to be 'off'. */
-    register volatile int code_pos;
+    register int code_pos;
     register lily_value *lhs_reg, *rhs_reg, *loop_reg, *step_reg;
     register lily_tie *readonly_val;
     lily_function_val *fval;
-    lily_value **upvalues = NULL;
+    lily_value **upvalues;
 
     lily_call_frame *current_frame = vm->call_chain;
-    code = current_frame->function->code;
+
+#ifdef LILY_COMPUTED_GOTO
+    static void *dispatch_table[] = {
+        [o_fast_assign]                = &&label_o_fast_assign,
+        [o_assign]                     = &&label_o_assign,
+        [o_integer_add]                = &&label_o_integer_add,
+        [o_integer_minus]              = &&label_o_integer_minus,
+        [o_modulo]                     = &&label_o_modulo,
+        [o_integer_mul]                = &&label_o_integer_mul,
+        [o_integer_div]                = &&label_o_integer_div,
+        [o_left_shift]                 = &&label_o_left_shift,
+        [o_right_shift]                = &&label_o_right_shift,
+        [o_bitwise_and]                = &&label_o_bitwise_and,
+        [o_bitwise_or]                 = &&label_o_bitwise_or,
+        [o_bitwise_xor]                = &&label_o_bitwise_xor,
+        [o_double_add]                 = &&label_o_double_add,
+        [o_double_minus]               = &&label_o_double_minus,
+        [o_double_mul]                 = &&label_o_double_mul,
+        [o_double_div]                 = &&label_o_double_div,
+        [o_is_equal]                   = &&label_o_is_equal,
+        [o_not_eq]                     = &&label_o_not_eq,
+        [o_less]                       = &&label_o_less,
+        [o_less_eq]                    = &&label_o_less_eq,
+        [o_greater]                    = &&label_o_greater,
+        [o_greater_eq]                 = &&label_o_greater_eq,
+        [o_integer_eq]                 = &&label_o_integer_eq,
+        [o_integer_not_eq]             = &&label_o_integer_not_eq,
+        [o_integer_less]               = &&label_o_integer_less,
+        [o_integer_less_eq]            = &&label_o_integer_less_eq,
+        [o_integer_greater]            = &&label_o_integer_greater,
+        [o_integer_greater_eq]         = &&label_o_integer_greater_eq,
+        [o_double_eq]                  = &&label_o_double_eq,
+        [o_double_not_eq]              = &&label_o_double_not_eq,
+        [o_double_less]                = &&label_o_double_less,
+        [o_double_less_eq]             = &&label_o_double_less_eq,
+        [o_double_greater]             = &&label_o_double_greater,
+        [o_double_greater_eq]          = &&label_o_double_greater_eq,
+        [o_string_eq]                  = &&label_o_string_eq,
+        [o_string_not_eq]              = &&label_o_string_not_eq,
+        [o_string_less]                = &&label_o_string_less,
+        [o_string_less_eq]             = &&label_o_string_less_eq,
+        [o_string_greater]             = &&label_o_string_greater,
+        [o_string_greater_eq]          = &&label_o_string_greater_eq,
+        [o_jump]                       = &&label_o_jump,
+        [o_jump_if]                    = &&label_o_jump_if,
+        [o_jump_if_integer_eq]         = &&label_o_jump_if_integer_eq,
+        [o_jump_if_integer_not_eq]     = &&label_o_jump_if_integer_not_eq,
+        [o_jump_if_integer_less]       = &&label_o_jump_if_integer_less,
+        [o_jump_if_integer_less_eq]    = &&label_o_jump_if_integer_less_eq,
+        [o_jump_if_integer_greater]    = &&label_o_jump_if_integer_greater,
+        [o_jump_if_integer_greater_eq] = &&label_o_jump_if_integer_greater_eq,
+        [o_jump_if_double_eq]          = &&label_o_jump_if_double_eq,
+        [o_jump_if_double_not_eq]      = &&label_o_jump_if_double_not_eq,
+        [o_jump_if_double_less]        = &&label_o_jump_if_double_less,
+        [o_jump_if_double_less_eq]     = &&label_o_jump_if_double_less_eq,
+        [o_jump_if_double_greater]     = &&label_o_jump_if_double_greater,
+        [o_jump_if_double_greater_eq]  = &&label_o_jump_if_double_greater_eq,
+        [o_foreign_call]               = &&label_o_foreign_call,
+        [o_native_call]                = &&label_o_native_call,
+        [o_function_call]              = &&label_o_function_call,
+        [o_return_val]                 = &&label_o_return_val,
+        [o_return_noval]               = &&label_o_return_noval,
+        [o_unary_not]                  = &&label_o_unary_not,
+        [o_unary_minus]                = &&label_o_unary_minus,
+        [o_build_list]                 = &&label_o_build_list,
+        [o_build_tuple]                = &&label_o_build_tuple,
+        [o_build_hash]                 = &&label_o_build_hash,
+        [o_build_enum]                 = &&label_o_build_enum,
+        [o_dynamic_cast]               = &&label_o_dynamic_cast,
+        [o_integer_for]                = &&label_o_integer_for,
+        [o_for_setup]                  = &&label_o_for_setup,
+        [o_get_item]                   = &&label_o_get_item,
+        [o_set_item]                   = &&label_o_set_item,
+        [o_get_packed_item]            = &&label_o_get_packed_item,
+        [o_set_packed_item]            = &&label_o_set_packed_item,
+        [o_get_global]                 = &&label_o_get_global,
+        [o_set_global]                 = &&label_o_set_global,
+        [o_get_readonly]               = &&label_o_get_readonly,
+        [o_get_integer]                = &&label_o_get_integer,
+        [o_get_boolean]                = &&label_o_get_boolean,
+        [o_get_property]               = &&label_o_get_property,
+        [o_set_property]               = &&label_o_set_property,
+        /* o_except_ignore and o_except_catch are always jumped over. */
+        [o_raise]                      = &&label_o_raise,
+        [o_new_instance_basic]         = &&label_o_new_instance_basic,
+        [o_new_instance_speculative]   = &&label_o_new_instance_speculative,
+        [o_new_instance_tagged]        = &&label_o_new_instance_tagged,
+        [o_optarg_dispatch]            = &&label_o_optarg_dispatch,
+        [o_match_dispatch]             = &&label_o_match_dispatch,
+        [o_variant_decompose]          = &&label_o_variant_decompose,
+        [o_get_upvalue]                = &&label_o_get_upvalue,
+        [o_set_upvalue]                = &&label_o_set_upvalue,
+        [o_create_closure]             = &&label_o_create_closure,
+        [o_create_function]            = &&label_o_create_function,
+        [o_create_local_function]      = &&label_o_create_local_function,
+        [o_load_class_closure]         = &&label_o_load_class_closure,
+        [o_load_closure]               = &&label_o_load_closure,
+        [o_interpolation]              = &&label_o_interpolation,
+        [o_return_from_vm]             = &&label_o_return_from_vm,
+    };
+#endif
 
     /* Initialize local vars from the vm state's vars. */
+    code = current_frame->code;
+    code_pos = current_frame->code_pos;
+    upvalues = current_frame->upvalues;
     vm_regs = vm->vm_regs;
     regs_from_main = vm->regs_from_main;
     offset_max_registers = vm->offset_max_registers;
-    code_pos = 0;
-
-    lily_jump_link *link = lily_jump_setup(vm->raiser);
-    if (setjmp(link->jump) != 0) {
-        /* If the current function is a native one, then fix the line
-           number of it. Otherwise, leave the line number alone. */
-        if (current_frame->function->code != NULL)
-            current_frame->line_num = current_frame->code[code_pos+1];
-
-        if (maybe_catch_exception(vm) == 0)
-            /* Couldn't catch it. Jump back into parser, which will jump
-               back to the caller to give them the bad news. */
-            lily_jump_back(vm->raiser);
-        else {
-            /* The exception was caught, so resync local data. */
-            current_frame = vm->call_chain;
-            code = current_frame->code;
-            code_pos = current_frame->code_pos;
-            upvalues = current_frame->upvalues;
-            regs_from_main = vm->regs_from_main;
-            vm_regs = vm->vm_regs;
-            vm->num_registers = (vm_regs - regs_from_main) + current_frame->regs_used;
-        }
-    }
-
     num_registers = vm->num_registers;
 
     while (1) {
-        switch(code[code_pos]) {
-            case o_fast_assign:
-                rhs_reg = vm_regs[code[code_pos+2]];
-                lhs_reg = vm_regs[code[code_pos+3]];
+        VM_DISPATCH {
+            VM_CASE(o_fast_assign):
+                rhs_reg = &vm_regs[code[code_pos+2]];
+                lhs_reg = &vm_regs[code[code_pos+3]];
                 lhs_reg->flags = rhs_reg->flags;
                 lhs_reg->value = rhs_reg->value;
                 code_pos += 4;
-                break;
-            case o_get_readonly:
+                VM_NEXT;
+            VM_CASE(o_get_readonly):
                 readonly_val = vm->readonly_table[code[code_pos+2]];
-                lhs_reg = vm_regs[code[code_pos+3]];
+                lhs_reg = &vm_regs[code[code_pos+3]];
 
                 lily_deref(lhs_reg);
 
                 lhs_reg->value = readonly_val->value;
                 lhs_reg->flags = readonly_val->move_flags;
                 code_pos += 4;
-                break;
-            case o_get_integer:
-                lhs_reg = vm_regs[code[code_pos+3]];
+                VM_NEXT;
+            VM_CASE(o_get_integer):
+                lhs_reg = &vm_regs[code[code_pos+3]];
                 lhs_reg->value.integer = (int16_t)code[code_pos+2];
                 lhs_reg->flags = VAL_IS_INTEGER;
                 code_pos += 4;
-                break;
-            case o_get_boolean:
-                lhs_reg = vm_regs[code[code_pos+3]];
+                VM_NEXT;
+            VM_CASE(o_get_boolean):
+                lhs_reg = &vm_regs[code[code_pos+3]];
                 lhs_reg->value.integer = code[code_pos+2];
                 lhs_reg->flags = VAL_IS_BOOLEAN;
                 code_pos += 4;
-                break;
-            case o_integer_add:
-                INTEGER_OP(+)
-                break;
-            case o_integer_minus:
-                INTEGER_OP(-)
-                break;
-            case o_double_add:
+                VM_NEXT;
+            VM_CASE(o_integer_add):
+                WRAPPING_OP(+)
+                VM_NEXT;
+            VM_CASE(o_integer_minus):
+                WRAPPING_OP(-)
+                VM_NEXT;
+            VM_CASE(o_double_add):
                 INTDBL_OP(+)
-                break;
-            case o_double_minus:
+                VM_NEXT;
+            VM_CASE(o_double_minus):
                 INTDBL_OP(-)
-                break;
-            case o_less:
-                COMPARE_OP(<, == -1)
-                break;
-            case o_less_eq:
-                COMPARE_OP(<=, <= 0)
-                break;
-            case o_is_equal:
-                EQUALITY_COMPARE_OP(==, == 0)
-                break;
-            case o_greater:
-                COMPARE_OP(>, == 1)
-                break;
-            case o_greater_eq:
-                COMPARE_OP(>, >= 0)
-                break;
-            case o_not_eq:
-                EQUALITY_COMPARE_OP(!=, != 0)
-                break;
-            case o_jump:
+                VM_NEXT;
+            VM_CASE(o_less):
+                COMPARE_OP(<)
+                VM_NEXT;
+            VM_CASE(o_less_eq):
+                COMPARE_OP(<=)
+                VM_NEXT;
+            VM_CASE(o_is_equal):
+                EQUALITY_COMPARE_OP(==)
+                VM_NEXT;
+            VM_CASE(o_greater):
+                COMPARE_OP(>)
+                VM_NEXT;
+            VM_CASE(o_greater_eq):
+                COMPARE_OP(>=)
+                VM_NEXT;
+            VM_CASE(o_not_eq):
+                EQUALITY_COMPARE_OP(!=)
+                VM_NEXT;
+            VM_CASE(o_integer_eq):
+                INTEGER_COMPARE_OP(==)
+                VM_NEXT;
+            VM_CASE(o_integer_not_eq):
+                INTEGER_COMPARE_OP(!=)
+                VM_NEXT;
+            VM_CASE(o_integer_less):
+                INTEGER_COMPARE_OP(<)
+                VM_NEXT;
+            VM_CASE(o_integer_less_eq):
+                INTEGER_COMPARE_OP(<=)
+                VM_NEXT;
+            VM_CASE(o_integer_greater):
+                INTEGER_COMPARE_OP(>)
+                VM_NEXT;
+            VM_CASE(o_integer_greater_eq):
+                INTEGER_COMPARE_OP(>=)
+                VM_NEXT;
+            VM_CASE(o_double_eq):
+                DOUBLE_COMPARE_OP(==)
+                VM_NEXT;
+            VM_CASE(o_double_not_eq):
+                DOUBLE_COMPARE_OP(!=)
+                VM_NEXT;
+            VM_CASE(o_double_less):
+                DOUBLE_COMPARE_OP(<)
+                VM_NEXT;
+            VM_CASE(o_double_less_eq):
+                DOUBLE_COMPARE_OP(<=)
+                VM_NEXT;
+            VM_CASE(o_double_greater):
+                DOUBLE_COMPARE_OP(>)
+                VM_NEXT;
+            VM_CASE(o_double_greater_eq):
+                DOUBLE_COMPARE_OP(>=)
+                VM_NEXT;
+            VM_CASE(o_string_eq):
+                STRING_COMPARE_OP(== 0)
+                VM_NEXT;
+            VM_CASE(o_string_not_eq):
+                STRING_COMPARE_OP(!= 0)
+                VM_NEXT;
+            VM_CASE(o_string_less):
+                STRING_COMPARE_OP(< 0)
+                VM_NEXT;
+            VM_CASE(o_string_less_eq):
+                STRING_COMPARE_OP(<= 0)
+                VM_NEXT;
+            VM_CASE(o_string_greater):
+                STRING_COMPARE_OP(> 0)
+                VM_NEXT;
+            VM_CASE(o_string_greater_eq):
+                STRING_COMPARE_OP(>= 0)
+                VM_NEXT;
+            VM_CASE(o_jump):
                 code_pos = code[code_pos+1];
-                break;
-            case o_integer_mul:
-                INTEGER_OP(*)
-                break;
-            case o_double_mul:
+                VM_NEXT;
+            VM_CASE(o_integer_mul):
+                WRAPPING_OP(*)
+                VM_NEXT;
+            VM_CASE(o_double_mul):
                 INTDBL_OP(*)
-                break;
-            case o_integer_div:
+                VM_NEXT;
+            VM_CASE(o_integer_div):
                 /* Before doing INTEGER_OP, check for a division by zero. This
                    will involve some redundant checking of the rhs, but better
                    than dumping INTEGER_OP's contents here or rewriting
                    INTEGER_OP for the special case of division. */
-                rhs_reg = vm_regs[code[code_pos+3]];
-                if (rhs_reg->value.integer == 0)
+                rhs_reg = &vm_regs[code[code_pos+3]];
+                if (rhs_reg->value.integer == 0) {
+                    SAVE_LINE
                     lily_vm_raise(vm, SYM_CLASS_DBZERROR,
                             "Attempt to divide by zero.\n");
+                }
                 INTEGER_OP(/)
-                break;
-            case o_modulo:
+                VM_NEXT;
+            VM_CASE(o_modulo):
                 /* x % 0 will do the same thing as x / 0... */
-                rhs_reg = vm_regs[code[code_pos+3]];
-                if (rhs_reg->value.integer == 0)
+                rhs_reg = &vm_regs[code[code_pos+3]];
+                if (rhs_reg->value.integer == 0) {
+                    SAVE_LINE
                     lily_vm_raise(vm, SYM_CLASS_DBZERROR,
                             "Attempt to divide by zero.\n");
+                }
                 INTEGER_OP(%)
-                break;
-            case o_left_shift:
+                VM_NEXT;
+            VM_CASE(o_left_shift):
                 INTEGER_OP(<<)
-                break;
-            case o_right_shift:
+                VM_NEXT;
+            VM_CASE(o_right_shift):
                 INTEGER_OP(>>)
-                break;
-            case o_bitwise_and:
+                VM_NEXT;
+            VM_CASE(o_bitwise_and):
                 INTEGER_OP(&)
-                break;
-            case o_bitwise_or:
+                VM_NEXT;
+            VM_CASE(o_bitwise_or):
                 INTEGER_OP(|)
-                break;
-            case o_bitwise_xor:
+                VM_NEXT;
+            VM_CASE(o_bitwise_xor):
                 INTEGER_OP(^)
-                break;
-            case o_double_div:
+                VM_NEXT;
+            VM_CASE(o_double_div):
                 /* This is a little more tricky, because the rhs could be a
                    number or an integer... */
-                rhs_reg = vm_regs[code[code_pos+3]];
-                if (rhs_reg->flags & VAL_IS_INTEGER &&
-                    rhs_reg->value.integer == 0)
-                    lily_vm_raise(vm, SYM_CLASS_DBZERROR,
-                            "Attempt to divide by zero.\n");
-                else if (rhs_reg->flags & VAL_IS_DOUBLE &&
-                         rhs_reg->value.doubleval == 0)
+                rhs_reg = &vm_regs[code[code_pos+3]];
+                if ((rhs_reg->flags & VAL_IS_INTEGER &&
+                     rhs_reg->value.integer == 0) ||
+                    (rhs_reg->flags & VAL_IS_DOUBLE &&
+                     rhs_reg->value.doubleval == 0)) {
+                    SAVE_LINE
                     lily_vm_raise(vm, SYM_CLASS_DBZERROR,
                             "Attempt to divide by zero.\n");
+                }
 
                 INTDBL_OP(/)
-                break;
-            case o_jump_if:
-                lhs_reg = vm_regs[code[code_pos+2]];
+                VM_NEXT;
+            VM_CASE(o_jump_if):
+                lhs_reg = &vm_regs[code[code_pos+2]];
                 {
                     int flags = lhs_reg->flags;
                     int result;
@@ -2232,27 +2942,60 @@ void lily_vm_execute(lily_vm_state *vm)
                     else
                         code_pos += 4;
                 }
-                break;
-            case o_foreign_call:
+                VM_NEXT;
+            VM_CASE(o_jump_if_integer_eq):
+                INTEGER_JUMP_IF_OP(==)
+                VM_NEXT;
+            VM_CASE(o_jump_if_integer_not_eq):
+                INTEGER_JUMP_IF_OP(!=)
+                VM_NEXT;
+            VM_CASE(o_jump_if_integer_less):
+                INTEGER_JUMP_IF_OP(<)
+                VM_NEXT;
+            VM_CASE(o_jump_if_integer_less_eq):
+                INTEGER_JUMP_IF_OP(<=)
+                VM_NEXT;
+            VM_CASE(o_jump_if_integer_greater):
+                INTEGER_JUMP_IF_OP(>)
+                VM_NEXT;
+            VM_CASE(o_jump_if_integer_greater_eq):
+                INTEGER_JUMP_IF_OP(>=)
+                VM_NEXT;
+            VM_CASE(o_jump_if_double_eq):
+                DOUBLE_JUMP_IF_OP(==)
+                VM_NEXT;
+            VM_CASE(o_jump_if_double_not_eq):
+                DOUBLE_JUMP_IF_OP(!=)
+                VM_NEXT;
+            VM_CASE(o_jump_if_double_less):
+                DOUBLE_JUMP_IF_OP(<)
+                VM_NEXT;
+            VM_CASE(o_jump_if_double_less_eq):
+                DOUBLE_JUMP_IF_OP(<=)
+                VM_NEXT;
+            VM_CASE(o_jump_if_double_greater):
+                DOUBLE_JUMP_IF_OP(>)
+                VM_NEXT;
+            VM_CASE(o_jump_if_double_greater_eq):
+                DOUBLE_JUMP_IF_OP(>=)
+                VM_NEXT;
+            VM_CASE(o_foreign_call):
                 fval = vm->readonly_table[code[code_pos+2]]->value.function;
 
                 foreign_func_body: ;
 
-                if (current_frame->next == NULL) {
-                    if (vm->call_depth > 100)
-                        lily_vm_raise(vm, SYM_CLASS_RUNTIMEERROR,
-                                "Function call recursion limit reached.\n");
-                    add_call_frame(vm);
-                }
-
                 i = code[code_pos+3];
                 current_frame->line_num = code[code_pos+1];
                 current_frame->code_pos = code_pos + i + 5;
-                current_frame->upvalues = upvalues;
+
+                if (current_frame + 1 == vm->call_frames_end) {
+                    grow_call_frames(vm);
+                    current_frame = vm->call_chain;
+                }
 
                 lily_foreign_func func = fval->foreign_func;
 
-                current_frame = current_frame->next;
+                current_frame++;
                 vm->call_chain = current_frame;
 
                 current_frame->function = fval;
@@ -2282,29 +3025,27 @@ void lily_vm_execute(lily_vm_state *vm)
                 }
 
                 vm->num_registers--;
-                current_frame = current_frame->prev;
+                /* The frames may have moved if the function called the vm. */
+                current_frame = vm->call_chain - 1;
                 vm->call_chain = current_frame;
 
                 code_pos += 5 + i;
                 vm->call_depth--;
 
-                break;
-            case o_native_call: {
+                VM_NEXT;
+            VM_CASE(o_native_call): {
                 fval = vm->readonly_table[code[code_pos+2]]->value.function;
 
                 native_func_body: ;
 
-                if (current_frame->next == NULL) {
-                    if (vm->call_depth > 100)
-                        lily_vm_raise(vm, SYM_CLASS_RUNTIMEERROR,
-                                "Function call recursion limit reached.\n");
-                    add_call_frame(vm);
-                }
-
                 i = code[code_pos+3];
                 current_frame->line_num = code[code_pos+1];
                 current_frame->code_pos = code_pos + i + 5;
-                current_frame->upvalues = upvalues;
+
+                if (current_frame + 1 == vm->call_frames_end) {
+                    grow_call_frames(vm);
+                    current_frame = vm->call_chain;
+                }
 
                 int register_need = fval->reg_count + num_registers;
 
@@ -2321,13 +3062,13 @@ void lily_vm_execute(lily_vm_state *vm)
                 prep_registers(vm, fval, code+code_pos);
                 num_registers = vm->num_registers;
 
-                current_frame->return_target = vm_regs[code[code_pos+4]];
+                current_frame->return_target = &vm_regs[code[code_pos+4]];
                 vm_regs = vm_regs + current_frame->regs_used;
                 vm->vm_regs = vm_regs;
 
                 /* !PAST HERE TARGETS THE NEW FRAME! */
 
-                current_frame = current_frame->next;
+                current_frame++;
                 vm->call_chain = current_frame;
 
                 current_frame->function = fval;
@@ -2339,55 +3080,67 @@ void lily_vm_execute(lily_vm_state *vm)
                 code_pos = 0;
                 upvalues = NULL;
 
-                break;
+                if (fval->try_count && vm->catch_base->link == NULL) {
+                    current_frame->code_pos = 0;
+                    return 1;
+                }
+
+                VM_NEXT;
             }
-            case o_function_call:
-                fval = vm_regs[code[code_pos+2]]->value.function;
+            VM_CASE(o_function_call):
+                fval = vm_regs[code[code_pos+2]].value.function;
 
                 if (fval->code != NULL)
                     goto native_func_body;
                 else
                     goto foreign_func_body;
 
-                break;
-            case o_interpolation:
+                VM_NEXT;
+            VM_CASE(o_interpolation):
                 do_o_interpolation(vm, code+code_pos);
                 code_pos += code[code_pos + 2] + 4;
-                break;
-            case o_unary_not:
-                lhs_reg = vm_regs[code[code_pos+2]];
+                VM_NEXT;
+            VM_CASE(o_unary_not):
+                lhs_reg = &vm_regs[code[code_pos+2]];
 
-                rhs_reg = vm_regs[code[code_pos+3]];
+                rhs_reg = &vm_regs[code[code_pos+3]];
                 rhs_reg->flags = lhs_reg->flags;
                 rhs_reg->value.integer = !(lhs_reg->value.integer);
                 code_pos += 4;
-                break;
-            case o_unary_minus:
-                lhs_reg = vm_regs[code[code_pos+2]];
+                VM_NEXT;
+            VM_CASE(o_unary_minus):
+                lhs_reg = &vm_regs[code[code_pos+2]];
 
-                rhs_reg = vm_regs[code[code_pos+3]];
+                rhs_reg = &vm_regs[code[code_pos+3]];
                 rhs_reg->flags = VAL_IS_INTEGER;
                 rhs_reg->value.integer = -(lhs_reg->value.integer);
                 code_pos += 4;
-                break;
-            case o_return_val:
-                lhs_reg = current_frame->prev->return_target;
-                rhs_reg = vm_regs[code[code_pos+2]];
-                lily_assign_value(lhs_reg, rhs_reg);
+                VM_NEXT;
+            VM_CASE(o_return_val):
+                lhs_reg = (current_frame - 1)->return_target;
+                rhs_reg = &vm_regs[code[code_pos+2]];
+
+                /* Most functions return a plain value like an Integer. */
+                if ((lhs_reg->flags | rhs_reg->flags) & VAL_IS_DEREFABLE)
+                    lily_assign_value(lhs_reg, rhs_reg);
+                else {
+                    lhs_reg->value = rhs_reg->value;
+                    lhs_reg->flags = rhs_reg->flags;
+                }
 
                 /* DO NOT BREAK HERE.
                    These two do the same thing from here on, so fall through to
                    share code. */
-            case o_return_noval:
+            VM_CASE(o_return_noval):
                 current_frame->build_value = NULL;
 
-                current_frame = current_frame->prev;
+                current_frame--;
                 vm->call_chain = current_frame;
                 vm->call_depth--;
 
                 /* The registers that the function last entered are not in use
                    anymore, so they don't count now. */
-                num_registers -= current_frame->next->regs_used;
+                num_registers -= (current_frame + 1)->regs_used;
                 vm->num_registers = num_registers;
                 /* vm_regs adjusts by the count of the now-current function so
                    that vm_regs[0] is the 0 of the caller. */
@@ -2396,90 +3149,99 @@ void lily_vm_execute(lily_vm_state *vm)
                 upvalues = current_frame->upvalues;
                 code = current_frame->code;
                 code_pos = current_frame->code_pos;
-                break;
-            case o_get_global:
-                rhs_reg = regs_from_main[code[code_pos+2]];
-                lhs_reg = vm_regs[code[code_pos+3]];
+                VM_NEXT;
+            VM_CASE(o_get_global):
+                rhs_reg = &regs_from_main[code[code_pos+2]];
+                lhs_reg = &vm_regs[code[code_pos+3]];
 
                 lily_assign_value(lhs_reg, rhs_reg);
                 code_pos += 4;
-                break;
-            case o_set_global:
-                rhs_reg = vm_regs[code[code_pos+2]];
-                lhs_reg = regs_from_main[code[code_pos+3]];
+                VM_NEXT;
+            VM_CASE(o_set_global):
+                rhs_reg = &vm_regs[code[code_pos+2]];
+                lhs_reg = &regs_from_main[code[code_pos+3]];
 
                 lily_assign_value(lhs_reg, rhs_reg);
                 code_pos += 4;
-                break;
-            case o_assign:
-                rhs_reg = vm_regs[code[code_pos+2]];
-                lhs_reg = vm_regs[code[code_pos+3]];
+                VM_NEXT;
+            VM_CASE(o_assign):
+                rhs_reg = &vm_regs[code[code_pos+2]];
+                lhs_reg = &vm_regs[code[code_pos+3]];
 
                 lily_assign_value(lhs_reg, rhs_reg);
                 code_pos += 4;
-                break;
-            case o_get_item:
+                VM_NEXT;
+            VM_CASE(o_get_item):
                 do_o_get_item(vm, code, code_pos);
                 code_pos += 5;
-                break;
-            case o_get_property:
+                VM_NEXT;
+            VM_CASE(o_get_property):
                 do_o_get_property(vm, code, code_pos);
                 code_pos += 5;
-                break;
-            case o_set_item:
+                VM_NEXT;
+            VM_CASE(o_set_item):
                 do_o_set_item(vm, code, code_pos);
                 code_pos += 5;
-                break;
-            case o_set_property:
+                VM_NEXT;
+            VM_CASE(o_set_property):
                 do_o_set_property(vm, code, code_pos);
                 code_pos += 5;
-                break;
-            case o_build_hash:
+                VM_NEXT;
+            VM_CASE(o_get_packed_item):
+                do_o_get_packed_item(vm, code, code_pos);
+                code_pos += 5;
+                VM_NEXT;
+            VM_CASE(o_set_packed_item):
+                do_o_set_packed_item(vm, code, code_pos);
+                code_pos += 5;
+                VM_NEXT;
+            VM_CASE(o_build_hash):
                 do_o_build_hash(vm, code, code_pos);
                 code_pos += code[code_pos+2] + 4;
-                break;
-            case o_build_list:
-            case o_build_tuple:
+                VM_NEXT;
+            VM_CASE(o_build_list):
+            VM_CASE(o_build_tuple):
                 do_o_build_list_tuple(vm, code+code_pos);
                 code_pos += code[code_pos+2] + 4;
-                break;
-            case o_build_enum:
+                VM_NEXT;
+            VM_CASE(o_build_enum):
                 do_o_build_enum(vm, code+code_pos);
                 code_pos += code[code_pos+4] + 6;
-                break;
-            case o_dynamic_cast:
+                VM_NEXT;
+            VM_CASE(o_dynamic_cast):
                 do_o_dynamic_cast(vm, code+code_pos);
                 code_pos += 5;
-                break;
-            case o_create_function:
+                VM_NEXT;
+            VM_CASE(o_create_function):
+            VM_CASE(o_create_local_function):
                 do_o_create_function(vm, code + code_pos);
                 code_pos += 4;
-                break;
-            case o_set_upvalue:
+                VM_NEXT;
+            VM_CASE(o_set_upvalue):
                 lhs_reg = upvalues[code[code_pos + 2]];
-                rhs_reg = vm_regs[code[code_pos + 3]];
+                rhs_reg = &vm_regs[code[code_pos + 3]];
                 if (lhs_reg == NULL)
                     upvalues[code[code_pos + 2]] = make_cell_from(rhs_reg);
                 else
                     lily_assign_value(lhs_reg, rhs_reg);
 
                 code_pos += 4;
-                break;
-            case o_get_upvalue:
-                lhs_reg = vm_regs[code[code_pos + 3]];
+                VM_NEXT;
+            VM_CASE(o_get_upvalue):
+                lhs_reg = &vm_regs[code[code_pos + 3]];
                 rhs_reg = upvalues[code[code_pos + 2]];
                 lily_assign_value(lhs_reg, rhs_reg);
                 code_pos += 4;
-                break;
-            case o_optarg_dispatch:
+                VM_NEXT;
+            VM_CASE(o_optarg_dispatch):
                 code_pos = do_o_optarg_dispatch(vm, code+code_pos);
-                break;
-            case o_integer_for:
+                VM_NEXT;
+            VM_CASE(o_integer_for):
                 /* loop_reg is an internal counter, while lhs_reg is an external
                    counter. rhs_reg is the stopping point. */
-                loop_reg = vm_regs[code[code_pos+2]];
-                rhs_reg  = vm_regs[code[code_pos+3]];
-                step_reg = vm_regs[code[code_pos+4]];
+                loop_reg = &vm_regs[code[code_pos+2]];
+                rhs_reg  = &vm_regs[code[code_pos+3]];
+                step_reg = &vm_regs[code[code_pos+4]];
 
                 /* Note the use of the loop_reg. This makes it use the internal
                    counter, and thus prevent user assignments from damaging the loop. */
@@ -2494,7 +3256,7 @@ void lily_vm_execute(lily_vm_state *vm)
 
                     /* Haven't reached the end yet, so bump the internal and
                        external values.*/
-                    lhs_reg = vm_regs[code[code_pos+5]];
+                    lhs_reg = &vm_regs[code[code_pos+5]];
                     lhs_reg->value.integer = for_temp;
                     loop_reg->value.integer = for_temp;
                     code_pos += 7;
@@ -2502,91 +3264,77 @@ void lily_vm_execute(lily_vm_state *vm)
                 else
                     code_pos = code[code_pos+6];
 
-                break;
-            case o_push_try:
-            {
-                if (vm->catch_chain->next == NULL)
-                    add_catch_entry(vm);
-
-                lily_vm_catch_entry *catch_entry = vm->catch_chain;
-                catch_entry->call_frame = current_frame;
-                catch_entry->call_frame_depth = vm->call_depth;
-                catch_entry->code_pos = code_pos + 2;
-                catch_entry->jump_entry = vm->raiser->all_jumps;
-                catch_entry->offset_from_main = (int64_t)(vm_regs - regs_from_main);
-                catch_entry->vm_list_pos = vm->vm_list->pos;
-
-                vm->catch_chain = vm->catch_chain->next;
-                code_pos += 3;
-                break;
-            }
-            case o_pop_try:
-                vm->catch_chain = vm->catch_chain->prev;
-
-                code_pos++;
-                break;
-            case o_raise:
-                lhs_reg = vm_regs[code[code_pos+2]];
+                VM_NEXT;
+            VM_CASE(o_raise):
+                SAVE_LINE
+                lhs_reg = &vm_regs[code[code_pos+2]];
                 do_o_raise(vm, lhs_reg);
                 code_pos += 3;
-                break;
-            case o_new_instance_basic:
-            case o_new_instance_speculative:
-            case o_new_instance_tagged:
+                VM_NEXT;
+            VM_CASE(o_new_instance_basic):
+            VM_CASE(o_new_instance_speculative):
+            VM_CASE(o_new_instance_tagged):
             {
                 do_o_new_instance(vm, code+code_pos);
                 code_pos += 4;
-                break;
+                VM_NEXT;
             }
-            case o_match_dispatch:
+            VM_CASE(o_match_dispatch):
             {
                 /* This opcode is easy because emitter ensures that the match is
                    exhaustive. It also writes down the jumps in order (even if
                    they came out of order). This becomes a simple matter of
                    going to the jump that's 'variant_id' slots in. */
-                lhs_reg = vm_regs[code[code_pos+2]];
+                lhs_reg = &vm_regs[code[code_pos+2]];
                 int variant_id = lhs_reg->value.instance->variant_id;
 
                 code_pos = code[code_pos + 4 + variant_id];
-                break;
+                VM_NEXT;
             }
-            case o_variant_decompose:
+            VM_CASE(o_variant_decompose):
             {
-                rhs_reg = vm_regs[code[code_pos + 2]];
-                lily_value **decompose_values = rhs_reg->value.instance->values;
+                rhs_reg = &vm_regs[code[code_pos + 2]];
+                lily_value *decompose_values = rhs_reg->value.instance->values;
 
                 /* Each variant value gets mapped away to a register. The
                    emitter ensures that the decomposition won't go too far. */
                 for (i = 0;i < code[code_pos+3];i++) {
-                    lhs_reg = vm_regs[code[code_pos + 4 + i]];
-                    lily_assign_value(lhs_reg, decompose_values[i]);
+                    lhs_reg = &vm_regs[code[code_pos + 4 + i]];
+                    lily_assign_value(lhs_reg, &decompose_values[i]);
                 }
 
                 code_pos += 4 + i;
-                break;
+                VM_NEXT;
             }
-            case o_create_closure:
+            /* The frame holds the upvalues too, so that they're there when a
+               call returns or an exception is caught. */
+            VM_CASE(o_create_closure):
                 upvalues = do_o_create_closure(vm, code+code_pos);
+                current_frame->upvalues = upvalues;
                 code_pos += 4;
-                break;
-            case o_load_class_closure:
+                VM_NEXT;
+            VM_CASE(o_load_class_closure):
                 upvalues = do_o_load_class_closure(vm, code, code_pos);
+                current_frame->upvalues = upvalues;
                 code_pos += 5;
-                break;
-            case o_load_closure:
+                VM_NEXT;
+            VM_CASE(o_load_closure):
                 upvalues = do_o_load_closure(vm, code+code_pos);
+                current_frame->upvalues = upvalues;
                 code_pos = code[code_pos+2] + 4;
-                break;
-            case o_for_setup:
-                loop_reg = vm_regs[code[code_pos+2]];
+                VM_NEXT;
+            VM_CASE(o_for_setup):
+                loop_reg = &vm_regs[code[code_pos+2]];
                 /* lhs_reg is the start, rhs_reg is the stop. */
-                step_reg = vm_regs[code[code_pos+5]];
-                lhs_reg = vm_regs[code[code_pos+3]];
-                rhs_reg = vm_regs[code[code_pos+4]];
+                step_reg = &vm_regs[code[code_pos+5]];
+                lhs_reg = &vm_regs[code[code_pos+3]];
+                rhs_reg = &vm_regs[code[code_pos+4]];
 
-                if (step_reg->value.integer == 0)
+                if (step_reg->value.integer == 0) {
+                    SAVE_LINE
                     lily_vm_raise(vm, SYM_CLASS_VALUEERROR,
                                "for loop step cannot be 0.\n");
+                }
 
                 /* Do a negative step to offset falling into o_for_loop. */
                 loop_reg->value.integer =
@@ -2594,10 +3342,57 @@ void lily_vm_execute(lily_vm_state *vm)
                 loop_reg->flags = VAL_IS_INTEGER;
 
                 code_pos += 6;
-                break;
-            case o_return_from_vm:
-                lily_release_jump(vm->raiser);
-                return;
+                VM_NEXT;
+            VM_CASE(o_return_from_vm):
+                return 0;
         }
     }
 }
+
+void lily_vm_execute(lily_vm_state *vm)
+{
+    lily_vm_catch_base base;
+    lily_vm_catch_base *prev_base = vm->catch_base;
+
+    /* vm_run resumes the current frame, so start it from the top. */
+    vm->call_chain->code_pos = 0;
+    vm->call_chain->upvalues = NULL;
+
+    base.frame_index = vm->call_chain - vm->call_frames;
+    base.regs_offset = vm->vm_regs - vm->regs_from_main;
+    base.call_depth = vm->call_depth;
+    base.vm_list_pos = vm->vm_list->pos;
+    base.link = NULL;
+    vm->catch_base = &base;
+
+    /* Callbacks (such as those of List.map) usually don't have try blocks. If
+       nothing in here can catch, then exceptions go right to the jump of
+       whatever is holding this execute. */
+    if (vm->call_chain->function->try_count == 0 && vm_run(vm) == 0) {
+        vm->catch_base = prev_base;
+        return;
+    }
+
+    base.link = lily_jump_setup(vm->raiser);
+    if (setjmp(base.link->jump) != 0) {
+        /* Executes within this one may have left without fixing this. */
+        vm->catch_base = &base;
+
+        /* The opcode that raised has already written down the line number and
+           position of the current frame, so there's nothing to fix here. */
+        if (maybe_catch_exception(vm, &base) == 0)
+            /* Couldn't catch it. Jump back into parser, which will jump
+               back to the caller to give them the bad news. */
+            lily_jump_back(vm->raiser);
+
+        /* The exception was caught, and the catching frame has been set to
+           resume in the except block. */
+        vm->num_registers = (vm->vm_regs - vm->regs_from_main) +
+                vm->call_chain->regs_used;
+    }
+
+    vm_run(vm);
+
+    lily_release_jump(vm->raiser);
+    vm->catch_base = prev_base;
+}
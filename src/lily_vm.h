@@ -3,6 +3,7 @@
 
 # include "lily_raiser.h"
 # include "lily_symtab.h"
+# include "lily_api_gc.h"
 
 typedef struct lily_call_frame_ {
     lily_function_val *function;
@@ -23,39 +24,35 @@ typedef struct lily_call_frame_ {
        being executed from a higher-up class. If that is the case, then the
        subclass uses the value of the higher-up class. */
     lily_value *build_value;
-
-    struct lily_call_frame_ *prev;
-    struct lily_call_frame_ *next;
 } lily_call_frame;
 
-typedef struct lily_vm_catch_entry_ {
-    lily_call_frame *call_frame;
-    /* How far away vm->vm_regs (where the locals start) is from
-       vm->regs_from_main in the current frame. When catching exceptions, it's
-       simpler, safer, and faster to fix vm->vm_regs with this instead of
-       attempting to walk the call chain backward to figure out where
-       vm->vm_regs will end up. */
-    int offset_from_main;
-    int code_pos;
-    uint32_t call_frame_depth;
-    /* This is where vm->vm_list->pos (position in the temp list) should be
-       restored to. */
-    uint32_t vm_list_pos;
-    lily_jump_link *jump_entry;
-
-    struct lily_vm_catch_entry_ *next;
-    struct lily_vm_catch_entry_ *prev;
-} lily_vm_catch_entry;
-
+/* This is scratch space for foreign functions that build up values (such as
+   List.map). The values between a function's starting pos and the current pos
+   are owned by the list until they are moved out. */
 typedef struct {
-    lily_value **values;
+    lily_value *values;
     uint32_t pos;
     uint32_t size;
 } lily_vm_list;
 
+/* lily_vm_execute writes this down before it starts. Frames from the one given
+   up to the first foreign frame are run by that execute, and it can only catch
+   exceptions within them. The others must be caught (or not) by the execute
+   that runs them. Indexes and offsets are used because the frames and
+   registers may move before an exception is raised. */
+typedef struct {
+    uint32_t frame_index;
+    uint32_t regs_offset;
+    uint32_t call_depth;
+    uint32_t vm_list_pos;
+    /* This is NULL until a function with a try block is entered. Until then,
+       there's nothing to catch, so there's no need to pay for a setjmp. */
+    lily_jump_link *link;
+} lily_vm_catch_base;
+
 typedef struct lily_vm_state_ {
-    lily_value **vm_regs;
-    lily_value **regs_from_main;
+    lily_value *vm_regs;
+    lily_value *regs_from_main;
 
     /* The total number of registers available, minus 2. This is used to check
        for space checks so that there are always 2 registers available for
@@ -70,25 +67,44 @@ typedef struct lily_vm_state_ {
 
     uint32_t call_depth;
 
+    /* The frame of the function currently running. Frames are kept in one
+       block, so the caller is at 'call_chain - 1' and the callee at
+       'call_chain + 1'. */
     lily_call_frame *call_chain;
 
+    /* The block of frames, starting with __main__'s frame. The block grows
+       by doubling, but never past ->max_call_depth frames. Since it may move,
+       anything holding a frame must be rebased when it grows. */
+    lily_call_frame *call_frames;
+    lily_call_frame *call_frames_end;
+    uint32_t max_call_depth;
+
     lily_tie **readonly_table;
     lily_class **class_table;
     uint32_t class_count;
     uint32_t readonly_count;
 
-    /* A linked list of entries that should be findable from a register. */
+    /* A linked list of entries that have survived a young pass. These are only
+       looked at by a full sweep. */
     lily_gc_entry *gc_live_entries;
 
+    /* A linked list of entries that were tagged since the last young pass. */
+    lily_gc_entry *gc_young_entries;
+
     /* A linked list of entries not currently in use. */
     lily_gc_entry *gc_spare_entries;
 
-    /* How many entries are in ->gc_live_entries. If this is >= ->gc_threshold,
-       then the gc is triggered when there is an attempt to attach a gc_entry
-       to a value. */
+    /* How many entries are in ->gc_live_entries. If this is >= ->gc_threshold
+       after a young pass, then a full sweep is done. */
     uint32_t gc_live_entry_count;
     /* How many entries to allow in ->gc_live_entries before doing a sweep. */
     uint32_t gc_threshold;
+
+    /* How many entries are in ->gc_young_entries. If this is >=
+       ->gc_young_threshold, then a young pass is done when there is an attempt
+       to attach a gc_entry to a value. */
+    uint32_t gc_young_count;
+    uint32_t gc_young_threshold;
     /* An always-increasing value indicating the current pass, used to determine
        if an entry has been seen. An entry is visible if
        'entry->last_pass == gc_pass' */
@@ -98,9 +114,13 @@ typedef struct lily_vm_state_ {
        the threshold is multiplied by to increase it. */
     uint32_t gc_multiplier;
 
+    /* Counters about the gc, for lily_gc_get_stats. */
+    lily_gc_stats gc_stats;
+
     char *sipkey;
 
-    lily_vm_catch_entry *catch_chain;
+    /* This is the base of the lily_vm_execute that is currently running. */
+    lily_vm_catch_base *catch_base;
 
     /* If a proper value is being raised (currently only the `raise` keyword),
        then this is the value raised. Otherwise, this is NULL. Since exception
@@ -144,8 +164,28 @@ void lily_vm_ensure_class_table(lily_vm_state *, int);
 void lily_vm_add_class_unchecked(lily_vm_state *, lily_class *);
 void lily_vm_add_class(lily_vm_state *, lily_class *);
 
+/* A prepared call is for foreign functions that call the same function many
+   times (such as List.map). The frames are set up once by lily_prepare_call.
+   After that, each call puts the arguments into the registers given by
+   lily_prepared_arg, then runs the call with lily_call_prepared.
+   A foreign function can only have one call (prepared or foreign) in use at a
+   time, since they all use the frame after the foreign function's frame. */
+typedef struct {
+    lily_function_val *target;
+    /* Where the return register is, as an offset from vm->regs_from_main. The
+       arguments are right after it. */
+    uint32_t return_offset;
+    uint16_t num_args;
+    uint16_t need_result;
+    int target_need;
+} lily_prepared_call;
+
 lily_value *lily_foreign_call(lily_vm_state *, int *, int, lily_value *,
         int, ...);
+void lily_prepare_call(lily_vm_state *, lily_prepared_call *, lily_value *,
+        int, int);
+lily_value *lily_prepared_arg(lily_vm_state *, lily_prepared_call *, int);
+lily_value *lily_call_prepared(lily_vm_state *, lily_prepared_call *);
 void lily_vm_list_ensure(lily_vm_state *, uint32_t);
 
 #endif